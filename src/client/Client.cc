@@ -10297,6 +10297,10 @@ Fh *Client::_create_fh(Inode *in, int flags, int cmode, const UserPerm& perms)
   alignments.push_back(in->layout.get_period());
   alignments.push_back(in->layout.stripe_unit);
   f->readahead.set_alignments(alignments);
+  f->readahead.set_max_streams(
+    conf.get_val<uint64_t>("client_readahead_max_streams"));
+  f->readahead.set_max_stride(
+    conf.get_val<Option::size_t>("client_readahead_max_stride"));
 
   return f;
 }
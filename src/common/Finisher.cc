@@ -129,3 +129,167 @@ void *Finisher::finisher_thread_entry()
   return 0;
 }
 
+
+// ShardedFinisher
+
+#undef dout_prefix
+#define dout_prefix *_dout << "sharded_finisher(" << this << ") "
+
+ShardedFinisher::ShardedFinisher(CephContext *cct_, std::string_view name,
+				 std::string &&tn, unsigned num_threads) :
+  cct(cct_), thread_name(std::move(tn))
+{
+  ceph_assert(num_threads > 0);
+  for (unsigned i = 0; i < num_threads; i++) {
+    lanes.emplace_back(std::make_unique<Lane>(this));
+  }
+
+  PerfHistogramCommon::axis_config_d lat_axis{
+    "Latency (usec)",
+    PerfHistogramCommon::SCALE_LOG2,
+    0,
+    1000,   // 1 usec
+    32,
+  };
+  PerfHistogramCommon::axis_config_d batch_axis{
+    "Batch size",
+    PerfHistogramCommon::SCALE_LOG2,
+    0,
+    1,
+    16,
+  };
+  PerfCountersBuilder b(cct, fmt::format("finisher-{}", name),
+			l_sharded_finisher_first, l_sharded_finisher_last);
+  b.add_u64(l_sharded_finisher_queue_len, "queue_len");
+  b.add_time_avg(l_sharded_finisher_complete_lat, "complete_latency");
+  b.add_time_avg(l_sharded_finisher_queue_lat, "queue_latency",
+		 "Time from queueing to completing a context");
+  b.add_u64_counter_histogram(
+    l_sharded_finisher_queue_lat_histogram, "queue_latency_histogram",
+    lat_axis, batch_axis,
+    "Histogram of queue latency and the size of the batch it was completed in");
+  logger = b.create_perf_counters();
+  cct->get_perfcounters_collection()->add(logger);
+  logger->set(l_sharded_finisher_queue_len, 0);
+}
+
+ShardedFinisher::~ShardedFinisher()
+{
+  if (logger && cct) {
+    cct->get_perfcounters_collection()->remove(logger);
+    delete logger;
+  }
+}
+
+void ShardedFinisher::start()
+{
+  ldout(cct, 10) << __func__ << " " << lanes.size() << " threads" << dendl;
+  for (unsigned i = 0; i < lanes.size(); i++) {
+    if (lanes.size() == 1) {
+      lanes[i]->create(thread_name.c_str());
+    } else {
+      lanes[i]->create(fmt::format("{}{}", thread_name, i).c_str());
+    }
+  }
+}
+
+void ShardedFinisher::stop()
+{
+  ldout(cct, 10) << __func__ << dendl;
+  for (auto& lane : lanes) {
+    std::lock_guard l{lane->lock};
+    lane->stop = true;
+    lane->cond.notify_one();
+  }
+  for (auto& lane : lanes) {
+    lane->join();
+    lane->stop = false;
+  }
+  ldout(cct, 10) << __func__ << " finish" << dendl;
+}
+
+void ShardedFinisher::wait_for_empty()
+{
+  std::unique_lock l{empty_lock};
+  // the lanes look at this after dropping in_flight
+  ++empty_waiters;
+  empty_cond.wait(l, [this] { return in_flight == 0; });
+  --empty_waiters;
+  ldout(cct, 10) << "wait_for_empty empty" << dendl;
+}
+
+void ShardedFinisher::Lane::push(item_t *first, item_t *last)
+{
+  item_t *h = head.load();
+  do {
+    last->next = h;
+  } while (!head.compare_exchange_weak(h, first));
+  // we made it non-empty: wake the thread if it is (about to go) asleep.
+  // it sets sleeping before it looks at head for the last time.
+  if (!h && sleeping) {
+    std::lock_guard l{lock};
+    cond.notify_one();
+  }
+}
+
+void ShardedFinisher::complete(item_t *batch)
+{
+  // the batch is newest first
+  item_t *oldest = nullptr;
+  uint64_t count = 0;
+  while (batch) {
+    item_t *next = batch->next;
+    batch->next = oldest;
+    oldest = batch;
+    batch = next;
+    ++count;
+  }
+
+  auto start = logger ? ceph::mono_clock::now() : ceph::mono_time();
+  while (oldest) {
+    item_t *i = oldest;
+    oldest = i->next;
+    if (logger) {
+      auto lat = start - i->stamp;
+      logger->tinc(l_sharded_finisher_queue_lat, lat);
+      logger->hinc(l_sharded_finisher_queue_lat_histogram,
+		   std::chrono::duration_cast<std::chrono::nanoseconds>(
+		     lat).count(),
+		   count);
+    }
+    i->c->complete(i->r);
+    delete i;
+  }
+  if (logger) {
+    logger->dec(l_sharded_finisher_queue_len, count);
+    logger->tinc(l_sharded_finisher_complete_lat,
+		 ceph::mono_clock::now() - start);
+  }
+
+  if (in_flight.fetch_sub(count) == count && empty_waiters) {
+    std::lock_guard l{empty_lock};
+    empty_cond.notify_all();
+  }
+}
+
+void *ShardedFinisher::Lane::entry()
+{
+  CephContext *cct = fin->cct;
+  ldout(cct, 10) << "lane " << this << " start" << dendl;
+  while (true) {
+    if (item_t *batch = head.exchange(nullptr); batch) {
+      fin->complete(batch);
+      continue;
+    }
+    std::unique_lock l{lock};
+    sleeping = true;
+    cond.wait(l, [this] { return stop || head.load() != nullptr; });
+    sleeping = false;
+    if (stop && head.load() == nullptr) {
+      // what was queued before stop() is completed by now
+      break;
+    }
+  }
+  ldout(cct, 10) << "lane " << this << " stop" << dendl;
+  return nullptr;
+}
@@ -15,10 +15,14 @@
 #ifndef CEPH_FINISHER_H
 #define CEPH_FINISHER_H
 
+#include <atomic>
+#include <memory>
+
 #include "include/Context.h"
 #include "include/common_fwd.h"
 #include "common/Thread.h"
 #include "common/ceph_mutex.h"
+#include "common/ceph_time.h"
 #include "common/Cond.h"
 
 /// Finisher queue length performance counter ID.
@@ -126,6 +130,123 @@ class Finisher {
   ~Finisher();
 };
 
+enum {
+  l_sharded_finisher_first = 997090,
+  l_sharded_finisher_queue_len,
+  l_sharded_finisher_complete_lat,
+  l_sharded_finisher_queue_lat,
+  l_sharded_finisher_queue_lat_histogram,
+  l_sharded_finisher_last
+};
+
+/** @brief Finisher with several worker threads.
+ * Contexts are queued along with an ordering key.  Contexts queued with
+ * the same key are completed in the order they were queued, all on the
+ * same thread; contexts queued with different keys may be completed
+ * concurrently and in any order.  Queueing takes no lock unless the
+ * thread it goes to is asleep.
+ */
+class ShardedFinisher {
+  CephContext *const cct;
+  const std::string thread_name;
+
+  struct item_t {
+    Context *c;
+    int r;
+    ceph::mono_time stamp;
+    item_t *next;
+  };
+
+  struct Lane : public Thread {
+    ShardedFinisher *fin;
+    /// newest first; the lane's thread takes them all at once
+    std::atomic<item_t*> head = {nullptr};
+    std::atomic<bool> sleeping = {false};
+    ceph::mutex lock = ceph::make_mutex("ShardedFinisher::Lane::lock");
+    ceph::condition_variable cond;
+    bool stop = false;
+
+    explicit Lane(ShardedFinisher *f) : fin(f) {}
+    /// push the chain first..last, which is newest first
+    void push(item_t *first, item_t *last);
+    void* entry() override;
+  };
+  std::vector<std::unique_ptr<Lane>> lanes;
+
+  /// queued and not completed yet
+  std::atomic<uint64_t> in_flight = {0};
+  std::atomic<unsigned> empty_waiters = {0};
+  ceph::mutex empty_lock = ceph::make_mutex("ShardedFinisher::empty_lock");
+  ceph::condition_variable empty_cond;
+
+  PerfCounters *logger = nullptr;
+
+  Lane& get_lane(uint64_t key) {
+    // keys are often pointers, whose low bits are all alike; mix them in
+    uint64_t h = key * 0x9e3779b97f4a7c15ull;
+    return *lanes[(h >> 32) % lanes.size()];
+  }
+  item_t *make_item(Context *c, int r, item_t *next) {
+    return new item_t{c, r, logger ? ceph::mono_clock::now() : ceph::mono_time(),
+		      next};
+  }
+  void complete(item_t *batch);
+
+ public:
+  /// Construct a finisher with @p num_threads threads, whose perf counters
+  /// are named after @p name.
+  ShardedFinisher(CephContext *cct_, std::string_view name, std::string &&tn,
+		  unsigned num_threads);
+  ~ShardedFinisher();
+
+  /// Add a context to complete in order with the others queued with @p key.
+  void queue(uint64_t key, Context *c, int r = 0) {
+    ++in_flight;
+    if (logger)
+      logger->inc(l_sharded_finisher_queue_len);
+    item_t *i = make_item(c, r, nullptr);
+    get_lane(key).push(i, i);
+  }
+
+  template<typename T>
+  auto queue(uint64_t key, T &ls)
+    -> decltype(std::distance(ls.begin(), ls.end()), void()) {
+    if (ls.empty())
+      return;
+    item_t *first = nullptr, *last = nullptr;
+    for (Context *c : ls) {
+      first = make_item(c, 0, first);
+      if (!last)
+	last = first;
+    }
+    in_flight += ls.size();
+    if (logger)
+      logger->inc(l_sharded_finisher_queue_len, ls.size());
+    get_lane(key).push(first, last);
+    ls.clear();
+  }
+
+  /// Start the worker threads.
+  void start();
+
+  /** @brief Stop the worker threads.
+   *
+   * The threads complete what has already been queued to them before they
+   * exit.  See Finisher::stop(). */
+  void stop();
+
+  /// Blocks until the finisher has nothing left to process.
+  void wait_for_empty();
+
+  bool is_empty() const {
+    return in_flight == 0;
+  }
+
+  unsigned get_num_threads() const {
+    return lanes.size();
+  }
+};
+
 /// Context that is completed asynchronously on the supplied finisher.
 class C_OnFinisher : public Context {
   Context *con;
@@ -14,6 +14,7 @@
 
 #include "PriorityCache.h"
 #include "common/dout.h"
+#include "include/util.h"
 #include "perfglue/heap_profiler.h"
 #define dout_context cct
 #define dout_subsys ceph_subsys_prioritycache
@@ -95,6 +96,23 @@ namespace PriorityCache
               "current memory available for caches.", "c",
               PerfCountersBuilder::PRIO_INTERESTING, unit_t(UNIT_BYTES));
 
+    b.add_u64(MallocStats::M_CGROUP_CURRENT_BYTES, "cgroup_current_bytes",
+              "memory charged to our cgroup", "cgc",
+              PerfCountersBuilder::PRIO_USEFUL, unit_t(UNIT_BYTES));
+
+    b.add_u64(MallocStats::M_CGROUP_MAX_BYTES, "cgroup_max_bytes",
+              "memory limit of our cgroup (0 if none)", "cgm",
+              PerfCountersBuilder::PRIO_USEFUL, unit_t(UNIT_BYTES));
+
+    b.add_u64(MallocStats::M_MEMORY_PRESSURE, "memory_pressure",
+              "share of the last 10s some task was stalled on memory, "
+              "in 1/100 of a percent", "psi",
+              PerfCountersBuilder::PRIO_USEFUL);
+
+    b.add_u64_counter(MallocStats::M_PRESSURE_SHRINKS, "pressure_shrinks",
+              "times the caches were shrunk because of memory pressure", "ps",
+              PerfCountersBuilder::PRIO_USEFUL);
+
     logger = b.create_perf_counters();
     cct->get_perfcounters_collection()->add(logger);
 
@@ -108,7 +126,7 @@ namespace PriorityCache
     delete logger;
   }
 
-  void Manager::tune_memory()
+  bool Manager::tune_memory()
   {
     size_t heap_size = 0;
     size_t unmapped = 0;
@@ -119,34 +137,74 @@ namespace PriorityCache
     ceph_heap_get_numeric_property("tcmalloc.pageheap_unmapped_bytes", &unmapped);
     mapped = heap_size - unmapped;
 
+    // In a container the cgroup limit is what gets us OOM killed, whatever
+    // the configured target says.
+    uint64_t target = target_mem;
+    uint64_t cg_current = 0;
+    uint64_t cg_max = 0;
+    if (cgroup_limit_ratio > 0 &&
+        get_cgroup_memory_usage(&cg_current, &cg_max) == 0 && cg_max > 0) {
+      uint64_t cg_target = cg_max * cgroup_limit_ratio;
+      target = (target < cg_target) ? target : cg_target;
+    }
+
+    // The kernel tells us when reclaim starts to hurt long before the heap
+    // outgrows the target (page cache, other tenants of the cgroup...).
+    double stall = 0;
+    bool pressure = pressure_threshold > 0 &&
+                    get_memory_pressure(&stall) == 0 &&
+                    stall >= pressure_threshold;
+
     uint64_t new_size = tuned_mem;
     new_size = (new_size < max_mem) ? new_size : max_mem;
     new_size = (new_size > min_mem) ? new_size : min_mem;
 
-    // Approach the min/max slowly, but bounce away quickly.
-    if ((uint64_t) mapped < target_mem) {
-      double ratio = 1 - ((double) mapped / target_mem);
-      new_size += ratio * (max_mem - new_size);
+    // avg10 stays up for a while after a single episode and we are called
+    // a lot more often than that, so only shrink once per window and hold
+    // the size in between.
+    bool shrink = false;
+    auto now = ceph::mono_clock::now();
+    if (pressure && now - last_pressure_shrink >= std::chrono::seconds(10)) {
+      // Give back half of what we have above the minimum right away.
+      new_size -= (new_size - min_mem) / 2;
+      last_pressure_shrink = now;
+      shrink = true;
+      logger->inc(MallocStats::M_PRESSURE_SHRINKS);
+    } else if ((uint64_t) mapped < target) {
+      // Approach the min/max slowly, but bounce away quickly.  Don't grow
+      // back while still under pressure, though.
+      if (!pressure) {
+        double ratio = 1 - ((double) mapped / target);
+        new_size += ratio * (max_mem - new_size);
+      }
     } else { 
-      double ratio = 1 - ((double) target_mem / mapped);
+      double ratio = 1 - ((double) target / mapped);
       new_size -= ratio * (new_size - min_mem);
     }
 
     ldout(cct, 5) << __func__
                   << " target: " << target_mem
+                  << " effective target: " << target
                   << " mapped: " << mapped  
                   << " unmapped: " << unmapped
                   << " heap: " << heap_size
+                  << " cgroup current: " << cg_current
+                  << " cgroup max: " << cg_max
+                  << " memory pressure: " << stall
                   << " old mem: " << tuned_mem
                   << " new mem: " << new_size << dendl;
 
     tuned_mem = new_size;
 
-    logger->set(MallocStats::M_TARGET_BYTES, target_mem);
+    logger->set(MallocStats::M_TARGET_BYTES, target);
     logger->set(MallocStats::M_MAPPED_BYTES, mapped);
     logger->set(MallocStats::M_UNMAPPED_BYTES, unmapped);
     logger->set(MallocStats::M_HEAP_BYTES, heap_size);
     logger->set(MallocStats::M_CACHE_BYTES, new_size);
+    logger->set(MallocStats::M_CGROUP_CURRENT_BYTES, cg_current);
+    logger->set(MallocStats::M_CGROUP_MAX_BYTES, cg_max);
+    logger->set(MallocStats::M_MEMORY_PRESSURE, stall * 100);
+    return shrink;
   }
 
   void Manager::insert(const std::string& name, std::shared_ptr<PriCache> c,
@@ -229,6 +287,10 @@ namespace PriorityCache
               "total bytes committed,", "c",
               PerfCountersBuilder::PRIO_USEFUL, unit_t(UNIT_BYTES));
 
+    b.add_u64_counter(cur_index + Extra::E_SHRINKS, "shrinks",
+              "times the committed size was reduced", "s",
+              PerfCountersBuilder::PRIO_USEFUL);
+
     for (int i = 0; i < Extra::E_LAST+1; i++) {
       indexes[name][i] = cur_index + i;
     }
@@ -304,12 +366,16 @@ namespace PriorityCache
       ceph_assert(it != caches.end());
 
       // Commit the new cache size
+      int64_t prev_committed = it->second->get_committed_size();
       int64_t committed = it->second->commit_cache_size(tuned_mem);
       // Update the perf counters
       int64_t alloc = it->second->get_cache_bytes();
 
       l.second->set(indexes[it->first][Extra::E_RESERVED], committed - alloc);
       l.second->set(indexes[it->first][Extra::E_COMMITTED], committed);
+      if (committed < prev_committed) {
+        l.second->inc(indexes[it->first][Extra::E_SHRINKS]);
+      }
     }
   }
 
@@ -20,6 +20,7 @@
 #include <vector>
 #include <memory>
 #include <unordered_map>
+#include "common/ceph_time.h"
 #include "common/perf_counters.h"
 #include "include/ceph_assert.h"
 
@@ -35,6 +36,10 @@ namespace PriorityCache {
     M_UNMAPPED_BYTES,
     M_HEAP_BYTES,
     M_CACHE_BYTES,
+    M_CGROUP_CURRENT_BYTES,
+    M_CGROUP_MAX_BYTES,
+    M_MEMORY_PRESSURE,
+    M_PRESSURE_SHRINKS,
     M_LAST,
   };
 
@@ -57,7 +62,8 @@ namespace PriorityCache {
   enum Extra {
     E_RESERVED = Priority::LAST+1,
     E_COMMITTED,
-    E_LAST = E_COMMITTED,
+    E_SHRINKS,
+    E_LAST = E_SHRINKS,
   };
 
   int64_t get_chunk(uint64_t usage, uint64_t total_bytes);
@@ -128,6 +134,12 @@ namespace PriorityCache {
     uint64_t max_mem = 0;
     uint64_t target_mem = 0;
     uint64_t tuned_mem = 0;
+    // cap target_mem at this share of the cgroup memory.max (0: don't)
+    double cgroup_limit_ratio = 0;
+    // shrink right away once PSI "some" avg10 reaches this (0: don't)
+    double pressure_threshold = 0;
+    // avg10 lags for up to 10 seconds: shrink at most once per window
+    ceph::mono_time last_pressure_shrink;
     bool reserve_extra;
     std::string name;
   public:
@@ -143,6 +155,12 @@ namespace PriorityCache {
     void set_target_memory(uint64_t target) {
       target_mem = target;
     }
+    void set_cgroup_limit_ratio(double ratio) {
+      cgroup_limit_ratio = ratio;
+    }
+    void set_pressure_threshold(double pct) {
+      pressure_threshold = pct;
+    }
     uint64_t get_tuned_mem() const {
       return tuned_mem;
     }
@@ -150,7 +168,9 @@ namespace PriorityCache {
                 bool enable_perf_counters);
     void erase(const std::string& name);
     void clear();
-    void tune_memory();
+    /// @returns true if memory pressure made us shrink the caches, in
+    /// which case the caller had better balance() now rather than later
+    bool tune_memory();
     void balance();
     void shift_bins();
   private:
@@ -3,6 +3,7 @@
 
 #include "common/Readahead.h"
 #include "common/Cond.h"
+#include "common/perf_counters.h"
 
 using std::vector;
 
@@ -11,12 +12,13 @@ Readahead::Readahead()
     m_readahead_min_bytes(0),
     m_readahead_max_bytes(NO_LIMIT),
     m_alignments(),
-    m_nr_consec_read(0),
-    m_consec_read_bytes(0),
-    m_last_pos(0),
-    m_readahead_pos(0),
-    m_readahead_trigger_pos(0),
-    m_readahead_size(0),
+    m_streams(1),
+    m_max_streams(1),
+    m_max_stride(0),
+    m_tick(0),
+    m_logger(nullptr),
+    m_l_hit_bytes(0),
+    m_l_wasted_bytes(0),
     m_pending(0) {
 }
 
@@ -24,67 +26,118 @@ Readahead::~Readahead() {
 }
 
 Readahead::extent_t Readahead::update(const vector<extent_t>& extents, uint64_t limit) {
-  m_lock.lock();
+  std::lock_guard l(m_lock);
+  stream_t *s = nullptr;
   for (vector<extent_t>::const_iterator p = extents.begin(); p != extents.end(); ++p) {
-    _observe_read(p->first, p->second);
+    s = &_observe_read(p->first, p->second);
   }
-  if (m_readahead_pos >= limit|| m_last_pos >= limit) {
-    m_lock.unlock();
+  if (!s || s->readahead_pos >= limit || s->last_pos >= limit) {
     return extent_t(0, 0);
   }
-  std::pair<uint64_t, uint64_t> extent = _compute_readahead(limit);
-  m_lock.unlock();
-  return extent;
+  return _compute_readahead(*s, limit);
 }
 
 Readahead::extent_t Readahead::update(uint64_t offset, uint64_t length, uint64_t limit) {
-  m_lock.lock();
-  _observe_read(offset, length);
-  if (m_readahead_pos >= limit || m_last_pos >= limit) {
-    m_lock.unlock();
+  std::lock_guard l(m_lock);
+  stream_t& s = _observe_read(offset, length);
+  if (s.readahead_pos >= limit || s.last_pos >= limit) {
     return extent_t(0, 0);
   }
-  extent_t extent = _compute_readahead(limit);
-  m_lock.unlock();
-  return extent;
+  return _compute_readahead(s, limit);
 }
 
-void Readahead::_observe_read(uint64_t offset, uint64_t length) {
-  if (offset == m_last_pos) {
-    m_nr_consec_read++;
-    m_consec_read_bytes += length;
+Readahead::stream_t& Readahead::_observe_read(uint64_t offset, uint64_t length) {
+  ++m_tick;
+  stream_t *match = nullptr;
+  stream_t *strided = nullptr;
+  stream_t *lru = nullptr;
+  for (auto& s : m_streams) {
+    if (offset == s.last_pos + s.stride) {
+      match = &s;
+      break;
+    }
+    if (m_max_stride && !strided && s.stride == 0 && s.nr_consec_read == 0 &&
+	offset > s.last_pos && offset - s.last_pos <= m_max_stride) {
+      strided = &s;
+    }
+    if (!lru || s.last_used < lru->last_used) {
+      lru = &s;
+    }
+  }
+
+  stream_t *s;
+  if (match) {
+    s = match;
+    s->nr_consec_read++;
+    // for a strided stream, count the gap too so that the readahead
+    // window grows with what the stream actually covers
+    s->consec_read_bytes += length + s->stride;
+    if (offset < s->readahead_pos && offset + length > s->readahead_start) {
+      uint64_t hit = std::min(offset + length, s->readahead_pos) -
+	std::max(offset, s->readahead_start);
+      m_stats.hit_bytes += hit;
+      if (m_logger) {
+	m_logger->inc(m_l_hit_bytes, hit);
+      }
+    }
+    s->last_pos = offset + length;
+  } else if (strided) {
+    // a new stream that skipped ahead; see if it keeps doing so
+    s = strided;
+    _restart_stream(*s, offset + length, offset - s->last_pos);
   } else {
-    m_nr_consec_read = 0;
-    m_consec_read_bytes = 0;
-    m_readahead_trigger_pos = 0;
-    m_readahead_size = 0;
-    m_readahead_pos = 0;
+    if (m_streams.size() < m_max_streams) {
+      s = &m_streams.emplace_back();
+    } else {
+      s = lru;
+    }
+    _restart_stream(*s, offset + length, 0);
   }
-  m_last_pos = offset + length;
+  s->last_used = m_tick;
+  return *s;
 }
 
-Readahead::extent_t Readahead::_compute_readahead(uint64_t limit) {
+void Readahead::_restart_stream(stream_t& s, uint64_t pos, uint64_t stride) {
+  uint64_t unread = std::max(s.last_pos, s.readahead_start);
+  if (s.readahead_pos > unread) {
+    m_stats.wasted_bytes += s.readahead_pos - unread;
+    if (m_logger) {
+      m_logger->inc(m_l_wasted_bytes, s.readahead_pos - unread);
+    }
+  }
+  s.nr_consec_read = 0;
+  s.consec_read_bytes = 0;
+  s.last_pos = pos;
+  s.stride = stride;
+  s.readahead_start = 0;
+  s.readahead_pos = 0;
+  s.readahead_trigger_pos = 0;
+  s.readahead_size = 0;
+}
+
+Readahead::extent_t Readahead::_compute_readahead(stream_t& s, uint64_t limit) {
   uint64_t readahead_offset = 0;
   uint64_t readahead_length = 0;
-  if (m_nr_consec_read >= m_trigger_requests) {
+  if (s.nr_consec_read >= m_trigger_requests) {
     // currently reading sequentially
-    if (m_last_pos >= m_readahead_trigger_pos) {
+    if (s.last_pos >= s.readahead_trigger_pos) {
       // need to read ahead
-      if (m_readahead_size == 0) {
+      if (s.readahead_size == 0) {
 	// initial readahead trigger
-	m_readahead_size = m_consec_read_bytes;
-	m_readahead_pos = m_last_pos;
+	s.readahead_size = s.consec_read_bytes;
+	s.readahead_pos = s.last_pos;
+	s.readahead_start = s.last_pos;
       } else {
 	// continuing readahead trigger
-	m_readahead_size *= 2;
-	if (m_last_pos > m_readahead_pos) {
-	  m_readahead_pos = m_last_pos;
+	s.readahead_size *= 2;
+	if (s.last_pos > s.readahead_pos) {
+	  s.readahead_pos = s.last_pos;
 	}
       }
-      m_readahead_size = std::max(m_readahead_size, m_readahead_min_bytes);
-      m_readahead_size = std::min(m_readahead_size, m_readahead_max_bytes);
-      readahead_offset = m_readahead_pos;
-      readahead_length = m_readahead_size;
+      s.readahead_size = std::max(s.readahead_size, m_readahead_min_bytes);
+      s.readahead_size = std::min(s.readahead_size, m_readahead_max_bytes);
+      readahead_offset = s.readahead_pos;
+      readahead_length = s.readahead_size;
 
       // Snap to the first alignment possible
       uint64_t readahead_end = readahead_offset + readahead_length;
@@ -106,15 +159,16 @@ Readahead::extent_t Readahead::_compute_readahead(uint64_t limit) {
 	  readahead_length = align_next - readahead_offset;
 	  break;
 	}
-	// Note that m_readahead_size should remain unadjusted.
+	// Note that s.readahead_size should remain unadjusted.
       }
 
-      if (m_readahead_pos + readahead_length > limit) {
-	readahead_length = limit - m_readahead_pos;
+      if (s.readahead_pos + readahead_length > limit) {
+	readahead_length = limit - s.readahead_pos;
       }
 
-      m_readahead_trigger_pos = m_readahead_pos + readahead_length / 2;
-      m_readahead_pos += readahead_length;
+      s.readahead_trigger_pos = s.readahead_pos + readahead_length / 2;
+      s.readahead_pos += readahead_length;
+      m_stats.issued_bytes += readahead_length;
     }
   }
   return extent_t(readahead_offset, readahead_length);
@@ -194,3 +248,29 @@ void Readahead::set_alignments(const vector<uint64_t> &alignments) {
   m_alignments = alignments;
   m_lock.unlock();
 }
+
+void Readahead::set_max_streams(unsigned max_streams) {
+  std::lock_guard lock(m_lock);
+  m_max_streams = std::max(1u, max_streams);
+  if (m_streams.size() > m_max_streams) {
+    m_streams.resize(m_max_streams);
+  }
+}
+
+void Readahead::set_max_stride(uint64_t max_stride) {
+  std::lock_guard lock(m_lock);
+  m_max_stride = max_stride;
+}
+
+Readahead::stats_t Readahead::get_stats() {
+  std::lock_guard lock(m_lock);
+  return m_stats;
+}
+
+void Readahead::set_perf_counters(PerfCounters *logger, int hit_bytes_idx,
+                                  int wasted_bytes_idx) {
+  std::lock_guard lock(m_lock);
+  m_logger = logger;
+  m_l_hit_bytes = hit_bytes_idx;
+  m_l_wasted_bytes = wasted_bytes_idx;
+}
@@ -8,6 +8,7 @@
 #include <vector>
 
 #include "include/Context.h"
+#include "include/common_fwd.h"
 #include "common/ceph_mutex.h"
 
 /**
@@ -17,6 +18,11 @@
 
    Minimum and maximum readahead sizes may be violated by up to 50\% if alignment is enabled.
    Minimum readahead size may be violated if the end of the readahead target is reached.
+
+   Several interleaved read streams (e.g. multiple readers of one image) can be tracked
+   at once, see set_max_streams(); each has its own readahead window.  A stream may also
+   advance with a constant gap between reads instead of strictly sequentially, see
+   set_max_stride().  Readahead for a strided stream covers the gaps as well.
  */
 class Readahead {
 public:
@@ -25,6 +31,15 @@ public:
   // equal to UINT64_MAX
   static const uint64_t NO_LIMIT = 18446744073709551615ULL;
 
+  struct stats_t {
+    /// bytes returned for readahead by update()
+    uint64_t issued_bytes = 0;
+    /// bytes of reads that fell into an earlier readahead of their stream
+    uint64_t hit_bytes = 0;
+    /// bytes read ahead for streams that were abandoned before reaching them
+    uint64_t wasted_bytes = 0;
+  };
+
   Readahead();
 
   ~Readahead();
@@ -108,18 +123,65 @@ public:
    */
   void set_alignments(const std::vector<uint64_t> &alignments);
 
+  /**
+     Sets the number of read streams tracked at once (1 by default).
+     When a read continues none of them, the least recently used one is restarted.
+   */
+  void set_max_streams(unsigned max_streams);
+
+  /**
+     Sets the largest gap between consecutive reads of a stream (0, the default,
+     only recognizes strictly sequential streams).
+   */
+  void set_max_stride(uint64_t max_stride);
+
+  stats_t get_stats();
+
+  /**
+     Reports readahead hits and waste, in bytes, to \c logger (may be nullptr).
+   */
+  void set_perf_counters(PerfCounters *logger, int hit_bytes_idx,
+                         int wasted_bytes_idx);
+
 private:
+  struct stream_t {
+    /// Number of consecutive read requests in the stream
+    int nr_consec_read = 0;
+    /// Number of bytes read in the stream
+    uint64_t consec_read_bytes = 0;
+    /// Position of the read stream
+    uint64_t last_pos = 0;
+    /// Gap between consecutive reads, 0 if the stream is sequential
+    uint64_t stride = 0;
+    /// Start of the readahead issued for the stream, if any
+    uint64_t readahead_start = 0;
+    /// Position of the readahead stream
+    uint64_t readahead_pos = 0;
+    /// When readahead is already triggered and the read stream crosses this point, readahead is continued
+    uint64_t readahead_trigger_pos = 0;
+    /// Size of the next readahead request (barring changes due to alignment, etc.)
+    uint64_t readahead_size = 0;
+    /// Value of m_tick when the stream was last read from
+    uint64_t last_used = 0;
+  };
+
   /**
-     Records that a read request has been received.
+     Records that a read request has been received and returns the stream it belongs to.
      m_lock must be held while calling.
    */
-  void _observe_read(uint64_t offset, uint64_t length);
+  stream_t& _observe_read(uint64_t offset, uint64_t length);
 
   /**
-     Computes the next readahead request.
+     Forgets what we know about \c s and starts it over at \c pos.
+     m_lock must be held while calling.
+   */
+  void _restart_stream(stream_t& s, uint64_t pos, uint64_t stride);
+
+  /**
+     Computes the next readahead request for \c s.
      m_lock must be held while calling.
   */
-  extent_t _compute_readahead(uint64_t limit);
+  extent_t _compute_readahead(stream_t& s, uint64_t limit);
 
   /// Number of sequential requests necessary to trigger readahead
   int m_trigger_requests;
@@ -136,23 +198,21 @@ private:
   /// Held while reading/modifying any state except m_pending
   ceph::mutex m_lock = ceph::make_mutex("Readahead::m_lock");
 
-  /// Number of consecutive read requests in the current sequential stream
-  int m_nr_consec_read;
-
-  /// Number of bytes read in the current sequenial stream
-  uint64_t m_consec_read_bytes;
+  /// Read streams being tracked, at most m_max_streams
+  std::vector<stream_t> m_streams;
 
-  /// Position of the read stream
-  uint64_t m_last_pos;
+  unsigned m_max_streams;
 
-  /// Position of the readahead stream
-  uint64_t m_readahead_pos;
+  /// Largest gap between the reads of a strided stream
+  uint64_t m_max_stride;
 
-  /// When readahead is already triggered and the read stream crosses this point, readahead is continued
-  uint64_t m_readahead_trigger_pos;
+  /// Counts reads, to find the least recently used stream
+  uint64_t m_tick;
 
-  /// Size of the next readahead request (barring changes due to alignment, etc.)
-  uint64_t m_readahead_size;
+  stats_t m_stats;
+  PerfCounters *m_logger;
+  int m_l_hit_bytes;
+  int m_l_wasted_bytes;
 
   /// Number of pending readahead requests, as determined by inc_pending() and dec_pending()
   int m_pending;
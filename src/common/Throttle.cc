@@ -92,31 +92,65 @@ void Throttle::_reset_max(int64_t m)
 
 bool Throttle::_wait(int64_t c, std::unique_lock<std::mutex>& l)
 {
+  // always wait behind other waiters.
+  if (conds.empty() && _try_take(c)) {
+    return false;
+  }
   mono_time start;
-  bool waited = false;
-  if (_should_wait(c) || !conds.empty()) { // always wait behind other waiters.
-    {
-      auto cv = conds.emplace(conds.end());
-      auto w = make_scope_guard([this, cv]() {
-	  conds.erase(cv);
-	});
-      waited = true;
-      ldout(cct, 2) << "_wait waiting..." << dendl;
-      if (logger)
-	start = mono_clock::now();
-
-      cv->wait(l, [this, c, cv]() { return (!_should_wait(c) &&
-					    cv == conds.begin()); });
-      ldout(cct, 2) << "_wait finished waiting" << dendl;
-      if (logger) {
-	logger->tinc(l_throttle_wait, mono_clock::now() - start);
-      }
+  {
+    auto cv = conds.emplace(conds.end());
+    // must be visible before we look at count again, so that a put()
+    // which misses our check below comes to wake us up
+    ++waiters;
+    auto w = make_scope_guard([this, cv]() {
+	--waiters;
+	conds.erase(cv);
+      });
+    ldout(cct, 2) << "_wait waiting..." << dendl;
+    if (logger)
+      start = mono_clock::now();
+
+    // take our slots while still at the head of the queue, so that we
+    // keep our place if a lockless get() races with us
+    cv->wait(l, [this, c, cv]() { return (cv == conds.begin() &&
+					  _try_take(c)); });
+    ldout(cct, 2) << "_wait finished waiting" << dendl;
+    if (logger) {
+      logger->tinc(l_throttle_wait, mono_clock::now() - start);
+    }
+  }
+  // wake up the next guy
+  if (!conds.empty())
+    conds.front().notify_one();
+  return true;
+}
+
+bool Throttle::_try_take(int64_t c)
+{
+  int64_t cur = count;
+  while (!_should_wait(c, cur, max)) {
+    if (count.compare_exchange_weak(cur, cur + c)) {
+      return true;
     }
-    // wake up the next guy
+  }
+  return false;
+}
+
+bool Throttle::_try_take_lockless(int64_t c)
+{
+  if (waiters || !_try_take(c)) {
+    return false;
+  }
+  if (waiters) {
+    // somebody queued up while we took the slots; they may need them, so
+    // give them back and get in line
+    count -= c;
+    std::lock_guard l(lock);
     if (!conds.empty())
       conds.front().notify_one();
+    return false;
   }
-  return waited;
+  return true;
 }
 
 bool Throttle::wait(int64_t m)
@@ -163,14 +197,14 @@ bool Throttle::get(int64_t c, int64_t m)
     logger->inc(l_throttle_get_started);
   }
   bool waited = false;
-  {
+  // nobody is queued and there is room: no need for the lock
+  if (m || !_try_take_lockless(c)) {
     std::unique_lock l(lock);
     if (m) {
       ceph_assert(m > 0);
       _reset_max(m);
     }
     waited = _wait(c, l);
-    count += c;
   }
   if (logger) {
     logger->inc(l_throttle_get);
@@ -191,18 +225,11 @@ bool Throttle::get_or_fail(int64_t c)
   }
 
   assert (c >= 0);
-  bool result = false;
-  {
-    std::lock_guard l(lock);
-    if (_should_wait(c) || !conds.empty()) {
-      ldout(cct, 10) << "get_or_fail " << c << " failed" << dendl;
-      result = false;
-    } else {
-      ldout(cct, 10) << "get_or_fail " << c << " success (" << count.load()
-	<< " -> " << (count.load() + c) << ")" << dendl;
-      count += c;
-      result = true;
-    }
+  bool result = _try_take_lockless(c);
+  if (result) {
+    ldout(cct, 10) << "get_or_fail " << c << " success" << dendl;
+  } else {
+    ldout(cct, 10) << "get_or_fail " << c << " failed" << dendl;
   }
 
   if (logger) {
@@ -228,17 +255,13 @@ int64_t Throttle::put(int64_t c)
   ceph_assert(c >= 0);
   ldout(cct, 10) << "put " << c << " (" << count.load() << " -> "
 		 << (count.load()-c) << ")" << dendl;
-  int64_t new_count;
-  {
+  int64_t new_count = count -= c;
+  // if count goes negative, we failed somewhere!
+  ceph_assert(new_count >= 0);
+  if (c && waiters) {
     std::lock_guard l(lock);
-    new_count = count;
-    if (c) {
-      if (!conds.empty())
-	conds.front().notify_one();
-      // if count goes negative, we failed somewhere!
-      ceph_assert(count >= c);
-      new_count = count -= c;
-    }
+    if (!conds.empty())
+      conds.front().notify_one();
   }
   if (logger) {
     logger->inc(l_throttle_put);
@@ -36,6 +36,10 @@ class Throttle final : public ThrottleInterface {
   std::atomic<int64_t> count = { 0 }, max = { 0 };
   std::mutex lock;
   std::list<std::condition_variable> conds;
+  /// conds.size(), readable without the lock; get() and get_or_fail()
+  /// only take the lockless path and put() only takes the lock to wake
+  /// somebody if this is non-zero.
+  std::atomic<unsigned> waiters = { 0 };
   const bool use_perf;
 
 public:
@@ -44,15 +48,23 @@ public:
 
 private:
   void _reset_max(int64_t m);
-  bool _should_wait(int64_t c) const {
-    int64_t m = max;
-    int64_t cur = count;
+  static bool _should_wait(int64_t c, int64_t cur, int64_t m) {
     return
       m &&
       ((c <= m && cur + c > m) || // normally stay under max
        (c >= m && cur > m));     // except for large c
   }
+  bool _should_wait(int64_t c) const {
+    return _should_wait(c, count, max);
+  }
 
+  /// add @p c to count unless that would have to wait; does not look at
+  /// the waiters
+  bool _try_take(int64_t c);
+  /// like _try_take(), but always fails while anybody is queued, so that
+  /// lockless getters never overtake a waiter
+  bool _try_take_lockless(int64_t c);
+  /// queue up until @p c can be added to count, and add it
   bool _wait(int64_t c, std::unique_lock<std::mutex>& l);
 
 public:
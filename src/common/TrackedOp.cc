@@ -311,6 +311,16 @@ void OpTracker::unregister_inflight_op(TrackedOp* const i)
   }
 }
 
+bool OpTracker::want_history_op(TrackedOp& i)
+{
+  if (!tracking_enabled)
+    return false;
+  std::lock_guard l(i.lock);
+  // "done" was just marked
+  return !i.light ||
+    ceph_clock_now() - i.get_initiated() >= sample_threshold.load();
+}
+
 void OpTracker::record_history_op(TrackedOpRef&& i)
 {
   std::shared_lock l{lock};
@@ -489,7 +499,11 @@ void TrackedOp::mark_event(std::string_view event, utime_t stamp)
 
   {
     std::lock_guard l(lock);
-    events.emplace_back(stamp, event);
+    if (light) {
+      _mark_light_event(event, stamp);
+    } else {
+      events.emplace_back(stamp, event);
+    }
   }
   dout(6) << " seq: " << seq
 	  << ", time: " << stamp
@@ -499,11 +513,41 @@ void TrackedOp::mark_event(std::string_view event, utime_t stamp)
   _event_marked();
 }
 
+void TrackedOp::_mark_light_event(std::string_view event, utime_t stamp)
+{
+  // once full, keep overwriting the last entry so that the most recent
+  // event (e.g. "done") is still there
+  auto& e = light_events[std::min<unsigned>(num_light_events,
+					    MAX_LIGHT_EVENTS - 1)];
+  if (num_light_events < MAX_LIGHT_EVENTS) {
+    num_light_events++;
+  }
+  e.stamp = stamp;
+  e.str[event.copy(e.str, sizeof(e.str) - 1)] = '\0';
+}
+
+void TrackedOp::_expand_light_events() const
+{
+  if (!light)
+    return;
+  events.reserve(num_light_events + OPTRACKER_PREALLOC_EVENTS / 2);
+  for (unsigned i = 0; i < num_light_events; i++) {
+    events.emplace_back(light_events[i].stamp, light_events[i].str);
+  }
+  num_light_events = 0;
+  light = false;
+}
+
 void TrackedOp::dump(utime_t now, Formatter *f, OpTracker::dumper lambda) const
 {
   // Ignore if still in the constructor
   if (!state)
     return;
+  {
+    // the type-specific dumpers look at events directly
+    std::lock_guard l(lock);
+    _expand_light_events();
+  }
   f->dump_string("description", get_desc());
   f->dump_stream("initiated_at") << get_initiated();
   f->dump_float("age", now - get_initiated());
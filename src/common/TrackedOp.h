@@ -14,6 +14,7 @@
 #ifndef TRACKEDREQUEST_H_
 #define TRACKEDREQUEST_H_
 
+#include <array>
 #include <atomic>
 #include "common/StackStringStream.h"
 #include "common/ceph_mutex.h"
@@ -129,6 +130,8 @@ class OpTracker {
   float complaint_time;
   int log_threshold;
   std::atomic<bool> tracking_enabled;
+  std::atomic<uint32_t> sample_rate = {1};
+  std::atomic<float> sample_threshold = {0};
   ceph::shared_mutex lock = ceph::make_shared_mutex("OpTracker::lock");
 
 public:
@@ -153,6 +156,20 @@ public:
   void set_tracking(bool enable) {
     tracking_enabled = enable;
   }
+  /**
+   * Only keep the full event list of one in @p rate ops.  The others
+   * record their events as fixed-size entries (see TrackedOp::LightEvent)
+   * and only make it to the op history if they took longer than
+   * @p threshold seconds.
+   */
+  void set_sampling(uint32_t rate, float threshold) {
+    sample_rate = rate;
+    sample_threshold = threshold;
+  }
+  bool should_sample(uint64_t op_seq) const {
+    const auto rate = sample_rate.load();
+    return rate <= 1 || op_seq % rate == 0;
+  }
   static void default_dumper(const TrackedOp& op, Formatter* f);
   bool dump_ops_in_flight(ceph::Formatter *f, bool print_only_blocked = false, std::set<std::string> filters = {""}, bool count_only = false, dumper lambda = default_dumper);
   bool dump_historic_ops(ceph::Formatter *f, bool by_duration = false, std::set<std::string> filters = {""});
@@ -160,6 +177,7 @@ public:
   bool register_inflight_op(TrackedOp *i);
   void unregister_inflight_op(TrackedOp *i);
   void record_history_op(TrackedOpRef&& i);
+  bool want_history_op(TrackedOp& i);
 
   void get_age_ms_histogram(pow2_hist_t *h);
 
@@ -284,7 +302,19 @@ protected:
     }
   };
 
-  std::vector<Event> events;    ///< std::list of events and their times
+  /// an event of an op that is not sampled; the name is truncated
+  struct LightEvent {
+    utime_t stamp;
+    char str[24];
+  };
+  static constexpr unsigned MAX_LIGHT_EVENTS = 16;
+
+  /// std::list of events and their times.  for ops that are not sampled
+  /// it is only filled from light_events once somebody looks at it.
+  mutable std::vector<Event> events;
+  mutable std::array<LightEvent, MAX_LIGHT_EVENTS> light_events;
+  mutable uint8_t num_light_events = 0;
+  mutable bool light = false;   ///< events go to light_events
   mutable ceph::mutex lock = ceph::make_mutex("TrackedOp::lock"); ///< to protect the events list
   uint64_t seq = 0;        ///< a unique value std::set by the OpTracker
 
@@ -309,9 +339,12 @@ protected:
     tracker(_tracker),
     initiated_at(initiated)
   {
-    events.reserve(OPTRACKER_PREALLOC_EVENTS);
   }
 
+  void _mark_light_event(std::string_view event, utime_t stamp);
+  /// move light_events over to events; lock must be held
+  void _expand_light_events() const;
+
   /// output any type-specific data you want to get when dump() is called
   virtual void _dump(ceph::Formatter *f) const {}
   /// if you want something else to happen when events are marked, implement
@@ -348,7 +381,7 @@ public:
 	mark_event("done");
 	tracker->unregister_inflight_op(this);
 	_unregistered();
-	if (!tracker->is_tracking()) {
+	if (!tracker->want_history_op(*this)) {
 	  delete this;
 	} else {
 	  state = TrackedOp::STATE_HISTORY;
@@ -410,6 +443,7 @@ public:
 
   double get_duration() const {
     std::lock_guard l(lock);
+    _expand_light_events();
     if (!events.empty() && events.rbegin()->compare("done") == 0)
       return events.rbegin()->stamp - get_initiated();
     else
@@ -424,6 +458,7 @@ public:
 
   std::string state_string() const {
     std::lock_guard l(lock);
+    _expand_light_events();
     return _get_state_string();
   }
 
@@ -431,7 +466,13 @@ public:
 
   void tracking_start() {
     if (tracker->register_inflight_op(this)) {
-      events.emplace_back(initiated_at, "initiated");
+      if (tracker->should_sample(seq)) {
+	events.reserve(OPTRACKER_PREALLOC_EVENTS);
+	events.emplace_back(initiated_at, "initiated");
+      } else {
+	light = true;
+	_mark_light_event("initiated", initiated_at);
+      }
       state = STATE_LIVE;
     }
   }
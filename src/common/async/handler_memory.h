@@ -0,0 +1,159 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation. See file COPYING.
+ *
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+#include <boost/asio/bind_allocator.hpp>
+
+namespace ceph::async {
+
+namespace detail {
+
+template <std::size_t SlotSize, std::size_t Slots>
+struct handler_arena {
+  // keeps every slot, not just the first, suitably aligned for any
+  // allocation that fits
+  static_assert(SlotSize % alignof(std::max_align_t) == 0,
+                "SlotSize must be a multiple of alignof(std::max_align_t)");
+
+  std::array<std::atomic<bool>, Slots> in_use{};
+  alignas(std::max_align_t) std::byte storage[Slots][SlotSize];
+
+  void* allocate(std::size_t size) {
+    if (size <= SlotSize) {
+      for (std::size_t i = 0; i < Slots; ++i) {
+        if (!in_use[i].exchange(true, std::memory_order_acquire)) {
+          return storage[i];
+        }
+      }
+    }
+    return ::operator new(size);
+  }
+
+  void deallocate(void* p) {
+    for (std::size_t i = 0; i < Slots; ++i) {
+      if (p == storage[i]) {
+        in_use[i].store(false, std::memory_order_release);
+        return;
+      }
+    }
+    ::operator delete(p);
+  }
+
+  std::size_t slots_in_use() const {
+    std::size_t n = 0;
+    for (auto& u : in_use) {
+      n += u.load(std::memory_order_relaxed);
+    }
+    return n;
+  }
+};
+
+} // namespace detail
+
+/// Reusable memory for the completion handlers of a chain of asynchronous
+/// operations, one after the other, such as those awaited by a coroutine.
+///
+/// Binding a completion token to it with bind_handler_memory() makes the
+/// handler's associated allocator serve the per-operation allocations
+/// (type-erased handlers like neorados', and the operation posted to the
+/// executor on completion) from a few fixed slots instead of the heap.
+/// Requests that don't fit, or that arrive while all slots are busy, fall
+/// back to operator new.
+///
+/// The slots are allocated once, and are kept alive by the allocators
+/// handed out so that a handler destroyed after its owner (say, when an
+/// io_context is shut down with operations still pending) can still
+/// release them.
+template <std::size_t SlotSize = 256, std::size_t Slots = 2>
+class handler_memory {
+  using arena_type = detail::handler_arena<SlotSize, Slots>;
+  std::shared_ptr<arena_type> arena = std::make_shared<arena_type>();
+
+ public:
+  template <typename T>
+  class allocator {
+    template <typename> friend class allocator;
+    std::shared_ptr<arena_type> arena;
+
+   public:
+    using value_type = T;
+    template <typename U>
+    struct rebind {
+      using other = allocator<U>;
+    };
+
+    explicit allocator(std::shared_ptr<arena_type> arena) noexcept
+      : arena(std::move(arena)) {}
+    template <typename U>
+    allocator(const allocator<U>& other) noexcept
+      : arena(other.arena) {}
+
+    T* allocate(std::size_t n) {
+      if constexpr (alignof(T) > alignof(std::max_align_t)) {
+        return std::allocator<T>().allocate(n);
+      } else {
+        return static_cast<T*>(arena->allocate(sizeof(T) * n));
+      }
+    }
+    void deallocate(T* p, std::size_t n) {
+      if constexpr (alignof(T) > alignof(std::max_align_t)) {
+        std::allocator<T>().deallocate(p, n);
+      } else {
+        arena->deallocate(p);
+      }
+    }
+
+    template <typename U>
+    bool operator==(const allocator<U>& other) const noexcept {
+      return arena == other.arena;
+    }
+  };
+
+  handler_memory() = default;
+  handler_memory(const handler_memory&) = delete;
+  handler_memory& operator=(const handler_memory&) = delete;
+
+  allocator<void> get_allocator() const noexcept {
+    return allocator<void>(arena);
+  }
+
+  /// Returns the number of slots currently holding an allocation.
+  std::size_t slots_in_use() const {
+    return arena->slots_in_use();
+  }
+};
+
+/// Bind a completion token to the given handler_memory.
+///
+/// \code
+/// ceph::async::handler_memory<> memory;
+/// for (auto& oid : oids) {
+///   co_await rados.execute(oid, ioc, make_op(),
+///       bind_handler_memory(memory, boost::asio::use_awaitable));
+/// }
+/// \endcode
+template <std::size_t SlotSize, std::size_t Slots, typename CompletionToken>
+auto bind_handler_memory(handler_memory<SlotSize, Slots>& memory,
+                         CompletionToken&& token)
+{
+  return boost::asio::bind_allocator(memory.get_allocator(),
+                                     std::forward<CompletionToken>(token));
+}
+
+} // namespace ceph::async
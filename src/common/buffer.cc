@@ -12,10 +12,16 @@
  *
  */
 
+#include <algorithm>
 #include <atomic>
+#include <cstddef>
 #include <cstring>
+#include <type_traits>
+#include <utility>
 #include <errno.h>
 #include <limits.h>
+#include <map>
+#include <mutex>
 
 #include <sys/uio.h>
 
@@ -38,6 +44,10 @@
 #include "include/spinlock.h"
 #include "include/scope_guard.h"
 
+#ifdef HAVE_EXECINFO_H
+#include <execinfo.h>
+#endif
+
 using std::cerr;
 using std::make_pair;
 using std::pair;
@@ -81,15 +91,212 @@ static ceph::spinlock debug_lock;
     return buffer_missed_crc;
   }
 
+  static ceph::atomic<unsigned> buffer_slab_hits { 0 };
+  static ceph::atomic<unsigned> buffer_slab_misses { 0 };
+
+  static bool buffer_track_slab = get_env_bool("CEPH_BUFFER_TRACK");
+#ifdef __SANITIZE_ADDRESS__
+  // let ASan see every allocation and free
+  static const bool buffer_slab_enabled = false;
+#else
+  static const bool buffer_slab_enabled = !get_env_bool("CEPH_BUFFER_NO_SLAB");
+#endif
+
+  void buffer::track_slab(bool b) {
+    buffer_track_slab = b;
+  }
+  int buffer::get_slab_hits() {
+    return buffer_slab_hits;
+  }
+  int buffer::get_slab_misses() {
+    return buffer_slab_misses;
+  }
+
+  static bool buffer_track_rebuild = get_env_bool("CEPH_BUFFER_TRACK");
+
+  namespace {
+  struct rebuild_stats_t {
+    uint64_t calls = 0;
+    uint64_t bytes = 0;
+  };
+  std::mutex rebuild_stats_lock;
+  std::map<const void*, rebuild_stats_t> rebuild_stats;
+  }
+
+  // remember that caller copied len bytes to make a list contiguous
+  static void note_rebuild(const void *caller, unsigned len) {
+    std::lock_guard l(rebuild_stats_lock);
+    auto& stats = rebuild_stats[caller];
+    stats.calls++;
+    stats.bytes += len;
+  }
+
+  void buffer::track_rebuild(bool b) {
+    buffer_track_rebuild = b;
+  }
+
+  void buffer::dump_rebuild_stats(std::ostream& out) {
+    std::vector<std::pair<const void*, rebuild_stats_t>> sites;
+    {
+      std::lock_guard l(rebuild_stats_lock);
+      sites.assign(rebuild_stats.begin(), rebuild_stats.end());
+    }
+    std::sort(sites.begin(), sites.end(), [](const auto& a, const auto& b) {
+      return a.second.bytes > b.second.bytes;
+    });
+    for (const auto& [caller, stats] : sites) {
+      out << stats.bytes << " bytes in " << stats.calls << " calls from ";
+#ifdef HAVE_EXECINFO_H
+      void *addr = const_cast<void*>(caller);
+      if (char **sym = backtrace_symbols(&addr, 1); sym) {
+	out << sym[0];
+	free(sym);
+      } else {
+	out << caller;
+      }
+#else
+      out << caller;
+#endif
+      out << std::endl;
+    }
+  }
+
+namespace {
+  /*
+   * Per-thread caches of ptr_nodes and of small raw_combined allocations.
+   *
+   * Message encode/decode and transactions create and destroy bufferlists
+   * at a high rate, and nearly every one of them needs a ptr_node and a
+   * CEPH_BUFFER_ALLOC_UNIT sized append buffer.  Both are recycled here
+   * instead of going back to the heap.  Objects freed by another thread
+   * than the one that allocated them simply land in the freeing thread's
+   * cache; everything is backed by plain heap allocations, so whatever
+   * is not cached is released the usual way.
+   */
+  struct buffer_slab_t {
+    struct free_t {
+      free_t *next;
+    };
+
+    // power of two block classes from 256 bytes up to ALLOC_UNIT
+    static constexpr unsigned MIN_SHIFT = 8;
+    static constexpr unsigned NUM_CLASSES = 5;
+    static_assert((1u << (MIN_SHIFT + NUM_CLASSES - 1)) ==
+		  CEPH_BUFFER_ALLOC_UNIT);
+    static constexpr unsigned MAX_NODES = 256;
+    static constexpr std::size_t MAX_CLASS_BYTES = 32 * 1024;
+
+    free_t *nodes;
+    unsigned num_nodes;
+    free_t *blocks[NUM_CLASSES];
+    unsigned num_blocks[NUM_CLASSES];
+    bool armed;  // reaper registered for this thread
+    bool dead;   // thread is exiting, cache is drained
+
+    static std::size_t class_size(int c) {
+      return std::size_t(1) << (c + MIN_SHIFT);
+    }
+    // block class for an allocation of len bytes, or -1 if it should
+    // bypass the cache (too big, or rounding up would waste over 25%)
+    static int get_class(std::size_t len) {
+      if (len > CEPH_BUFFER_ALLOC_UNIT) {
+	return -1;
+      }
+      unsigned shift = std::max<unsigned>(
+	MIN_SHIFT, std::numeric_limits<std::size_t>::digits -
+		   __builtin_clzl(std::max<std::size_t>(len, 2) - 1));
+      if (len * 4 <= (std::size_t(3) << shift)) {
+	return -1;
+      }
+      return shift - MIN_SHIFT;
+    }
+
+    static void *pop(free_t *&head, unsigned &num) {
+      free_t *f = head;
+      if (f) {
+	head = f->next;
+	--num;
+      }
+      if (unlikely(buffer_track_slab)) {
+	if (f) {
+	  buffer_slab_hits++;
+	} else {
+	  buffer_slab_misses++;
+	}
+      }
+      return f;
+    }
+    bool push(free_t *&head, unsigned &num, unsigned max, void *p);
+
+    void *get_node() {
+      return pop(nodes, num_nodes);
+    }
+    bool put_node(void *p) {
+      return push(nodes, num_nodes, MAX_NODES, p);
+    }
+    void *get_block(int c) {
+      return pop(blocks[c], num_blocks[c]);
+    }
+    bool put_block(int c, void *p) {
+      return push(blocks[c], num_blocks[c], MAX_CLASS_BYTES / class_size(c), p);
+    }
+
+    void drain() {
+      while (nodes) {
+	::operator delete(std::exchange(nodes, nodes->next));
+      }
+      num_nodes = 0;
+      for (unsigned c = 0; c < NUM_CLASSES; c++) {
+	while (blocks[c]) {
+	  aligned_free(std::exchange(blocks[c], blocks[c]->next));
+	}
+	num_blocks[c] = 0;
+      }
+    }
+  };
+  // trivially destructible, so it stays usable while other thread_local
+  // destructors of an exiting thread still release buffers
+  static_assert(std::is_trivially_destructible_v<buffer_slab_t>);
+  thread_local buffer_slab_t buffer_slab;
+
+  struct buffer_slab_reaper_t {
+    void arm() {}
+    ~buffer_slab_reaper_t() {
+      buffer_slab.drain();
+      buffer_slab.dead = true;
+    }
+  };
+  thread_local buffer_slab_reaper_t buffer_slab_reaper;
+
+  bool buffer_slab_t::push(free_t *&head, unsigned &num, unsigned max,
+			   void *p) {
+    if (!buffer_slab_enabled || dead || num >= max) {
+      return false;
+    }
+    if (unlikely(!armed)) {
+      // the first odr-use registers the reaper's destructor
+      buffer_slab_reaper.arm();
+      armed = true;
+    }
+    auto f = static_cast<free_t*>(p);
+    f->next = head;
+    head = f;
+    ++num;
+    return true;
+  }
+} // anonymous namespace
+
   /*
    * raw_combined is always placed within a single allocation along
    * with the data buffer.  the data goes at the beginning, and
    * raw_combined at the end.
    */
   class buffer::raw_combined : public buffer::raw {
+    // block class within buffer_slab_t, or -1 if not from the slab
+    int slab_class;
   public:
-    raw_combined(char *dataptr, unsigned l, int mempool)
-      : raw(dataptr, l, mempool) {
+    raw_combined(char *dataptr, unsigned l, int mempool, int slab_class)
+      : raw(dataptr, l, mempool), slab_class(slab_class) {
     }
 
     static ceph::unique_leakable_ptr<buffer::raw>
@@ -102,27 +309,43 @@ static ceph::spinlock debug_lock;
       size_t rawlen = round_up_to(sizeof(buffer::raw_combined),
 				  alignof(buffer::raw_combined));
       size_t datalen = round_up_to(len, alignof(buffer::raw_combined));
+      size_t alloclen = rawlen + datalen;
 
+      char *ptr = 0;
+      int slab_class = -1;
+      if (align <= alignof(std::max_align_t)) {
+	slab_class = buffer_slab_t::get_class(alloclen);
+	if (slab_class >= 0) {
+	  alloclen = buffer_slab_t::class_size(slab_class);
+	  datalen = alloclen - rawlen;
+	  ptr = (char *)buffer_slab.get_block(slab_class);
+	  align = alignof(std::max_align_t);
+	}
+      }
+      if (!ptr) {
 #ifdef DARWIN
-      char *ptr = (char *) valloc(rawlen + datalen);
+	ptr = (char *) valloc(alloclen);
 #else
-      char *ptr = 0;
-      int r = ::posix_memalign((void**)(void*)&ptr, align, rawlen + datalen);
-      if (r)
-	throw bad_alloc();
+	int r = ::posix_memalign((void**)(void*)&ptr, align, alloclen);
+	if (r)
+	  throw bad_alloc();
 #endif /* DARWIN */
-      if (!ptr)
-	throw bad_alloc();
+	if (!ptr)
+	  throw bad_alloc();
+      }
 
       // actual data first, since it has presumably larger alignment restriction
       // then put the raw_combined at the end
       return ceph::unique_leakable_ptr<buffer::raw>(
-	new (ptr + datalen) raw_combined(ptr, len, mempool));
+	new (ptr + datalen) raw_combined(ptr, len, mempool, slab_class));
     }
 
     static void operator delete(void *ptr) {
       raw_combined *raw = (raw_combined *)ptr;
-      aligned_free((void *)raw->data);
+      if (raw->slab_class < 0 ||
+	  !buffer_slab.put_block(raw->slab_class, raw->data)) {
+	aligned_free((void *)raw->data);
+      }
     }
   };
 
@@ -736,6 +959,9 @@ static ceph::spinlock debug_lock;
       throw end_of_buffer();
     unsigned howmuch = p->length() - p_off;
     if (howmuch < len) {
+      if (unlikely(buffer_track_rebuild)) {
+	note_rebuild(__builtin_return_address(0), len);
+      }
       dest = create(len);
       copy(len, dest.c_str());
     } else {
@@ -821,6 +1047,21 @@ static ceph::spinlock debug_lock;
     return l;
   }
 
+  template<bool is_const>
+  std::string_view buffer::list::iterator_impl<is_const>::get_contiguous_view(
+    unsigned len, char *scratch)
+  {
+    if (p == ls->end())
+      seek(off);
+    if (p != ls->end() && p->length() - p_off >= len) {
+      std::string_view view(p->c_str() + p_off, len);
+      *this += len;
+      return view;
+    }
+    copy(len, scratch);
+    return std::string_view(scratch, len);
+  }
+
   template<bool is_const>
   uint32_t buffer::list::iterator_impl<is_const>::crc32c(
     size_t length, uint32_t crc)
@@ -1112,6 +1353,14 @@ static ceph::spinlock debug_lock;
     return total - length();
   }
 
+  static void rebuild_contiguous(buffer::list& bl, unsigned len)
+  {
+    if ((len & ~CEPH_PAGE_MASK) == 0)
+      bl.rebuild(buffer::ptr_node::create(buffer::create_page_aligned(len)));
+    else
+      bl.rebuild(buffer::ptr_node::create(buffer::create(len)));
+  }
+
   void buffer::list::rebuild()
   {
     if (_len == 0) {
@@ -1120,10 +1369,10 @@ static ceph::spinlock debug_lock;
       _num = 0;
       return;
     }
-    if ((_len & ~CEPH_PAGE_MASK) == 0)
-      rebuild(ptr_node::create(buffer::create_page_aligned(_len)));
-    else
-      rebuild(ptr_node::create(buffer::create(_len)));
+    if (unlikely(buffer_track_rebuild)) {
+      note_rebuild(__builtin_return_address(0), _len);
+    }
+    rebuild_contiguous(*this, _len);
   }
 
   void buffer::list::rebuild(
@@ -1474,7 +1723,10 @@ static ceph::spinlock debug_lock;
     if (const auto len = length(); len == 0) {
       return nullptr;                         // no non-empty buffers
     } else if (len != _buffers.front().length()) {
-      rebuild();
+      if (unlikely(buffer_track_rebuild)) {
+	note_rebuild(__builtin_return_address(0), len);
+      }
+      rebuild_contiguous(*this, len);
     } else {
       // there are two *main* scenarios that hit this branch:
       //   1. bufferlist with single, non-empty buffer;
@@ -2210,6 +2462,23 @@ buffer::ptr_node::create_hypercombined(ceph::unique_leakable_ptr<buffer::raw> r)
     new ptr_node(std::move(r)));
 }
 
+void* buffer::ptr_node::operator new(const std::size_t size)
+{
+  if (likely(size == sizeof(ptr_node))) {
+    if (void* const p = buffer_slab.get_node(); p) {
+      return p;
+    }
+  }
+  return ::operator new(size);
+}
+
+void buffer::ptr_node::operator delete(void* const p, const std::size_t size)
+{
+  if (size != sizeof(ptr_node) || !buffer_slab.put_node(p)) {
+    ::operator delete(p);
+  }
+}
+
 buffer::ptr_node* buffer::ptr_node::cloner::operator()(
   const buffer::ptr_node& clone_this)
 {
@@ -167,6 +167,8 @@ public:
   const char** get_tracked_conf_keys() const override {
     static const char *KEYS[] = {
       "mempool_debug",
+      "mempool_thread_flush_bytes",
+      "mempool_arena",
       NULL
     };
     return KEYS;
@@ -178,6 +180,14 @@ public:
     if (changed.count("mempool_debug")) {
       mempool::set_debug_mode(cct->_conf->mempool_debug);
     }
+    if (changed.count("mempool_thread_flush_bytes")) {
+      mempool::set_thread_flush_bytes(
+	cct->_conf.get_val<Option::size_t>("mempool_thread_flush_bytes"));
+    }
+    if (changed.count("mempool_arena")) {
+      // too late for the pools that have allocated something already
+      mempool::set_arena_enabled(cct->_conf.get_val<bool>("mempool_arena"));
+    }
   }
 
   // AdminSocketHook
@@ -283,6 +293,7 @@ public:
       "log_file",
       "log_max_new",
       "log_max_recent",
+      "log_max_recent_thread_bytes",
       "log_to_file",
       "log_to_syslog",
       "err_to_syslog",
@@ -342,6 +353,10 @@ public:
       log->set_max_recent(conf->log_max_recent);
     }
 
+    if (changed.count("log_max_recent_thread_bytes")) {
+      log->set_max_recent_thread_bytes(conf->log_max_recent_thread_bytes);
+    }
+
     // graylog
     if (changed.count("log_to_graylog") || changed.count("err_to_graylog")) {
       int l = conf->log_to_graylog ? 99 : (conf->err_to_graylog ? -1 : -2);
@@ -12,6 +12,8 @@
  *
  */
 
+#include <cstdlib>
+
 #include "include/mempool.h"
 #include "include/demangle.h"
 
@@ -22,9 +24,37 @@
 static thread_local size_t thread_shard_index = mempool::num_shards;
 #endif
 
+namespace {
+// what this thread has allocated and freed but not yet added to the pools
+struct thread_pending_t {
+  mempool::stats_t stats[mempool::num_pools];
+  bool armed = false;    // thread_flusher is constructed
+  bool exiting = false;  // thread_flusher is gone, account directly from now on
+  bool counted = false;  // included in mempool::threads_pending
+};
+// trivially destructible, so that it can still be looked at while the
+// thread's other thread_local objects are being destroyed
+thread_local thread_pending_t thread_pending;
+
+struct thread_flusher_t {
+  bool armed = false;
+  ~thread_flusher_t() {
+    mempool::flush_thread_stats();
+    thread_pending.exiting = true;
+  }
+};
+thread_local thread_flusher_t thread_flusher;
+}
+
 // default to debug_mode off
 bool mempool::debug_mode = false;
 
+std::atomic<size_t> mempool::thread_flush_bytes = 0;
+std::atomic<size_t> mempool::threads_pending = 0;
+
+// off unless asked for at startup
+static std::atomic<bool> arena_enabled = false;
+
 // --------------------------------------------------------------
 
 mempool::pool_t& mempool::get_pool(mempool::pool_index_t ix)
@@ -67,9 +97,158 @@ void mempool::set_debug_mode(bool d)
   debug_mode = d;
 }
 
+void mempool::set_thread_flush_bytes(size_t bytes)
+{
+  thread_flush_bytes = bytes;
+}
+
+void mempool::set_arena_enabled(bool enabled)
+{
+  arena_enabled = enabled;
+}
+
+void mempool::flush_thread_stats()
+{
+  for (size_t i = 0; i < num_pools; ++i) {
+    stats_t& s = thread_pending.stats[i];
+    if (s.items || s.bytes) {
+      get_pool((pool_index_t)i).adjust_count(s.items, s.bytes);
+      s = stats_t();
+    }
+  }
+  if (thread_pending.counted) {
+    thread_pending.counted = false;
+    --threads_pending;
+  }
+}
+
+// --------------------------------------------------------------
+// arena_t
+
+struct mempool::arena_t::slab_t {
+  shard_t *shard;
+  slab_t *prev = nullptr, *next = nullptr;  // in shard->partial
+  void *free = nullptr;   // freed slots, linked through their first word
+  char *unused;           // slots from here on were never handed out
+  char *end;
+  size_t used = 0;
+
+  slab_t(shard_t *shard, size_t first_offset, size_t item_size,
+	 size_t capacity)
+    : shard(shard),
+      unused(reinterpret_cast<char*>(this) + first_offset),
+      end(unused + item_size * capacity) {}
+};
+
+mempool::arena_t::arena_t(size_t size, size_t align, pool_t *pool)
+  : pool(pool)
+{
+  ceph_assert(size <= MAX_ITEM_SIZE);
+  align = std::max(align, alignof(void*));
+  item_size = (std::max(size, sizeof(void*)) + align - 1) & ~(align - 1);
+  first_offset = (sizeof(slab_t) + align - 1) & ~(align - 1);
+  capacity = (SLAB_SIZE - first_offset) / item_size;
+  for (auto& shard : shards) {
+    shard.arena = this;
+  }
+}
+
+mempool::arena_t::slab_t *mempool::arena_t::new_slab(shard_t *shard)
+{
+  void *mem = nullptr;
+  if (::posix_memalign(&mem, SLAB_SIZE, SLAB_SIZE)) {
+    throw std::bad_alloc();
+  }
+  ++shard->num_slabs;
+  if (pool) {
+    pool->adjust_slabs(1);
+  }
+  return new (mem) slab_t(shard, first_offset, item_size, capacity);
+}
+
+void *mempool::arena_t::allocate()
+{
+  shard_t& shard = shards[pick_a_shard_int() % num_arena_shards];
+  std::lock_guard l(shard.lock);
+  slab_t *slab = shard.partial;
+  if (!slab) {
+    slab = shard.partial = new_slab(&shard);
+  }
+  void *p;
+  if (slab->free) {
+    p = slab->free;
+    slab->free = *reinterpret_cast<void**>(p);
+  } else {
+    p = slab->unused;
+    slab->unused += item_size;
+  }
+  if (++slab->used == capacity) {
+    // full: off the partial list until something is freed
+    shard.partial = slab->next;
+    if (slab->next) {
+      slab->next->prev = nullptr;
+    }
+    slab->next = nullptr;
+  }
+  return p;
+}
+
+void mempool::arena_t::deallocate(void *p)
+{
+  slab_t *slab = reinterpret_cast<slab_t*>(
+    reinterpret_cast<uintptr_t>(p) & ~(uintptr_t)(SLAB_SIZE - 1));
+  shard_t& shard = *slab->shard;
+  std::lock_guard l(shard.lock);
+  *reinterpret_cast<void**>(p) = slab->free;
+  slab->free = p;
+  if (slab->used-- == shard.arena->capacity) {
+    // it was full; allocate from it again
+    slab->next = shard.partial;
+    if (shard.partial) {
+      shard.partial->prev = slab;
+    }
+    shard.partial = slab;
+  } else if (slab->used == 0 &&
+	     (slab->prev || slab->next)) {
+    // empty, and not the last one we have room in: give it back
+    if (slab->prev) {
+      slab->prev->next = slab->next;
+    } else {
+      shard.partial = slab->next;
+    }
+    if (slab->next) {
+      slab->next->prev = slab->prev;
+    }
+    --shard.num_slabs;
+    if (shard.arena->pool) {
+      shard.arena->pool->adjust_slabs(-1);
+    }
+    slab->~slab_t();
+    ::free(slab);
+  }
+}
+
+size_t mempool::arena_t::get_num_slabs() const
+{
+  size_t n = 0;
+  for (auto& shard : shards) {
+    std::lock_guard l(shard.lock);
+    n += shard.num_slabs;
+  }
+  return n;
+}
+
 // --------------------------------------------------------------
 // pool_t
 
+bool mempool::pool_t::decide_arena()
+{
+  int state = ARENA_UNDECIDED;
+  arena_state.compare_exchange_strong(
+    state, arena_enabled ? ARENA_ON : ARENA_OFF);
+  return arena_state.load() == ARENA_ON;
+}
+
 size_t mempool::pool_t::allocated_bytes() const
 {
   ssize_t result = 0;
@@ -96,6 +275,40 @@ size_t mempool::pool_t::allocated_items() const
   return (size_t) result;
 }
 
+bool mempool::pool_t::account_thread_local(pool_index_t ix,
+					   ssize_t items, ssize_t bytes)
+{
+  auto& pending = thread_pending;
+  if (pending.exiting) {
+    return false;
+  }
+  const size_t flush_bytes = thread_flush_bytes.load(std::memory_order_relaxed);
+  if (flush_bytes == 0) {
+    // turned off since; hand over whatever we kept
+    if (pending.counted) {
+      flush_thread_stats();
+    }
+    return false;
+  }
+  if (!pending.armed) {
+    // construct thread_flusher, so that it flushes when we exit
+    thread_flusher.armed = true;
+    pending.armed = true;
+  }
+  if (!pending.counted) {
+    pending.counted = true;
+    ++threads_pending;
+  }
+  stats_t& s = pending.stats[ix];
+  s.items += items;
+  s.bytes += bytes;
+  if ((size_t)std::abs(s.bytes) >= flush_bytes) {
+    adjust_count(s.items, s.bytes);
+    s = stats_t();
+  }
+  return true;
+}
+
 void mempool::pool_t::adjust_count(ssize_t items, ssize_t bytes)
 {
 #if defined(_GNU_SOURCE) && defined(WITH_SEASTAR) && !defined(WITH_ALIEN)
@@ -152,6 +365,9 @@ void mempool::pool_t::dump(ceph::Formatter *f, stats_t *ptotal) const
     *ptotal += total;
   }
   total.dump(f);
+  if (arena_state.load(std::memory_order_relaxed) == ARENA_ON) {
+    f->dump_unsigned("slab_bytes", allocated_slab_bytes());
+  }
   if (!by_type.empty()) {
     f->open_object_section("by_type");
     for (auto &i : by_type) {
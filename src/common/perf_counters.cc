@@ -18,6 +18,14 @@
 #include "common/dout.h"
 #include "common/valgrind.h"
 #include "include/common_fwd.h"
+#include "include/intarith.h"
+
+#include <algorithm>
+#include <thread>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
 
 using std::ostringstream;
 using std::make_pair;
@@ -175,6 +183,30 @@ void PerfCountersCollectionImpl::with_counters(std::function<void(
 
 // ---------------------------
 
+PerfCounters::shards_d::shards_d(unsigned num_counters)
+  : blocks_per_shard((num_counters + SLOTS_PER_BLOCK - 1) / SLOTS_PER_BLOCK)
+{
+  // one shard per CPU, rounded up to a power of two; beyond 64 the
+  // memory cost outweighs what is left to gain
+  unsigned ncpus = std::clamp(std::thread::hardware_concurrency(), 1u, 64u);
+  num_shards = 1u << cbits(ncpus - 1);
+  blocks.reset(new block_d[num_shards * blocks_per_shard]);
+}
+
+unsigned PerfCounters::shards_d::get_shard() const
+{
+#ifdef __linux__
+  int cpu = sched_getcpu();
+  if (cpu >= 0) {
+    return cpu & (num_shards - 1);
+  }
+#endif
+  // threads of the same CPU are at least spread out
+  static thread_local const unsigned thread_shard =
+    std::hash<std::thread::id>{}(std::this_thread::get_id());
+  return thread_shard & (num_shards - 1);
+}
+
 PerfCounters::~PerfCounters()
 {
 }
@@ -192,11 +224,9 @@ void PerfCounters::inc(int idx, uint64_t amt)
   if (!(data.type & PERFCOUNTER_U64))
     return;
   if (data.type & PERFCOUNTER_LONGRUNAVG) {
-    data.avgcount++;
-    data.u64 += amt;
-    data.avgcount2++;
+    data.add_avg(amt);
   } else {
-    data.u64 += amt;
+    data.add(amt);
   }
 }
 
@@ -213,7 +243,7 @@ void PerfCounters::dec(int idx, uint64_t amt)
   ceph_assert(!(data.type & PERFCOUNTER_LONGRUNAVG));
   if (!(data.type & PERFCOUNTER_U64))
     return;
-  data.u64 -= amt;
+  data.add(-amt);
 }
 
 void PerfCounters::set(int idx, uint64_t amt)
@@ -232,11 +262,18 @@ void PerfCounters::set(int idx, uint64_t amt)
   ANNOTATE_BENIGN_RACE_SIZED(&data.u64, sizeof(data.u64),
                              "perf counter atomic");
   if (data.type & PERFCOUNTER_LONGRUNAVG) {
-    data.avgcount++;
-    data.u64 = amt;
-    data.avgcount2++;
+    if (data.shards) {
+      auto& s = data.shards->slot(0, data.shard_idx);
+      s.avgcount++;
+      data.store(amt);
+      s.avgcount2++;
+    } else {
+      data.avgcount++;
+      data.u64 = amt;
+      data.avgcount2++;
+    }
   } else {
-    data.u64 = amt;
+    data.store(amt);
   }
 }
 
@@ -252,7 +289,7 @@ uint64_t PerfCounters::get(int idx) const
   const perf_counter_data_any_d& data(m_data[idx - m_lower_bound - 1]);
   if (!(data.type & PERFCOUNTER_U64))
     return 0;
-  return data.u64;
+  return data.read_u64();
 }
 
 void PerfCounters::tinc(int idx, utime_t amt)
@@ -268,11 +305,9 @@ void PerfCounters::tinc(int idx, utime_t amt)
   if (!(data.type & PERFCOUNTER_TIME))
     return;
   if (data.type & PERFCOUNTER_LONGRUNAVG) {
-    data.avgcount++;
-    data.u64 += amt.to_nsec();
-    data.avgcount2++;
+    data.add_avg(amt.to_nsec());
   } else {
-    data.u64 += amt.to_nsec();
+    data.add(amt.to_nsec());
   }
 }
 
@@ -289,11 +324,9 @@ void PerfCounters::tinc(int idx, ceph::timespan amt)
   if (!(data.type & PERFCOUNTER_TIME))
     return;
   if (data.type & PERFCOUNTER_LONGRUNAVG) {
-    data.avgcount++;
-    data.u64 += amt.count();
-    data.avgcount2++;
+    data.add_avg(amt.count());
   } else {
-    data.u64 += amt.count();
+    data.add(amt.count());
   }
 }
 
@@ -309,7 +342,7 @@ void PerfCounters::tset(int idx, utime_t amt)
   perf_counter_data_any_d& data(m_data[idx - m_lower_bound - 1]);
   if (!(data.type & PERFCOUNTER_TIME))
     return;
-  data.u64 = amt.to_nsec();
+  data.store(amt.to_nsec());
   if (data.type & PERFCOUNTER_LONGRUNAVG)
     ceph_abort();
 }
@@ -326,7 +359,7 @@ utime_t PerfCounters::tget(int idx) const
   const perf_counter_data_any_d& data(m_data[idx - m_lower_bound - 1]);
   if (!(data.type & PERFCOUNTER_TIME))
     return utime_t();
-  uint64_t v = data.u64;
+  uint64_t v = data.read_u64();
   return utime_t(v / 1000000000ull, v % 1000000000ull);
 }
 
@@ -493,7 +526,7 @@ void PerfCounters::dump_formatted_generic(Formatter *f, bool schema,
         d->histogram->dump_formatted(f);
         f->close_section();
       } else {
-	uint64_t v = d->u64;
+	uint64_t v = d->read_u64();
 	if (d->type & PERFCOUNTER_U64) {
 	  f->dump_unsigned(d->name, v);
 	} else if (d->type & PERFCOUNTER_TIME) {
@@ -627,6 +660,29 @@ PerfCounters *PerfCountersBuilder::create_perf_counters()
     ceph_assert(d->type & (PERFCOUNTER_U64 | PERFCOUNTER_TIME));
   }
 
+#if !defined(WITH_SEASTAR) || defined(WITH_ALIEN)
+  if (m_sharded) {
+    // only counters that are summed; see set_sharded()
+    auto shardable = [](const PerfCounters::perf_counter_data_any_d& data) {
+      return (data.type & (PERFCOUNTER_COUNTER | PERFCOUNTER_LONGRUNAVG)) &&
+	!(data.type & PERFCOUNTER_HISTOGRAM);
+    };
+    auto& data = m_perf_counters->m_data;
+    unsigned num_sharded = std::count_if(data.begin(), data.end(), shardable);
+    if (num_sharded) {
+      m_perf_counters->m_shards =
+	std::make_unique<PerfCounters::shards_d>(num_sharded);
+      unsigned idx = 0;
+      for (auto& d : data) {
+	if (shardable(d)) {
+	  d.shards = m_perf_counters->m_shards.get();
+	  d.shard_idx = idx++;
+	}
+      }
+    }
+  }
+#endif
+
   PerfCounters *ret = m_perf_counters;
   m_perf_counters = NULL;
   return ret;
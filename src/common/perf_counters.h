@@ -113,6 +113,17 @@ public:
     prio_default = prio_;
   }
 
+  /// keep the monotonic counters (u64 counters, averages) in per-CPU
+  /// shards that are summed when read.  this makes inc/tinc on counters
+  /// hit from many threads cheap, at the cost of memory and of slower
+  /// reads; set() on a sharded counter is not atomic with respect to
+  /// concurrent increments.  gauges are never sharded: a sum of shards
+  /// incremented and decremented on different CPUs can be read mid-way
+  /// through as a wrapped value.
+  void set_sharded(bool sharded = true) {
+    m_sharded = sharded;
+  }
+
   PerfCounters* create_perf_counters();
 private:
   PerfCountersBuilder(const PerfCountersBuilder &rhs);
@@ -124,6 +135,7 @@ private:
   PerfCounters *m_perf_counters;
 
   int prio_default = 0;
+  bool m_sharded = false;
 };
 
 /*
@@ -154,6 +166,46 @@ private:
 class PerfCounters
 {
 public:
+  /**
+   * Per-CPU storage for the values of a sharded PerfCounters.  Each
+   * shard is a run of cache line aligned blocks holding the values of
+   * every counter in the set, so a CPU only writes lines of its own.
+   */
+  class shards_d {
+  public:
+    struct slot_d {
+      std::atomic<uint64_t> u64 = { 0 };
+      std::atomic<uint64_t> avgcount = { 0 };
+      std::atomic<uint64_t> avgcount2 = { 0 };
+    };
+
+    explicit shards_d(unsigned num_counters);
+
+    unsigned size() const {
+      return num_shards;
+    }
+    slot_d& slot(unsigned shard, unsigned idx) const {
+      return blocks[shard * blocks_per_shard + idx / SLOTS_PER_BLOCK]
+	.slots[idx % SLOTS_PER_BLOCK];
+    }
+    /// the shard of the CPU we are running on
+    slot_d& local(unsigned idx) const {
+      return slot(get_shard(), idx);
+    }
+
+  private:
+    static constexpr unsigned SLOTS_PER_BLOCK = 8;
+    struct alignas(64) block_d {
+      slot_d slots[SLOTS_PER_BLOCK];
+    };
+
+    unsigned get_shard() const;
+
+    unsigned num_shards;  ///< power of two
+    unsigned blocks_per_shard;
+    std::unique_ptr<block_d[]> blocks;
+  };
+
   /** Represents a PerfCounters data element. */
   struct perf_counter_data_any_d {
     perf_counter_data_any_d()
@@ -169,7 +221,7 @@ public:
         nick(other.nick),
 	 type(other.type),
 	 unit(other.unit),
-	 u64(other.u64.load()) {
+	 u64(other.read_u64()) {
       auto a = other.read_avg();
       u64 = a.first;
       avgcount = a.second;
@@ -189,23 +241,96 @@ public:
     std::atomic<uint64_t> avgcount = { 0 };
     std::atomic<uint64_t> avgcount2 = { 0 };
     std::unique_ptr<PerfHistogram<>> histogram;
+    /// if set, the values live in shards and u64/avgcount are unused
+    const shards_d *shards = nullptr;
+    unsigned shard_idx = 0;
 
     void reset()
     {
       if (type != PERFCOUNTER_U64) {
-	    u64 = 0;
-	    avgcount = 0;
-	    avgcount2 = 0;
+	if (shards) {
+	  for (unsigned i = 0; i < shards->size(); i++) {
+	    auto& s = shards->slot(i, shard_idx);
+	    s.u64 = 0;
+	    s.avgcount = 0;
+	    s.avgcount2 = 0;
+	  }
+	} else {
+	  u64 = 0;
+	  avgcount = 0;
+	  avgcount2 = 0;
+	}
       }
       if (histogram) {
         histogram->reset();
       }
     }
 
+    void add(uint64_t amt) {
+      if (shards) {
+	shards->local(shard_idx).u64.fetch_add(amt, std::memory_order_relaxed);
+      } else {
+	u64 += amt;
+      }
+    }
+    void add_avg(uint64_t amt) {
+      if (shards) {
+	auto& s = shards->local(shard_idx);
+	s.avgcount++;
+	s.u64 += amt;
+	s.avgcount2++;
+      } else {
+	avgcount++;
+	u64 += amt;
+	avgcount2++;
+      }
+    }
+    void store(uint64_t v) {
+      if (shards) {
+	// fold everything into shard 0
+	for (unsigned i = 1; i < shards->size(); i++) {
+	  shards->slot(i, shard_idx).u64 = 0;
+	}
+	shards->slot(0, shard_idx).u64 = v;
+      } else {
+	u64 = v;
+      }
+    }
+
+    uint64_t read_u64() const {
+      if (!shards) {
+	return u64;
+      }
+      uint64_t sum = 0;
+      for (unsigned i = 0; i < shards->size(); i++) {
+	sum += shards->slot(i, shard_idx).u64.load(std::memory_order_relaxed);
+      }
+      return sum;
+    }
+
     // read <sum, count> safely by making sure the post- and pre-count
     // are identical; in other words the whole loop needs to be run
-    // without any intervening calls to inc, set, or tinc.
+    // without any intervening calls to inc, set, or tinc.  Sharded
+    // counters are read shard by shard.
     std::pair<uint64_t,uint64_t> read_avg() const {
+      if (!shards) {
+	return read_avg(u64, avgcount, avgcount2);
+      }
+      std::pair<uint64_t,uint64_t> total = { 0, 0 };
+      for (unsigned i = 0; i < shards->size(); i++) {
+	auto& s = shards->slot(i, shard_idx);
+	auto a = read_avg(s.u64, s.avgcount, s.avgcount2);
+	total.first += a.first;
+	total.second += a.second;
+      }
+      return total;
+    }
+
+  private:
+    static std::pair<uint64_t,uint64_t> read_avg(
+      const std::atomic<uint64_t>& u64,
+      const std::atomic<uint64_t>& avgcount,
+      const std::atomic<uint64_t>& avgcount2) {
       uint64_t sum, count;
       do {
 	count = avgcount2;
@@ -297,6 +422,7 @@ private:
 #endif
 
   perf_counter_data_vec_t m_data;
+  std::unique_ptr<shards_d> m_shards;
 
   friend class PerfCountersBuilder;
   friend class PerfCountersCollectionImpl;
@@ -200,6 +200,79 @@ out:
 #endif
 }
 
+#if defined(__linux__)
+// the cgroup v2 directory this process belongs to, or "" if there is none
+static std::string get_cgroup2_dir(const std::string& root)
+{
+  std::ifstream f{root + "/proc/self/cgroup"};
+  std::string line;
+  while (std::getline(f, line)) {
+    // the unified hierarchy is listed with id 0 and no controllers
+    if (line.compare(0, 3, "0::") == 0) {
+      return root + "/sys/fs/cgroup" + line.substr(3);
+    }
+  }
+  return {};
+}
+#endif
+
+int get_cgroup_memory_usage(uint64_t *current, uint64_t *max,
+			    const std::string& root)
+{
+#if defined(__linux__)
+  std::string dir = get_cgroup2_dir(root);
+  if (dir.empty()) {
+    return -ENOENT;
+  }
+  std::ifstream fc{dir + "/memory.current"};
+  std::ifstream fm{dir + "/memory.max"};
+  if (fc.fail() || fm.fail()) {
+    return -ENOENT;
+  }
+  std::string m;
+  if (!(fc >> *current) || !(fm >> m)) {
+    return -EINVAL;
+  }
+  if (m == "max") {
+    *max = 0;  // no limit
+  } else {
+    char *end;
+    *max = strtoull(m.c_str(), &end, 10);
+    if (*end) {
+      return -EINVAL;
+    }
+  }
+  return 0;
+#else
+  return -EOPNOTSUPP;
+#endif
+}
+
+int get_memory_pressure(double *some_avg10, const std::string& root)
+{
+#if defined(__linux__)
+  // only the cgroup's own stall info: the system wide one mostly tells us
+  // about other tenants of the host
+  std::string dir = get_cgroup2_dir(root);
+  if (dir.empty()) {
+    return -ENOENT;
+  }
+  std::ifstream f{dir + "/memory.pressure"};
+  if (f.fail()) {
+    return -ENOENT;
+  }
+  std::string line;
+  while (std::getline(f, line)) {
+    if (sscanf(line.c_str(), "some avg10=%lf", some_avg10) == 1) {
+      return 0;
+    }
+  }
+  return -EINVAL;
+#else
+  return -EOPNOTSUPP;
+#endif
+}
+
 #ifdef _WIN32
 int get_windows_version(POSVERSIONINFOEXW ver) {
   using  get_version_func_t = DWORD (WINAPI *)(OSVERSIONINFOEXW*);
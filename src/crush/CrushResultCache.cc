@@ -0,0 +1,90 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "CrushResultCache.h"
+
+#include "common/perf_counters.h"
+#include "include/ceph_assert.h"
+
+CrushResultCache::CrushResultCache(unsigned order)
+  : mask((1ull << order) - 1),
+    slots(new Slot[1ull << order])
+{
+  ceph_assert(order < 32);
+}
+
+uint64_t CrushResultCache::hash(const Key& k)
+{
+  // splitmix64-style finalizer over the packed key
+  uint64_t h = ((uint64_t)(uint32_t)k.rule << 32) | (uint32_t)k.x;
+  h ^= k.choose_args_index * 0x9e3779b97f4a7c15ull;
+  h ^= ((uint64_t)(uint32_t)k.result_max << 48) ^ k.weights_gen;
+  h ^= h >> 30;
+  h *= 0xbf58476d1ce4e5b9ull;
+  h ^= h >> 27;
+  h *= 0x94d049bb133111ebull;
+  h ^= h >> 31;
+  return h;
+}
+
+bool CrushResultCache::lookup(const Key& k, std::vector<int>& out) const
+{
+  const Slot& s = slots[hash(k) & mask];
+  uint64_t g = gen.load(std::memory_order_acquire);
+  uint32_t seq = s.seq.load(std::memory_order_acquire);
+  bool match = false;
+  int len = 0;
+  if (!(seq & 1) &&
+      s.gen.load(std::memory_order_relaxed) == g &&
+      s.rule.load(std::memory_order_relaxed) == k.rule &&
+      s.x.load(std::memory_order_relaxed) == k.x &&
+      s.result_max.load(std::memory_order_relaxed) == k.result_max &&
+      s.choose_args_index.load(std::memory_order_relaxed) ==
+        k.choose_args_index &&
+      s.weights_gen.load(std::memory_order_relaxed) == k.weights_gen) {
+    len = s.len.load(std::memory_order_relaxed);
+    out.resize(len);
+    for (int i = 0; i < len; ++i) {
+      out[i] = s.out[i].load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    match = s.seq.load(std::memory_order_relaxed) == seq;
+  }
+  if (match) {
+    hits.fetch_add(1, std::memory_order_relaxed);
+    if (logger)
+      logger->inc(l_hit);
+  } else {
+    misses.fetch_add(1, std::memory_order_relaxed);
+    if (logger)
+      logger->inc(l_miss);
+  }
+  return match;
+}
+
+void CrushResultCache::insert(const Key& k, const int *result, int len)
+{
+  if (len < 0 || len > (int)MAX_RESULT)
+    return;
+  Slot& s = slots[hash(k) & mask];
+  uint32_t seq = s.seq.load(std::memory_order_relaxed);
+  if ((seq & 1) ||
+      !s.seq.compare_exchange_strong(seq, seq + 1,
+				     std::memory_order_acquire,
+				     std::memory_order_relaxed)) {
+    // another thread is filling this slot; don't wait for it
+    return;
+  }
+  std::atomic_thread_fence(std::memory_order_release);
+  s.gen.store(gen.load(std::memory_order_acquire), std::memory_order_relaxed);
+  s.rule.store(k.rule, std::memory_order_relaxed);
+  s.x.store(k.x, std::memory_order_relaxed);
+  s.result_max.store(k.result_max, std::memory_order_relaxed);
+  s.choose_args_index.store(k.choose_args_index, std::memory_order_relaxed);
+  s.weights_gen.store(k.weights_gen, std::memory_order_relaxed);
+  s.len.store(len, std::memory_order_relaxed);
+  for (int i = 0; i < len; ++i) {
+    s.out[i].store(result[i], std::memory_order_relaxed);
+  }
+  s.seq.store(seq + 2, std::memory_order_release);
+}
@@ -0,0 +1,100 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#ifndef CEPH_CRUSH_RESULT_CACHE_H
+#define CEPH_CRUSH_RESULT_CACHE_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "include/common_fwd.h"
+
+/**
+ * CrushResultCache - memoize crush_do_rule() results
+ *
+ * A fixed-size, direct-mapped table of (ruleno, x, result_max,
+ * choose_args index, weights generation) -> result vector.  Lookups and
+ * inserts are lock-free: each slot is guarded by a sequence counter
+ * (odd while a writer owns the slot); a reader that observes a
+ * concurrent update treats it as a miss instead of retrying, and an
+ * insert that collides with an in-progress writer is simply dropped.
+ *
+ * The cache never looks at the crush map or the weight vector itself;
+ * the caller is responsible for providing a weights generation that
+ * changes whenever the weight vector does, and for calling clear() if
+ * the owning crush map is mutated.
+ */
+class CrushResultCache {
+public:
+  /// results wider than this are never cached
+  static constexpr unsigned MAX_RESULT = 16;
+
+  struct Key {
+    int32_t rule;
+    int32_t x;
+    int32_t result_max;
+    uint64_t choose_args_index;
+    uint64_t weights_gen;
+  };
+
+  /// @param order log2 of the number of slots
+  explicit CrushResultCache(unsigned order);
+  CrushResultCache(const CrushResultCache&) = delete;
+  CrushResultCache& operator=(const CrushResultCache&) = delete;
+
+  /// report hits/misses to @p logger (may be nullptr)
+  void set_perf_counters(PerfCounters *logger, int hit_idx, int miss_idx) {
+    this->logger = logger;
+    l_hit = hit_idx;
+    l_miss = miss_idx;
+  }
+
+  /// fill @p out and return true if a result for @p k is cached
+  bool lookup(const Key& k, std::vector<int>& out) const;
+  /// remember @p result (of length @p len) for @p k
+  void insert(const Key& k, const int *result, int len);
+  /// invalidate all existing entries
+  void clear() {
+    gen.fetch_add(1, std::memory_order_release);
+  }
+
+  unsigned get_num_slots() const {
+    return mask + 1;
+  }
+  uint64_t get_hits() const {
+    return hits.load(std::memory_order_relaxed);
+  }
+  uint64_t get_misses() const {
+    return misses.load(std::memory_order_relaxed);
+  }
+
+private:
+  struct alignas(64) Slot {
+    std::atomic<uint32_t> seq{0};
+    std::atomic<int32_t> rule{-1};
+    std::atomic<int32_t> x{0};
+    std::atomic<int32_t> result_max{0};
+    std::atomic<int32_t> len{0};
+    std::atomic<uint64_t> choose_args_index{0};
+    std::atomic<uint64_t> weights_gen{0};
+    std::atomic<uint64_t> gen{0};
+    std::atomic<int32_t> out[MAX_RESULT];
+  };
+
+  static uint64_t hash(const Key& k);
+
+  const uint64_t mask;
+  std::unique_ptr<Slot[]> slots;
+  /// bumped by clear(); entries from older generations never match
+  std::atomic<uint64_t> gen{1};
+
+  mutable std::atomic<uint64_t> hits{0};
+  mutable std::atomic<uint64_t> misses{0};
+  PerfCounters *logger = nullptr;
+  int l_hit = 0;
+  int l_miss = 0;
+};
+
+#endif
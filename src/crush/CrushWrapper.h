@@ -25,6 +25,8 @@ extern "C" {
 #include "include/encoding.h"
 #include "include/mempool.h"
 
+#include "CrushResultCache.h"
+
 namespace ceph {
   class Formatter;
 }
@@ -70,6 +72,9 @@ public:
 private:
   struct crush_map *crush = nullptr;
 
+  /// optional memoization of do_rule() results; see enable_result_cache()
+  std::unique_ptr<CrushResultCache> result_cache;
+
   /* reverse maps */
   mutable bool have_rmaps = false;
   mutable std::map<std::string, int> type_rmap, name_rmap, rule_name_rmap;
@@ -109,6 +114,7 @@ public:
     choose_args_clear();
     ceph_assert(crush);
     have_rmaps = false;
+    invalidate_result_cache();
 
     set_tunables_default();
   }
@@ -1568,6 +1574,7 @@ public:
     for (auto w : choose_args)
       destroy_choose_args(w.second);
     choose_args.clear();
+    invalidate_result_cache();
   }
 
   // remove choose_args for buckets that no longer exist, create them for new buckets
@@ -1628,6 +1635,53 @@ public:
       out[i] = rawout[i];
   }
 
+  /**
+   * memoize do_rule() results in a lock-free table of 2^order slots
+   *
+   * Only enable this on a map that is no longer being modified (e.g.,
+   * one decoded from an OSDMap); mutators other than decode() and
+   * choose_args_clear() do not invalidate the cache.
+   */
+  void enable_result_cache(unsigned order,
+			   PerfCounters *logger = nullptr,
+			   int hit_idx = 0, int miss_idx = 0) {
+    result_cache = std::make_unique<CrushResultCache>(order);
+    result_cache->set_perf_counters(logger, hit_idx, miss_idx);
+  }
+  bool has_result_cache() const {
+    return result_cache != nullptr;
+  }
+  const CrushResultCache *get_result_cache() const {
+    return result_cache.get();
+  }
+  void invalidate_result_cache() {
+    if (result_cache)
+      result_cache->clear();
+  }
+
+  /**
+   * do_rule() through the result cache, if enabled
+   *
+   * @param weights_gen identifies the content of @p weight; callers must
+   *                    pass a different value whenever the weights change
+   */
+  template<typename WeightVector>
+  void do_rule_cached(int rule, int x, std::vector<int>& out, int maxout,
+		      const WeightVector& weight,
+		      uint64_t choose_args_index,
+		      uint64_t weights_gen) const {
+    if (!result_cache || maxout > (int)CrushResultCache::MAX_RESULT) {
+      do_rule(rule, x, out, maxout, weight, choose_args_index);
+      return;
+    }
+    CrushResultCache::Key key{rule, x, maxout, choose_args_index, weights_gen};
+    if (result_cache->lookup(key, out)) {
+      return;
+    }
+    do_rule(rule, x, out, maxout, weight, choose_args_index);
+    result_cache->insert(key, std::data(out), std::size(out));
+  }
+
   int _choose_type_stack(
     CephContext *cct,
     const std::vector<std::pair<int,int>>& stack,
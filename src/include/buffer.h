@@ -119,6 +119,19 @@ struct error_code;
   /// enable/disable tracking of cached crcs
   void track_cached_crc(bool b);
 
+  /// count of ptr_node/small buffer allocations served from the thread cache
+  int get_slab_hits();
+  /// count of ptr_node/small buffer allocations that went to the heap
+  int get_slab_misses();
+  /// enable/disable tracking of slab hits and misses
+  void track_slab(bool b);
+
+  /// enable/disable accounting of bytes copied to make data contiguous
+  void track_rebuild(bool b);
+  /// dump the bytes copied by list::rebuild(), list::c_str() and
+  /// list::iterator::copy_shallow() while tracking, by call site
+  void dump_rebuild_stats(std::ostream& out);
+
   /*
    * an abstract raw buffer.  with a reference count.
    */
@@ -387,6 +400,10 @@ struct error_code;
 
     static ptr_node* copy_hypercombined(const ptr_node& copy_this);
 
+    // ptr_nodes are recycled through a per-thread cache
+    static void* operator new(std::size_t size);
+    static void operator delete(void* p, std::size_t size);
+
   private:
     friend list;
 
@@ -713,6 +730,28 @@ struct error_code;
       // and advance the iterator by that amount.
       size_t get_ptr_and_advance(size_t want, const char **p);
 
+      // get a view of the next len bytes and advance past them.  the
+      // bytes are referenced in place if they sit in the current
+      // segment; only if they straddle segments are they gathered into
+      // scratch (which must hold len bytes and outlive the view).  this
+      // lets decoders walk a fragmented list without flattening it.
+      std::string_view get_contiguous_view(unsigned len, char *scratch);
+
+      // call f(const char *data, size_t len) for each contiguous
+      // fragment of the next len bytes, advancing past them.
+      template<typename F>
+      void for_each_fragment(unsigned len, F&& f) {
+	if (len > get_remaining()) {
+	  *this += len;  // throws end_of_buffer
+	}
+	while (len > 0) {
+	  const char *data = nullptr;
+	  size_t l = get_ptr_and_advance(len, &data);
+	  f(data, l);
+	  len -= l;
+	}
+      }
+
       /// calculate crc from iterator position
       uint32_t crc32c(size_t length, uint32_t crc);
 
@@ -157,7 +157,7 @@ DEFINE_CEPH_FEATURE_RETIRED(49, 1, OSD_MIN_SIZE_RECOVERY, JEWEL, LUMINOUS)
 DEFINE_CEPH_FEATURE_RETIRED(49, 1, OSD_PROXY_FEATURES, JEWEL, LUMINOUS) // overlap
 DEFINE_CEPH_FEATURE(49, 2, SERVER_SQUID);
 DEFINE_CEPH_FEATURE_RETIRED(50, 1, MON_METADATA, MIMIC, OCTOPUS)
-// available
+DEFINE_CEPH_FEATURE(50, 3, OSD_OP_BATCH)       // understands MSG_OSD_OP_BATCH
 DEFINE_CEPH_FEATURE_RETIRED(51, 1, OSD_BITWISE_HOBJ_SORT, MIMIC, OCTOPUS)
 // available
 DEFINE_CEPH_FEATURE_RETIRED(52, 1, OSD_PROXY_WRITE_FEATURES, MIMIC, OCTOPUS)
@@ -253,9 +253,16 @@ DEFINE_CEPH_FEATURE_RETIRED(63, 1, RESERVED_BROKEN, LUMINOUS, QUINCY) // client-
 	 CEPH_FEATURE_RANGE_BLOCKLIST | \
 	 CEPH_FEATUREMASK_SERVER_REEF | \
 	 CEPH_FEATUREMASK_SERVER_SQUID | \
+	 CEPH_FEATURE_OSD_OP_BATCH | \
 	 0ULL)
 
+#ifdef WITH_SEASTAR
+// crimson does not handle MSG_OSD_OP_BATCH
+#define CEPH_FEATURES_SUPPORTED_DEFAULT \
+	(CEPH_FEATURES_ALL & ~CEPH_FEATURE_OSD_OP_BATCH)
+#else
 #define CEPH_FEATURES_SUPPORTED_DEFAULT  CEPH_FEATURES_ALL
+#endif
 
 /*
  * crush related features
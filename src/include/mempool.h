@@ -143,6 +143,43 @@ Note that you cannot easily query per-type, primarily because debug
 mode is optional and you should not rely on that information being
 available.
 
+Thread-local accounting
+-----------------------
+
+By default every allocation and deallocation updates one of the pool's
+shards.  Threads that happen to hash to the same shard still bounce its
+cacheline around.  With
+
+  mempool::set_thread_flush_bytes(64 << 10);
+
+each thread instead accumulates its changes to each pool locally, and
+adds them to the pool's shards only once they amount to that many bytes
+(in either direction), when mempool::flush_thread_stats() is called, or
+when the thread exits.  The totals reported for a pool may then be off
+by up to that much per thread.  Once it is set back to 0, each thread
+hands over what it kept on its next allocation or deallocation.
+
+Arenas
+------
+
+With
+
+  mempool::set_arena_enabled(true);
+
+single-object allocations of the pools listed in
+DEFINE_ARENA_POOLS_HELPER are not malloc'ed one by one: each type gets
+an arena of 64 KB slabs, which are carved into slots of the type's size
+and handed back to malloc once they are empty again.  This packs the
+many small, equally sized objects of these pools (onodes, extents, pg
+log entries) densely instead of scattering them over the heap, where
+they would pin partially used pages long after most of their neighbours
+are gone.  A single live object keeps its whole slab allocated, though.
+
+Whether a pool uses arenas is decided once, on its first single-object
+allocation, so set_arena_enabled() has to be called at startup.  The
+items and bytes of a pool are accounted as for malloc'ed objects; the
+slabs its arenas hold are reported separately, as slab_bytes.
+
 */
 
 namespace mempool {
@@ -182,6 +219,14 @@ namespace mempool {
   f(unittest_2)
 
 
+// pools whose single-object allocations come from per-type arenas
+#define DEFINE_ARENA_POOLS_HELPER(f) \
+  f(bluestore_cache_onode)	      \
+  f(bluestore_extent)		      \
+  f(osd_pglog)			      \
+  f(unittest_2)
+
+
 // give them integer ids
 #define P(x) mempool_##x,
 enum pool_index_t {
@@ -190,9 +235,30 @@ enum pool_index_t {
 };
 #undef P
 
+constexpr bool pool_uses_arena(pool_index_t ix) {
+#define P(x) case mempool_##x: return true;
+  switch (ix) {
+    DEFINE_ARENA_POOLS_HELPER(P)
+  default:
+    return false;
+  }
+#undef P
+}
+
 extern bool debug_mode;
 extern void set_debug_mode(bool d);
 
+// 0 unless thread-local accounting is enabled
+extern std::atomic<size_t> thread_flush_bytes;
+// threads holding stats not yet added to the pools
+extern std::atomic<size_t> threads_pending;
+extern void set_thread_flush_bytes(size_t bytes);
+// add what the calling thread has accumulated to the pools
+extern void flush_thread_stats();
+
+// only affects pools that have not allocated anything yet
+extern void set_arena_enabled(bool enabled);
+
 // --------------------------------------------------------------
 class pool_t;
 
@@ -259,6 +325,48 @@ struct stats_t {
 pool_t& get_pool(pool_index_t ix);
 const char *get_pool_name(pool_index_t ix);
 
+// Fixed-size slots carved out of SLAB_SIZE aligned slabs.  Each slab
+// records the shard it belongs to, so that a slot can be freed without
+// knowing which arena it came from.
+class arena_t {
+public:
+  static constexpr size_t SLAB_SIZE = 64 << 10;
+  // bigger items would waste too much of a slab
+  static constexpr size_t MAX_ITEM_SIZE = SLAB_SIZE / 16;
+
+  // @p pool, if any, is told about the slabs allocated and freed
+  arena_t(size_t item_size, size_t item_align, pool_t *pool = nullptr);
+  arena_t(const arena_t&) = delete;
+  arena_t& operator=(const arena_t&) = delete;
+
+  void *allocate();
+  static void deallocate(void *p);
+
+  // number of slabs currently allocated
+  size_t get_num_slabs() const;
+
+private:
+  struct slab_t;
+  enum {
+    num_arena_shards = 8
+  };
+  struct shard_t {
+    arena_t *arena = nullptr;
+    mutable std::mutex lock;
+    // slabs with free slots; the first one is allocated from
+    slab_t *partial = nullptr;
+    size_t num_slabs = 0;
+  } __attribute__ ((aligned (128)));
+
+  slab_t *new_slab(shard_t *shard);
+
+  pool_t *pool;
+  size_t item_size;
+  size_t first_offset;  // of the first slot within a slab
+  size_t capacity;      // slots per slab
+  shard_t shards[num_arena_shards];
+};
+
 struct type_t {
   const char *type_name;
   size_t item_size;
@@ -285,6 +393,17 @@ struct type_info_hash {
 class pool_t {
   shard_t shard[num_shards];
 
+  enum : int {
+    ARENA_UNDECIDED,
+    ARENA_OFF,
+    ARENA_ON,
+  };
+  // decided on the first single-object allocation, and never changed, so
+  // that every object is freed the way it was allocated
+  std::atomic<int> arena_state = {ARENA_UNDECIDED};
+  ceph::atomic<size_t> num_slabs = {0};
+  bool decide_arena();
+
   mutable std::mutex lock;  // only used for types list
   std::unordered_map<const char *, type_t> type_map;
 
@@ -296,9 +415,39 @@ public:
   //
   size_t allocated_bytes() const;
   size_t allocated_items() const;
+  // held by the pool's arenas, whatever is allocated from them
+  size_t allocated_slab_bytes() const {
+    return num_slabs * arena_t::SLAB_SIZE;
+  }
+
+  bool uses_arena() {
+    auto state = arena_state.load(std::memory_order_relaxed);
+    if (state != ARENA_UNDECIDED) {
+      return state == ARENA_ON;
+    }
+    return decide_arena();
+  }
+  void adjust_slabs(ssize_t n) {
+    num_slabs += n;
+  }
 
   void adjust_count(ssize_t items, ssize_t bytes);
 
+  // account for @p items / @p bytes allocated (or freed, if negative) by
+  // the calling thread, which hashes to @p shid
+  void account(pool_index_t ix, size_t shid, ssize_t items, ssize_t bytes) {
+    if ((thread_flush_bytes.load(std::memory_order_relaxed) ||
+	 threads_pending.load(std::memory_order_relaxed)) &&
+	account_thread_local(ix, items, bytes)) {
+      return;
+    }
+    shard[shid].bytes += bytes;
+    shard[shid].items += items;
+  }
+  // false if the calling thread is past flushing its stats for good, or
+  // thread-local accounting is off
+  bool account_thread_local(pool_index_t ix, ssize_t items, ssize_t bytes);
+
   type_t *get_type(const std::type_info& ti, size_t size) {
     std::lock_guard<std::mutex> l(lock);
     auto p = type_map.find(ti.name());
@@ -359,12 +508,24 @@ public:
     init(false);
   }
 
+  static constexpr bool arena_eligible(size_t n) {
+    return (pool_uses_arena(pool_ix) && n == 1 &&
+	    sizeof(T) <= arena_t::MAX_ITEM_SIZE);
+  }
+  bool use_arena(size_t n) const {
+    return arena_eligible(n) && pool->uses_arena();
+  }
+  static arena_t& get_arena() {
+    // never freed: objects may well outlive static destructors
+    static arena_t *arena = new arena_t(sizeof(T), alignof(T),
+					&get_pool(pool_ix));
+    return *arena;
+  }
+
   T* allocate(size_t n, void *p = nullptr) {
     size_t total = sizeof(T) * n;
     const auto shid = pick_a_shard_int();
-    auto& shard = pool->shard[shid];
-    shard.bytes += total;
-    shard.items += n;
+    pool->account(pool_ix, shid, n, total);
     if (type) {
 #if defined(WITH_SEASTAR) && !defined(WITH_ALIEN)
       type->shards[shid].items += n;
@@ -372,6 +533,9 @@ public:
       type->items += n;
 #endif
     }
+    if (use_arena(n)) {
+      return reinterpret_cast<T*>(get_arena().allocate());
+    }
     T* r = reinterpret_cast<T*>(new char[total]);
     return r;
   }
@@ -379,9 +543,7 @@ public:
   void deallocate(T* p, size_t n) {
     size_t total = sizeof(T) * n;
     const auto shid = pick_a_shard_int();
-    auto& shard = pool->shard[shid];
-    shard.bytes -= total;
-    shard.items -= n;
+    pool->account(pool_ix, shid, -(ssize_t)n, -(ssize_t)total);
     if (type) {
 #if defined(WITH_SEASTAR) && !defined(WITH_ALIEN)
       type->shards[shid].items -= n;
@@ -389,15 +551,17 @@ public:
       type->items -= n;
 #endif
     }
+    if (use_arena(n)) {
+      arena_t::deallocate(p);
+      return;
+    }
     delete[] reinterpret_cast<char*>(p);
   }
 
   T* allocate_aligned(size_t n, size_t align, void *p = nullptr) {
     size_t total = sizeof(T) * n;
     const auto shid = pick_a_shard_int();
-    auto& shard = pool->shard[shid];
-    shard.bytes += total;
-    shard.items += n;
+    pool->account(pool_ix, shid, n, total);
     if (type) {
 #if defined(WITH_SEASTAR) && !defined(WITH_ALIEN)
       type->shards[shid].items += n;
@@ -416,9 +580,7 @@ public:
   void deallocate_aligned(T* p, size_t n) {
     size_t total = sizeof(T) * n;
     const auto shid = pick_a_shard_int();
-    auto& shard = pool->shard[shid];
-    shard.bytes -= total;
-    shard.items -= n;
+    pool->account(pool_ix, shid, -(ssize_t)n, -(ssize_t)total);
     if (type) {
 #if defined(WITH_SEASTAR) && !defined(WITH_ALIEN)
       type->shards[shid].items -= n;
@@ -510,6 +672,9 @@ public:
     inline size_t allocated_items() {					\
       return mempool::get_pool(id).allocated_items();			\
     }									\
+    inline size_t allocated_slab_bytes() {				\
+      return mempool::get_pool(id).allocated_slab_bytes();		\
+    }									\
   };
 
 DEFINE_MEMORY_POOLS_HELPER(P)
@@ -1214,6 +1214,28 @@ inline namespace v14_2_0 {
     int aio_operate(const std::string& oid, AioCompletion *c,
         ObjectReadOperation *op, int flags,
         bufferlist *pbl, const blkin_trace_info *trace_info);
+    /**
+     * Schedule operations on several objects with a single completion
+     *
+     * The operations are submitted together, ordered by placement
+     * group, and @p c completes once all of them have.  Its return
+     * value is 0 if every operation succeeded and otherwise the first
+     * error seen.  Read results go wherever the operations themselves
+     * direct them; there is no bufferlist for the batch as a whole, and
+     * aio_cancel() is not supported on @p c.
+     *
+     * @param c what to do when all operations are complete (and safe)
+     * @param ops (object name, operation) pairs
+     * @param prvals where to store the result of each operation, or NULL
+     * @param flags flags applied to every operation
+     * @returns 0 on success, negative error code on failure
+     */
+    int aio_operate_batch(AioCompletion *c,
+        const std::vector<std::pair<std::string, ObjectWriteOperation*>>& ops,
+        std::vector<int> *prvals, int flags);
+    int aio_operate_batch(AioCompletion *c,
+        const std::vector<std::pair<std::string, ObjectReadOperation*>>& ops,
+        std::vector<int> *prvals, int flags);
 
     // watch/notify
     int watch2(const std::string& o, uint64_t *handle,
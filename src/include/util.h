@@ -76,6 +76,15 @@ int get_fs_stats(ceph_data_stats_t &stats, const char *path);
 /// get memory limit for the current cgroup
 int get_cgroup_memory_limit(uint64_t *limit);
 
+/// get memory.current and memory.max (0 if unlimited) of our cgroup v2;
+/// @p root is where /proc and /sys are found
+int get_cgroup_memory_usage(uint64_t *current, uint64_t *max,
+			    const std::string& root = "");
+
+/// get the share of time (in percent, over the last 10 seconds) some task
+/// of our cgroup v2 was stalled on memory
+int get_memory_pressure(double *some_avg10, const std::string& root = "");
+
 /// collect info from @p uname(2), @p /proc/meminfo and @p /proc/cpuinfo
 void collect_sys_info(std::map<std::string, std::string> *m, CephContext *cct);
 
@@ -229,6 +229,22 @@ struct C_aio_selfmanaged_snap_create_Complete : public C_aio_selfmanaged_snap_op
   }
 };
 
+// one op of an aio_operate_batch(): record its result, then report to
+// the gather that completes the batch
+struct C_aio_batch_op : public Context {
+  int *prval;
+  Context *sub;
+
+  C_aio_batch_op(int *prval, Context *sub) : prval(prval), sub(sub) {}
+
+  void finish(int r) override {
+    if (prval) {
+      *prval = r;
+    }
+    sub->complete(r);
+  }
+};
+
 } // anonymous namespace
 } // namespace librados
 
@@ -786,6 +802,70 @@ int librados::IoCtxImpl::aio_operate(const object_t& oid,
   return 0;
 }
 
+int librados::IoCtxImpl::aio_operate_batch(
+  const std::vector<std::pair<object_t, batch_op_t>>& ops,
+  AioCompletionImpl *c, const SnapContext& snap_context, int flags,
+  std::vector<int> *prvals)
+{
+  FUNCTRACE(client->cct);
+  if (ops.empty())
+    return -EINVAL;
+  /* can't write to a snapshot */
+  if (snap_seq != CEPH_NOSNAP)
+    return -EROFS;
+  if (prvals)
+    prvals->assign(ops.size(), 0);
+
+  c->io = this;
+  queue_aio_write(c);
+
+  // the first error of any op is the result of the batch
+  C_GatherBuilder gather(client->cct, new C_aio_Complete(c));
+  const ceph::real_time now = ceph::real_clock::now();
+  std::vector<Objecter::Op*> objecter_ops;
+  objecter_ops.reserve(ops.size());
+  for (size_t i = 0; i < ops.size(); ++i) {
+    auto& [oid, bop] = ops[i];
+    Context *oncomplete = new C_aio_batch_op(prvals ? &(*prvals)[i] : nullptr,
+					     gather.new_sub());
+    objecter_ops.push_back(objecter->prepare_mutate_op(
+      oid, oloc, *bop.o, snap_context, bop.pmtime ? *bop.pmtime : now,
+      flags | extra_op_flags, oncomplete, nullptr));
+  }
+  objecter->op_submit_batch(objecter_ops);
+  gather.activate();
+  return 0;
+}
+
+int librados::IoCtxImpl::aio_operate_read_batch(
+  const std::vector<std::pair<object_t, batch_op_t>>& ops,
+  AioCompletionImpl *c, int flags, std::vector<int> *prvals)
+{
+  FUNCTRACE(client->cct);
+  if (ops.empty())
+    return -EINVAL;
+  if (prvals)
+    prvals->assign(ops.size(), 0);
+
+  c->is_read = true;
+  c->io = this;
+
+  C_GatherBuilder gather(client->cct, new C_aio_Complete(c));
+  std::vector<Objecter::Op*> objecter_ops;
+  objecter_ops.reserve(ops.size());
+  for (size_t i = 0; i < ops.size(); ++i) {
+    auto& [oid, bop] = ops[i];
+    Context *oncomplete = new C_aio_batch_op(prvals ? &(*prvals)[i] : nullptr,
+					     gather.new_sub());
+    objecter_ops.push_back(objecter->prepare_read_op(
+      oid, oloc, *bop.o, snap_seq, nullptr, flags | extra_op_flags,
+      oncomplete, nullptr));
+  }
+  objecter->op_submit_batch(objecter_ops);
+  gather.activate();
+  return 0;
+}
+
 int librados::IoCtxImpl::aio_read(const object_t oid, AioCompletionImpl *c,
 				  bufferlist *pbl, size_t len, uint64_t off,
 				  uint64_t snapid, const blkin_trace_info *info)
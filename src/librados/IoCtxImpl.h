@@ -163,6 +163,18 @@ struct librados::IoCtxImpl {
   int aio_operate_read(const object_t& oid, ::ObjectOperation *o,
 		       AioCompletionImpl *c, int flags, bufferlist *pbl, const blkin_trace_info *trace_info = nullptr);
 
+  struct batch_op_t {
+    ::ObjectOperation *o;
+    const ceph::real_time *pmtime;  ///< writes only, may be NULL
+  };
+  /// submit ops on several objects, completing @p c once all are done
+  int aio_operate_batch(const std::vector<std::pair<object_t, batch_op_t>>& ops,
+			AioCompletionImpl *c, const SnapContext& snap_context,
+			int flags, std::vector<int> *prvals);
+  int aio_operate_read_batch(
+    const std::vector<std::pair<object_t, batch_op_t>>& ops,
+    AioCompletionImpl *c, int flags, std::vector<int> *prvals);
+
   struct C_aio_stat_Ack : public Context {
     librados::AioCompletionImpl *c;
     time_t *pmtime;
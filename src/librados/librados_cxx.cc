@@ -1684,6 +1684,38 @@ int librados::IoCtx::aio_operate(const std::string& oid, AioCompletion *c,
                translate_flags(flags), pbl, trace_info);
 }
 
+int librados::IoCtx::aio_operate_batch(AioCompletion *c,
+  const std::vector<std::pair<std::string, ObjectWriteOperation*>>& ops,
+  std::vector<int> *prvals, int flags)
+{
+  std::vector<std::pair<object_t, IoCtxImpl::batch_op_t>> bops;
+  bops.reserve(ops.size());
+  for (auto& [oid, o] : ops) {
+    if (unlikely(!o || !o->impl))
+      return -EINVAL;
+    bops.emplace_back(object_t(oid),
+		      IoCtxImpl::batch_op_t{&o->impl->o, o->impl->prt});
+  }
+  return io_ctx_impl->aio_operate_batch(bops, c->pc, io_ctx_impl->snapc,
+					translate_flags(flags), prvals);
+}
+
+int librados::IoCtx::aio_operate_batch(AioCompletion *c,
+  const std::vector<std::pair<std::string, ObjectReadOperation*>>& ops,
+  std::vector<int> *prvals, int flags)
+{
+  std::vector<std::pair<object_t, IoCtxImpl::batch_op_t>> bops;
+  bops.reserve(ops.size());
+  for (auto& [oid, o] : ops) {
+    if (unlikely(!o || !o->impl))
+      return -EINVAL;
+    bops.emplace_back(object_t(oid),
+		      IoCtxImpl::batch_op_t{&o->impl->o, nullptr});
+  }
+  return io_ctx_impl->aio_operate_read_batch(bops, c->pc,
+					     translate_flags(flags), prvals);
+}
+
 void librados::IoCtx::snap_set_read(snap_t seq)
 {
   io_ctx_impl->set_snap_read(seq);
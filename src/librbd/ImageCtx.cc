@@ -289,6 +289,8 @@ librados::IoCtx duplicate_io_ctx(librados::IoCtx& io_ctx) {
     plb.add_u64_counter(l_librbd_resize, "resize", "Resizes");
     plb.add_u64_counter(l_librbd_readahead, "readahead", "Read ahead");
     plb.add_u64_counter(l_librbd_readahead_bytes, "readahead_bytes", "Data size in read ahead", NULL, 0, unit_t(UNIT_BYTES));
+    plb.add_u64_counter(l_librbd_readahead_hit_bytes, "readahead_hit_bytes", "Data read that had been read ahead", NULL, 0, unit_t(UNIT_BYTES));
+    plb.add_u64_counter(l_librbd_readahead_wasted_bytes, "readahead_wasted_bytes", "Data read ahead but never read", NULL, 0, unit_t(UNIT_BYTES));
     plb.add_u64_counter(l_librbd_invalidate_cache, "invalidate_cache", "Cache invalidates");
 
     plb.add_time(l_librbd_opened_time, "opened_time", "Opened time",
@@ -298,12 +300,15 @@ librados::IoCtx duplicate_io_ctx(librados::IoCtx& io_ctx) {
 
     perfcounter = plb.create_perf_counters();
     cct->get_perfcounters_collection()->add(perfcounter);
+    readahead.set_perf_counters(perfcounter, l_librbd_readahead_hit_bytes,
+                                l_librbd_readahead_wasted_bytes);
 
     perfcounter->tset(l_librbd_opened_time, ceph_clock_now());
   }
 
   void ImageCtx::perf_stop() {
     ceph_assert(perfcounter);
+    readahead.set_perf_counters(nullptr, 0, 0);
     cct->get_perfcounters_collection()->remove(perfcounter);
     delete perfcounter;
   }
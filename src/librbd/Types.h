@@ -49,6 +49,8 @@ enum {
 
   l_librbd_readahead,
   l_librbd_readahead_bytes,
+  l_librbd_readahead_hit_bytes,
+  l_librbd_readahead_wasted_bytes,
 
   l_librbd_invalidate_cache,
 
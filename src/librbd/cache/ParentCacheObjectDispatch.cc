@@ -2,7 +2,11 @@
 // vim: ts=8 sw=2 smarttab
 
 #include "common/errno.h"
+#include "include/buffer_raw.h"
+#include "include/compat.h"
+#include "include/intarith.h"
 #include "include/neorados/RADOS.hpp"
+#include "include/page.h"
 #include "librbd/ImageCtx.h"
 #include "librbd/Utils.h"
 #include "librbd/asio/ContextWQ.h"
@@ -13,6 +17,9 @@
 #include "osd/osd_types.h"
 #include "osdc/WritebackHandler.h"
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <vector>
 
 #define dout_subsys ceph_subsys_rbd
@@ -27,12 +34,49 @@ using librbd::util::data_object_name;
 namespace librbd {
 namespace cache {
 
+struct MappedCacheFile {
+  int fd;
+  uint64_t size;
+
+  MappedCacheFile(int fd, uint64_t size) : fd(fd), size(size) {
+  }
+  ~MappedCacheFile() {
+    VOID_TEMP_FAILURE_RETRY(::close(fd));
+  }
+};
+
+namespace {
+
+// read data handed out straight from a private mapping of a cache file.
+// the mapping is copy-on-write, so callers may modify the buffer (e.g.
+// to decrypt it in place) without touching the file or other reads of it
+class raw_mapped_file : public ceph::buffer::raw {
+public:
+  raw_mapped_file(char* map_addr, size_t map_len, unsigned offset,
+                  unsigned len)
+    : raw(map_addr + offset, len), m_map_addr(map_addr), m_map_len(map_len) {
+  }
+  ~raw_mapped_file() override {
+    ::munmap(m_map_addr, m_map_len);
+  }
+
+private:
+  char* m_map_addr;
+  size_t m_map_len;
+};
+
+} // anonymous namespace
+
 template <typename I>
 ParentCacheObjectDispatch<I>::ParentCacheObjectDispatch(
     I* image_ctx, plugin::Api<I>& plugin_api)
   : m_image_ctx(image_ctx), m_plugin_api(plugin_api),
     m_lock(ceph::make_mutex(
-      "librbd::cache::ParentCacheObjectDispatch::lock", true, false)) {
+      "librbd::cache::ParentCacheObjectDispatch::lock", true, false)),
+    m_mapped_files_lock(ceph::make_mutex(
+      "librbd::cache::ParentCacheObjectDispatch::mapped_files_lock")),
+    m_max_mapped_files(image_ctx->cct->_conf.template get_val<uint64_t>(
+      "rbd_parent_cache_mapped_objects")) {
   ceph_assert(m_image_ctx->data_ctx.is_valid());
   auto controller_path = image_ctx->cct->_conf.template get_val<std::string>(
     "immutable_object_cache_sock");
@@ -244,6 +288,26 @@ int ParentCacheObjectDispatch<I>::read_object(
   auto *cct = m_image_ctx->cct;
   ldout(cct, 20) << "file path: " << file_path << dendl;
 
+  auto file = get_mapped_file(file_path);
+  if (file) {
+    if (offset >= file->size) {
+      return read_data->length();
+    }
+    length = std::min(length, file->size - offset);
+    uint64_t map_offset = p2align<uint64_t>(offset, CEPH_PAGE_SIZE);
+    size_t map_len = offset - map_offset + length;
+    void* addr = ::mmap(nullptr, map_len, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                        file->fd, map_offset);
+    if (addr != MAP_FAILED) {
+      read_data->push_back(ceph::buffer::ptr(
+        ceph::unique_leakable_ptr<ceph::buffer::raw>(
+          new raw_mapped_file(reinterpret_cast<char*>(addr), map_len,
+                              offset - map_offset, length))));
+      return read_data->length();
+    }
+    ldout(cct, 20) << "failed to map file path: " << file_path << dendl;
+  }
+
   std::string error;
   int ret = read_data->pread_file(file_path.c_str(), offset, length, &error);
   if (ret < 0) {
@@ -255,6 +319,55 @@ int ParentCacheObjectDispatch<I>::read_object(
   return read_data->length();
 }
 
+template <typename I>
+std::shared_ptr<MappedCacheFile> ParentCacheObjectDispatch<I>::get_mapped_file(
+    const std::string& file_path) {
+  if (m_max_mapped_files == 0) {
+    return nullptr;
+  }
+
+  {
+    std::lock_guard locker{m_mapped_files_lock};
+    auto it = m_mapped_files.find(file_path);
+    if (it != m_mapped_files.end()) {
+      m_mapped_files_lru.splice(m_mapped_files_lru.begin(),
+                                m_mapped_files_lru, it->second);
+      return it->second->second;
+    }
+  }
+
+  auto *cct = m_image_ctx->cct;
+  int fd = TEMP_FAILURE_RETRY(::open(file_path.c_str(), O_RDONLY | O_CLOEXEC));
+  if (fd < 0) {
+    // let the regular read path report it
+    return nullptr;
+  }
+
+  struct stat st;
+  if (::fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+    VOID_TEMP_FAILURE_RETRY(::close(fd));
+    ldout(cct, 20) << "not mapping file path: " << file_path << dendl;
+    return nullptr;
+  }
+  auto file = std::make_shared<MappedCacheFile>(fd, st.st_size);
+
+  std::lock_guard locker{m_mapped_files_lock};
+  auto [it, inserted] = m_mapped_files.try_emplace(file_path);
+  if (!inserted) {
+    // mapped concurrently by another read
+    m_mapped_files_lru.splice(m_mapped_files_lru.begin(),
+                              m_mapped_files_lru, it->second);
+    return it->second->second;
+  }
+  m_mapped_files_lru.emplace_front(file_path, file);
+  it->second = m_mapped_files_lru.begin();
+  while (m_mapped_files_lru.size() > m_max_mapped_files) {
+    m_mapped_files.erase(m_mapped_files_lru.back().first);
+    m_mapped_files_lru.pop_back();
+  }
+  return file;
+}
+
 } // namespace cache
 } // namespace librbd
 
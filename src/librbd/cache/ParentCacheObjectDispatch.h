@@ -10,6 +10,10 @@
 #include "tools/immutable_object_cache/CacheClient.h"
 #include "tools/immutable_object_cache/Types.h"
 
+#include <list>
+#include <memory>
+#include <unordered_map>
+
 namespace librbd {
 
 class ImageCtx;
@@ -18,6 +22,8 @@ namespace plugin { template <typename> struct Api; }
 
 namespace cache {
 
+struct MappedCacheFile;
+
 template <typename ImageCtxT = ImageCtx>
 class ParentCacheObjectDispatch : public io::ObjectDispatchInterface {
   // mock unit testing support
@@ -142,6 +148,8 @@ private:
                          const ZTracer::Trace &parent_trace,
                          io::DispatchResult* dispatch_result,
                          Context* on_dispatched);
+  std::shared_ptr<MappedCacheFile> get_mapped_file(
+      const std::string& file_path);
   int handle_register_client(bool reg);
   void create_cache_session(Context* on_finish, bool is_reconnect);
 
@@ -151,6 +159,16 @@ private:
   ceph::mutex m_lock;
   CacheClient *m_cache_client = nullptr;
   bool m_connecting = false;
+
+  // cache files are immutable once the daemon hands them out, so they
+  // can stay open for all reads to map until recycled
+  typedef std::list<std::pair<std::string,
+                              std::shared_ptr<MappedCacheFile>>> MappedFiles;
+  ceph::mutex m_mapped_files_lock;
+  uint64_t m_max_mapped_files;
+  MappedFiles m_mapped_files_lru;
+  std::unordered_map<std::string, typename MappedFiles::iterator>
+    m_mapped_files;
 };
 
 } // namespace cache
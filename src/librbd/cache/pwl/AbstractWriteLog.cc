@@ -75,6 +75,10 @@ AbstractWriteLog<I>::AbstractWriteLog(
 {
   CephContext *cct = m_image_ctx.cct;
   m_plugin_api.get_image_timer_instance(cct, &m_timer, &m_timer_lock);
+  m_max_flush_ops_in_flight = image_ctx.config.template get_val<uint64_t>(
+    "rbd_persistent_cache_flush_ops_in_flight");
+  m_max_flush_bytes_in_flight = image_ctx.config.template get_val<uint64_t>(
+    "rbd_persistent_cache_flush_bytes_in_flight");
 }
 
 template <typename I>
@@ -264,6 +268,9 @@ void AbstractWriteLog<I>::perf_start(std::string name) {
 
   plb.add_u64_counter(l_librbd_pwl_internal_flush, "internal_flush", "Flush RWL (write back to OSD)");
   plb.add_time_avg(l_librbd_pwl_writeback_latency, "writeback_lat", "write back to OSD latency");
+  plb.add_u64_counter(l_librbd_pwl_writeback_bytes, "writeback_bytes", "Bytes written back to OSD");
+  plb.add_u64_counter(l_librbd_pwl_writeback_coalesced, "writeback_coalesced",
+                      "Log entries written back as part of a larger write");
   plb.add_u64_counter(l_librbd_pwl_invalidate_cache, "invalidate", "Invalidate RWL");
   plb.add_u64_counter(l_librbd_pwl_invalidate_discard_cache, "discard", "Discard and invalidate RWL");
 
@@ -1643,8 +1650,8 @@ bool AbstractWriteLog<I>::can_flush_entry(std::shared_ptr<GenericLogEntry> log_e
   }
 
   return (log_entry->can_writeback() &&
-         (m_flush_ops_in_flight <= IN_FLIGHT_FLUSH_WRITE_LIMIT) &&
-         (m_flush_bytes_in_flight <= IN_FLIGHT_FLUSH_BYTES_LIMIT));
+         (m_flush_ops_in_flight <= m_max_flush_ops_in_flight) &&
+         (m_flush_bytes_in_flight <= m_max_flush_bytes_in_flight));
 }
 
 template <typename I>
@@ -1694,6 +1701,8 @@ Context* AbstractWriteLog<I>::construct_flush_entry(std::shared_ptr<GenericLogEn
           ceph_assert(m_bytes_dirty >= log_entry->bytes_dirty());
           log_entry->set_flushed(true);
           m_bytes_dirty -= log_entry->bytes_dirty();
+          m_perfcounter->inc(l_librbd_pwl_writeback_bytes,
+                             log_entry->ram_entry.write_bytes);
           sync_point_writer_flushed(log_entry->get_sync_point_entry());
           ldout(m_image_ctx.cct, 20) << "flushed: " << log_entry
                                      << " invalidating=" << invalidating
@@ -1739,7 +1748,7 @@ template <typename I>
 void AbstractWriteLog<I>::process_writeback_dirty_entries() {
   CephContext *cct = m_image_ctx.cct;
   bool all_clean = false;
-  int flushed = 0;
+  uint64_t flushed = 0;
   bool has_write_entry = false;
   bool need_update_state = false;
 
@@ -1750,7 +1759,7 @@ void AbstractWriteLog<I>::process_writeback_dirty_entries() {
 
     std::shared_lock entry_reader_locker(m_entry_reader_lock);
     std::lock_guard locker(m_lock);
-    while (flushed < IN_FLIGHT_FLUSH_WRITE_LIMIT) {
+    while (flushed < m_max_flush_ops_in_flight) {
       if (m_shutting_down) {
         ldout(cct, 5) << "Flush during shutdown suppressed" << dendl;
         /* Do flush complete only when all flush ops are finished */
@@ -139,6 +139,8 @@ enum {
 
   l_librbd_pwl_internal_flush,
   l_librbd_pwl_writeback_latency,
+  l_librbd_pwl_writeback_bytes,
+  l_librbd_pwl_writeback_coalesced,
   l_librbd_pwl_invalidate_cache,
   l_librbd_pwl_invalidate_discard_cache,
 
@@ -166,8 +168,8 @@ namespace pwl {
 
 class ImageExtentBuf;
 
-const int IN_FLIGHT_FLUSH_WRITE_LIMIT = 64;
-const int IN_FLIGHT_FLUSH_BYTES_LIMIT = (1 * 1024 * 1024);
+/* Largest write back to the image that adjacent entries are merged into */
+const uint64_t MAX_COALESCED_WRITEBACK_BYTES = (4 * 1024 * 1024);
 
 /* Limit work between sync points */
 const uint64_t MAX_WRITES_PER_SYNC_POINT = 256;
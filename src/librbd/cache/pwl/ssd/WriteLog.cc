@@ -597,48 +597,117 @@ void WriteLog<I>::construct_flush_entries(pwl::GenericLogEntries entries_to_flus
       [this, entries_to_flush, read_bls](int r) {
         int i = 0;
 	GuardedRequestFunctionContext *guarded_ctx = nullptr;
+	std::shared_ptr<CoalescedWriteback> wb;
 
 	for (auto &log_entry : entries_to_flush) {
-	  if (log_entry->is_write_entry()) {
-	    bufferlist captured_entry_bl;
-	    captured_entry_bl.claim_append(*read_bls[i]);
+	  if (log_entry->is_write_entry() && !log_entry->is_writesame_entry()) {
+	    auto &ram_entry = log_entry->ram_entry;
+	    if (wb && wb->can_append(ram_entry.image_offset_bytes,
+	                             ram_entry.write_bytes)) {
+	      this->m_perfcounter->inc(l_librbd_pwl_writeback_coalesced);
+	    } else {
+	      if (wb) {
+	        coalesced_writeback_ready(wb, nullptr);
+	      }
+	      wb = std::make_shared<CoalescedWriteback>();
+	      wb->image_offset = ram_entry.image_offset_bytes;
+	    }
+	    wb->bl.claim_append(*read_bls[i]);
 	    delete read_bls[i++];
+	    {
+	      std::lock_guard locker(wb->lock);
+	      ++wb->pending;
+	    }
 
-	    guarded_ctx = new GuardedRequestFunctionContext([this, log_entry, captured_entry_bl]
+	    guarded_ctx = new GuardedRequestFunctionContext([this, log_entry, wb]
               (GuardedRequestFunctionContext &guard_ctx) {
                 log_entry->m_cell = guard_ctx.cell;
                 Context *ctx = this->construct_flush_entry(log_entry, false);
-
-	        m_image_ctx.op_work_queue->queue(new LambdaContext(
-	          [this, log_entry, entry_bl=std::move(captured_entry_bl), ctx](int r) {
-		    auto captured_entry_bl = std::move(entry_bl);
-		    ldout(m_image_ctx.cct, 15) << "flushing:" << log_entry
-			                       << " " << *log_entry << dendl;
-		    log_entry->writeback_bl(this->m_image_writeback, ctx,
-                                            std::move(captured_entry_bl));
-	          }), 0);
+                coalesced_writeback_ready(wb, ctx);
 	      });
 	  } else {
-	    guarded_ctx = new GuardedRequestFunctionContext([this, log_entry]
-              (GuardedRequestFunctionContext &guard_ctx) {
-                log_entry->m_cell = guard_ctx.cell;
-                Context *ctx = this->construct_flush_entry(log_entry, false);
-	        m_image_ctx.op_work_queue->queue(new LambdaContext(
-		  [this, log_entry, ctx](int r) {
-		    ldout(m_image_ctx.cct, 15) << "flushing:" << log_entry
-                                               << " " << *log_entry << dendl;
-		    log_entry->writeback(this->m_image_writeback, ctx);
-		  }), 0);
-            });
+	    if (wb) {
+	      coalesced_writeback_ready(wb, nullptr);
+	      wb.reset();
+	    }
+	    if (log_entry->is_write_entry()) {
+	      bufferlist captured_entry_bl;
+	      captured_entry_bl.claim_append(*read_bls[i]);
+	      delete read_bls[i++];
+
+	      guarded_ctx = new GuardedRequestFunctionContext([this, log_entry, captured_entry_bl]
+                (GuardedRequestFunctionContext &guard_ctx) {
+                  log_entry->m_cell = guard_ctx.cell;
+                  Context *ctx = this->construct_flush_entry(log_entry, false);
+
+	          m_image_ctx.op_work_queue->queue(new LambdaContext(
+	            [this, log_entry, entry_bl=std::move(captured_entry_bl), ctx](int r) {
+		      auto captured_entry_bl = std::move(entry_bl);
+		      ldout(m_image_ctx.cct, 15) << "flushing:" << log_entry
+			                         << " " << *log_entry << dendl;
+		      log_entry->writeback_bl(this->m_image_writeback, ctx,
+                                              std::move(captured_entry_bl));
+	            }), 0);
+	        });
+	    } else {
+	      guarded_ctx = new GuardedRequestFunctionContext([this, log_entry]
+                (GuardedRequestFunctionContext &guard_ctx) {
+                  log_entry->m_cell = guard_ctx.cell;
+                  Context *ctx = this->construct_flush_entry(log_entry, false);
+	          m_image_ctx.op_work_queue->queue(new LambdaContext(
+		    [this, log_entry, ctx](int r) {
+		      ldout(m_image_ctx.cct, 15) << "flushing:" << log_entry
+                                                 << " " << *log_entry << dendl;
+		      log_entry->writeback(this->m_image_writeback, ctx);
+		    }), 0);
+              });
+	    }
 	  }
           this->detain_flush_guard_request(log_entry, guarded_ctx);
 	}
+	if (wb) {
+	  coalesced_writeback_ready(wb, nullptr);
+	}
       });
 
     aio_read_data_blocks(write_entries, read_bls, ctx);
   }
 }
 
+/*
+ * Called once for each entry of @wb as the flush guard admits it (with
+ * that entry's flush completion), and once with a null context when no
+ * more entries will be added.  The last call sends the write.
+ */
+template <typename I>
+void WriteLog<I>::coalesced_writeback_ready(
+    std::shared_ptr<CoalescedWriteback> wb, Context *on_finish) {
+  {
+    std::lock_guard locker(wb->lock);
+    if (on_finish) {
+      wb->on_finish.push_back(on_finish);
+    }
+    if (--wb->pending > 0) {
+      return;
+    }
+  }
+
+  m_image_ctx.op_work_queue->queue(new LambdaContext(
+    [this, wb](int r) {
+      uint64_t length = wb->bl.length();
+      ldout(m_image_ctx.cct, 15) << "flushing " << wb->on_finish.size()
+                                 << " entries: " << wb->image_offset << "~"
+                                 << length << dendl;
+      this->m_image_writeback.aio_write(
+        {{wb->image_offset, length}}, std::move(wb->bl), 0,
+        new LambdaContext([wb](int r) {
+          for (auto ctx : wb->on_finish) {
+            ctx->complete(r);
+          }
+        }));
+    }), 0);
+}
+
 template <typename I>
 void WriteLog<I>::process_work() {
   CephContext *cct = m_image_ctx.cct;
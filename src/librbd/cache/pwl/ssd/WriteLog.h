@@ -48,6 +48,23 @@ public:
   using C_WriteRequestT = pwl::C_WriteRequest<This>;
   using C_WriteSameRequestT = pwl::C_WriteSameRequest<This>;
 
+  /* Adjacent write entries written back to the image as a single write */
+  struct CoalescedWriteback {
+    uint64_t image_offset = 0;
+    bufferlist bl;
+    ceph::mutex lock = ceph::make_mutex(
+      "librbd::cache::pwl::ssd::WriteLog::CoalescedWriteback::lock");
+    std::vector<Context*> on_finish;
+    /* entries not yet admitted by the flush guard, plus one while building */
+    int pending = 1;
+
+    /* may an entry for image extent @offset~@length join this write? */
+    bool can_append(uint64_t offset, uint64_t length) const {
+      return offset == image_offset + bl.length() &&
+             bl.length() + length <= MAX_COALESCED_WRITEBACK_BYTES;
+    }
+  };
+
   bool alloc_resources(C_BlockIORequestT *req) override;
   void setup_schedule_append(
       pwl::GenericLogOperationsVector &ops, bool do_early_flush,
@@ -118,6 +135,8 @@ private:
       std::vector<std::shared_ptr<GenericWriteLogEntry>> &log_entries_to_read,
       std::vector<bufferlist*> &bls_to_read, Context *ctx) override;
   void enlist_op_appender();
+  void coalesced_writeback_ready(std::shared_ptr<CoalescedWriteback> wb,
+                                 Context *on_finish);
   bool retire_entries(const unsigned long int frees_per_tx);
   bool has_sync_point_logs(GenericLogOperations &ops);
   void append_op_log_entries(GenericLogOperations &ops);
@@ -12,6 +12,7 @@
 #include "librbd/Utils.h"
 #include "librbd/io/DispatcherInterface.h"
 #include "librbd/io/Types.h"
+#include <atomic>
 #include <map>
 
 #define dout_subsys ceph_subsys_rbd
@@ -100,6 +101,8 @@ public:
     ldout(cct, 20) << "dispatch_spec=" << dispatch_spec << dendl;
 
     auto dispatch_layer = dispatch_spec->dispatch_layer;
+    bool bypass = (m_bypass_layers.load(std::memory_order_relaxed) != 0 &&
+                   can_bypass(dispatch_spec));
 
     // apply the IO request to all layers -- this method will be re-invoked
     // by the dispatch layer if continuing / restarting the IO
@@ -107,6 +110,14 @@ public:
       m_lock.lock_shared();
       dispatch_layer = dispatch_spec->dispatch_layer;
       auto it = m_dispatches.upper_bound(dispatch_layer);
+      if (bypass) {
+        // step over pass-through layers without dropping the lock
+        auto bypass_layers = m_bypass_layers.load(std::memory_order_relaxed);
+        while (it != m_dispatches.end() &&
+               (bypass_layers & (1ULL << it->first)) != 0) {
+          ++it;
+        }
+      }
       if (it == m_dispatches.end()) {
         // the request is complete if handled by all layers
         dispatch_spec->dispatch_result = DISPATCH_RESULT_COMPLETE;
@@ -156,9 +167,27 @@ protected:
   ceph::shared_mutex m_lock;
   std::map<DispatchLayer, DispatchMeta> m_dispatches;
 
+  // layers that currently pass every request they may skip straight
+  // through, see can_bypass()
+  std::atomic<uint64_t> m_bypass_layers{0};
+
   virtual bool send_dispatch(Dispatch* dispatch,
                              DispatchSpec* dispatch_spec) = 0;
 
+  /// may @p dispatch_spec skip the layers marked as pass-through?
+  virtual bool can_bypass(DispatchSpec* dispatch_spec) {
+    return false;
+  }
+
+  void set_layer_bypassed(DispatchLayer dispatch_layer, bool bypassed) {
+    ceph_assert(dispatch_layer < 64);
+    if (bypassed) {
+      m_bypass_layers.fetch_or(1ULL << dispatch_layer);
+    } else {
+      m_bypass_layers.fetch_and(~(1ULL << dispatch_layer));
+    }
+  }
+
 protected:
   struct C_LayerIterator : public Context {
     Dispatcher* dispatcher;
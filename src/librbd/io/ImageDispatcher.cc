@@ -186,6 +186,7 @@ ImageDispatcher<I>::ImageDispatcher(I* image_ctx)
 
   m_qos_image_dispatch = new QosImageDispatch<I>(image_ctx);
   this->register_dispatch(m_qos_image_dispatch);
+  update_qos_bypass();
 
   auto refresh_image_dispatch = new RefreshImageDispatch(image_ctx);
   this->register_dispatch(refresh_image_dispatch);
@@ -233,11 +234,21 @@ template <typename I>
 void ImageDispatcher<I>::apply_qos_limit(uint64_t flag, uint64_t limit,
                                          uint64_t burst, uint64_t burst_seconds) {
   m_qos_image_dispatch->apply_qos_limit(flag, limit, burst, burst_seconds);
+  update_qos_bypass();
 }
 
 template <typename I>
 void ImageDispatcher<I>::apply_qos_exclude_ops(uint64_t exclude_ops) {
   m_qos_image_dispatch->apply_qos_exclude_ops(exclude_ops);
+  update_qos_bypass();
+}
+
+template <typename I>
+void ImageDispatcher<I>::update_qos_bypass() {
+  // with no limits set the QoS layer passes all IO through untouched, so
+  // skip it altogether
+  this->set_layer_bypassed(IMAGE_DISPATCH_LAYER_QOS,
+                           !m_qos_image_dispatch->is_enabled());
 }
 
 template <typename I>
@@ -283,6 +294,14 @@ bool ImageDispatcher<I>::send_dispatch(
     image_dispatch_spec->request);
 }
 
+template <typename I>
+bool ImageDispatcher<I>::can_bypass(ImageDispatchSpec* image_dispatch_spec) {
+  // flushes are ordered against IO still held back by a layer even if
+  // that layer would let new IO through
+  return boost::get<ImageDispatchSpec::Flush>(
+    &image_dispatch_spec->request) == nullptr;
+}
+
 template <typename I>
 bool ImageDispatcher<I>::preprocess(
     ImageDispatchSpec* image_dispatch_spec) {
@@ -50,6 +50,7 @@ protected:
   bool send_dispatch(
     ImageDispatchInterface* image_dispatch,
     ImageDispatchSpec* image_dispatch_spec) override;
+  bool can_bypass(ImageDispatchSpec* image_dispatch_spec) override;
 
 private:
   struct SendVisitor;
@@ -63,6 +64,7 @@ private:
   WriteBlockImageDispatch<ImageCtxT>* m_write_block_dispatch = nullptr;
 
   bool preprocess(ImageDispatchSpec* image_dispatch_spec);
+  void update_qos_bypass();
 
 };
 
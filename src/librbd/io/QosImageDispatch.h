@@ -52,6 +52,9 @@ public:
   void apply_qos_limit(uint64_t flag, uint64_t limit, uint64_t burst,
                        uint64_t burst_seconds);
   void apply_qos_exclude_ops(uint64_t exclude_ops);
+  bool is_enabled() const {
+    return m_qos_enabled_flag != 0;
+  }
 
   bool read(
       AioCompletion* aio_comp, Extents &&image_extents,
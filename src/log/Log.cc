@@ -28,6 +28,7 @@
 #include <algorithm>
 #include <iostream>
 #include <set>
+#include <thread>
 
 #include <fmt/format.h>
 #include <fmt/ostream.h>
@@ -39,6 +40,118 @@ namespace logging {
 
 static OnExitManager exit_callbacks;
 
+static std::atomic<uint64_t> next_log_id = 0;
+
+namespace {
+// an Entry whose text lives elsewhere; turns ring records back into
+// ConcreteEntry
+class RecordEntry : public Entry {
+public:
+  RecordEntry(log_time stamp, pthread_t thread, short prio, short subsys,
+	      const char *thread_name, std::string_view text)
+    : Entry(prio, subsys), text(text) {
+    m_stamp = stamp;
+    m_thread = thread;
+    memcpy(m_thread_name, thread_name, sizeof(m_thread_name));
+  }
+  std::string_view strv() const override {
+    return text;
+  }
+  std::size_t size() const override {
+    return text.size();
+  }
+private:
+  std::string_view text;
+};
+}
+
+/*
+ * A thread's ring of entries that are gathered but not written.  It is
+ * a plain byte ring of (header, text) records, so keeping an entry costs
+ * a memcpy of its text instead of a ConcreteEntry.  The oldest records
+ * are evicted to make room.  Only the owning thread appends, so the lock
+ * is uncontended except while dump_recent() reads the ring.
+ */
+class Log::ThreadRecent {
+public:
+  explicit ThreadRecent(std::size_t capacity) : m_buf(capacity) {}
+
+  std::mutex lock;
+  std::atomic<bool> thread_gone = false;  ///< owning thread has exited
+  std::atomic<bool> log_gone = false;     ///< owning Log was destroyed
+
+  std::size_t capacity() const {
+    return m_buf.size();
+  }
+  void resize(std::size_t capacity) {
+    m_buf.assign(capacity, 0);
+    m_head = m_used = 0;
+  }
+
+  /// append e, evicting old records; false if e can never fit
+  bool push(const Entry& e) {
+    const auto text = e.strv();
+    const std::size_t need = sizeof(header_t) + text.size();
+    if (need > m_buf.size()) {
+      return false;
+    }
+    while (m_buf.size() - m_used < need) {
+      header_t h;
+      _read(m_head, &h, sizeof(h));
+      m_head = (m_head + sizeof(h) + h.len) % m_buf.size();
+      m_used -= sizeof(h) + h.len;
+    }
+    header_t h{e.m_stamp, e.m_thread, e.m_prio, e.m_subsys,
+	       static_cast<uint32_t>(text.size()), {}};
+    memcpy(h.thread_name, e.m_thread_name, sizeof(h.thread_name));
+    const std::size_t tail = (m_head + m_used) % m_buf.size();
+    _write(tail, &h, sizeof(h));
+    _write((tail + sizeof(h)) % m_buf.size(), text.data(), text.size());
+    m_used += need;
+    return true;
+  }
+
+  /// move all records to t, oldest first
+  void collect(EntryVector& t) {
+    std::string text;
+    while (m_used) {
+      header_t h;
+      _read(m_head, &h, sizeof(h));
+      text.resize(h.len);
+      _read((m_head + sizeof(h)) % m_buf.size(), text.data(), h.len);
+      t.emplace_back(RecordEntry(h.stamp, h.thread, h.prio, h.subsys,
+				 h.thread_name, text));
+      m_head = (m_head + sizeof(h) + h.len) % m_buf.size();
+      m_used -= sizeof(h) + h.len;
+    }
+    m_head = 0;
+  }
+
+private:
+  struct header_t {
+    log_time stamp;
+    pthread_t thread;
+    short prio, subsys;
+    uint32_t len;
+    char thread_name[16];
+  };
+
+  void _write(std::size_t pos, const void *p, std::size_t len) {
+    const std::size_t first = std::min(len, m_buf.size() - pos);
+    memcpy(m_buf.data() + pos, p, first);
+    memcpy(m_buf.data(), static_cast<const char*>(p) + first, len - first);
+  }
+  void _read(std::size_t pos, void *p, std::size_t len) const {
+    const std::size_t first = std::min(len, m_buf.size() - pos);
+    memcpy(p, m_buf.data() + pos, first);
+    memcpy(static_cast<char*>(p) + first, m_buf.data(), len - first);
+  }
+
+  std::vector<char> m_buf;
+  std::size_t m_head = 0;  ///< offset of the oldest record
+  std::size_t m_used = 0;
+};
+
 static void log_on_exit(void *p)
 {
   Log *l = *(Log **)p;
@@ -50,7 +163,8 @@ static void log_on_exit(void *p)
 Log::Log(const SubsystemMap *s)
   : m_indirect_this(nullptr),
     m_subs(s),
-    m_recent(DEFAULT_MAX_RECENT)
+    m_recent(DEFAULT_MAX_RECENT),
+    m_id(next_log_id++)
 {
   m_log_buf.reserve(MAX_LOG_BUF);
   _configure_stderr();
@@ -63,6 +177,12 @@ Log::~Log()
   }
 
   ceph_assert(!is_started());
+  {
+    std::scoped_lock lock(m_thread_recent_mutex);
+    for (auto& ring : m_thread_recent) {
+      ring->log_gone = true;
+    }
+  }
   if (m_fd >= 0) {
     VOID_TEMP_FAILURE_RETRY(::close(m_fd));
     m_fd = -1;
@@ -138,6 +258,11 @@ void Log::set_max_recent(std::size_t n)
   m_recent.set_capacity(n);
 }
 
+void Log::set_max_recent_thread_bytes(std::size_t n)
+{
+  m_max_recent_thread_bytes = n;
+}
+
 void Log::set_log_file(std::string_view fn)
 {
   std::scoped_lock lock(m_flush_mutex);
@@ -247,8 +372,128 @@ void Log::stop_journald_logger()
   m_journald.reset();
 }
 
+std::shared_ptr<Log::ThreadRecent> Log::_register_thread_recent()
+{
+  std::scoped_lock lock(m_thread_recent_mutex);
+  // drop the rings of exited threads, but keep what they gathered by
+  // passing it on to the shared recent ring
+  EntryVector orphans;
+  std::erase_if(m_thread_recent, [&orphans](auto& ring) {
+    if (!ring->thread_gone) {
+      return false;
+    }
+    std::scoped_lock ring_lock(ring->lock);
+    ring->collect(orphans);
+    return true;
+  });
+  if (!orphans.empty()) {
+    std::scoped_lock queue_lock(m_queue_mutex);
+    m_new.insert(m_new.end(), std::make_move_iterator(orphans.begin()),
+		 std::make_move_iterator(orphans.end()));
+    m_cond_flusher.notify_all();
+  }
+  auto ring = std::make_shared<ThreadRecent>(m_max_recent_thread_bytes);
+  m_thread_recent.push_back(ring);
+  return ring;
+}
+
+bool Log::_gather_entry(const Entry& e)
+{
+  // the rings this thread keeps, one per Log it has gathered entries for.
+  // trivially destructible, so that it can still be looked at while the
+  // thread's other thread_local objects are being destroyed
+  using rings_t = std::vector<std::pair<uint64_t, std::shared_ptr<ThreadRecent>>>;
+  struct thread_rings_t {
+    rings_t* rings = nullptr; // owned by thread_rings_owner_t
+    bool exiting = false;     // the rings are gone, use the shared queue
+  };
+  static thread_local thread_rings_t tls;
+
+  struct thread_rings_owner_t {
+    rings_t rings;
+    thread_rings_owner_t() {
+      tls.rings = &rings;
+    }
+    ~thread_rings_owner_t() {
+      for (auto& [log_id, ring] : rings) {
+	ring->thread_gone = true;
+      }
+      tls.rings = nullptr;
+      tls.exiting = true;
+    }
+  };
+
+  if (unlikely(tls.exiting)) {
+    return false;
+  }
+  if (unlikely(!tls.rings)) {
+    // destroyed before any thread_local constructed ahead of it, which
+    // may still log on its way out
+    static thread_local thread_rings_owner_t owner;
+  }
+  auto& rings = *tls.rings;
+
+  ThreadRecent *ring = nullptr;
+  for (auto i = rings.begin(); i != rings.end(); ) {
+    if (i->second->log_gone) {
+      i = rings.erase(i);
+    } else if (i->first == m_id) {
+      ring = i->second.get();
+      break;
+    } else {
+      ++i;
+    }
+  }
+  if (!ring) {
+    ring = rings.emplace_back(m_id, _register_thread_recent()).second.get();
+  }
+
+  std::scoped_lock lock(ring->lock);
+  if (const auto capacity = m_max_recent_thread_bytes.load();
+      unlikely(ring->capacity() != capacity)) {
+    ring->resize(capacity);
+  }
+  return ring->push(e);
+}
+
+// we may be dumping from a signal handler on a thread that crashed while
+// holding one of these locks; don't wait forever for it
+template <typename Mutex>
+static std::unique_lock<Mutex> try_lock_bounded(Mutex& m)
+{
+  std::unique_lock lock(m, std::defer_lock);
+  for (int i = 0; i < 1000 && !lock.try_lock(); i++) {
+    std::this_thread::yield();
+  }
+  return lock;
+}
+
+void Log::_collect_thread_recent(EntryVector& t)
+{
+  // a thread registering or unregistering its ring holds this one
+  auto lock = try_lock_bounded(m_thread_recent_mutex);
+  if (!lock.owns_lock()) {
+    return;
+  }
+  for (auto& ring : m_thread_recent) {
+    if (auto ring_lock = try_lock_bounded(ring->lock); ring_lock.owns_lock()) {
+      ring->collect(t);
+    }
+  }
+}
+
 void Log::submit_entry(Entry&& e)
 {
+  // entries that are only gathered never leave memory unless we crash;
+  // keep them in this thread's ring rather than queueing them for the
+  // flusher
+  if (m_max_recent_thread_bytes.load(std::memory_order_relaxed) &&
+      m_subs->get_log_level(e.m_subsys) < e.m_prio &&
+      likely(!m_inject_segv) &&
+      _gather_entry(e)) {
+    return;
+  }
+
   std::unique_lock lock(m_queue_mutex);
   m_queue_mutex_holder = pthread_self();
 
@@ -493,13 +738,17 @@ void Log::dump_recent()
   _flush(m_flush, false);
 
   _log_message("--- begin dump of recent events ---", true);
-  std::set<std::pair<pthread_t, const char *>> recent_pthread_ids;
+  std::set<std::pair<pthread_t, std::string>> recent_pthread_ids;
   {
     EntryVector t;
     t.insert(t.end(), std::make_move_iterator(m_recent.begin()), std::make_move_iterator(m_recent.end()));
     m_recent.clear();
+    _collect_thread_recent(t);
+    std::stable_sort(t.begin(), t.end(), [](const auto& a, const auto& b) {
+      return a.m_stamp < b.m_stamp;
+    });
     for (const auto& e : t) {
-      recent_pthread_ids.emplace(std::make_pair(e.m_thread, e.m_thread_name));
+      recent_pthread_ids.emplace(e.m_thread, e.m_thread_name);
     }
     _flush(t, true);
   }
@@ -524,6 +773,8 @@ void Log::dump_recent()
 
   _log_message(fmt::format("  max_recent {:9}", m_recent.capacity()), true);
   _log_message(fmt::format("  max_new    {:9}", m_max_new), true);
+  _log_message(fmt::format("  max_recent_thread_bytes {:9}",
+			   m_max_recent_thread_bytes.load()), true);
   _log_message(fmt::format("  log_file {}", m_log_file), true);
 
   _log_message("--- end dump of recent events ---", true);
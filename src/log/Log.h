@@ -6,12 +6,14 @@
 
 #include <boost/circular_buffer.hpp>
 
+#include <atomic>
 #include <condition_variable>
 #include <memory>
 #include <mutex>
 #include <queue>
 #include <string>
 #include <string_view>
+#include <vector>
 
 #include "common/Thread.h"
 #include "common/likely.h"
@@ -42,6 +44,7 @@ public:
   void set_coarse_timestamps(bool coarse);
   void set_max_new(std::size_t n);
   void set_max_recent(std::size_t n);
+  void set_max_recent_thread_bytes(std::size_t n);
   void set_log_file(std::string_view fn);
   void reopen_log_file();
   void chown_log_file(uid_t uid, gid_t gid);
@@ -86,6 +89,7 @@ protected:
 
 private:
   using EntryRing = boost::circular_buffer<ConcreteEntry>;
+  class ThreadRecent;
 
   static const std::size_t DEFAULT_MAX_NEW = 100;
   static const std::size_t DEFAULT_MAX_RECENT = 10000;
@@ -106,6 +110,13 @@ private:
   EntryRing m_recent; ///< recent (less new) entries we've already written at low detail
   EntryVector m_flush; ///< entries to be flushed (here to optimize heap allocations)
 
+  /// per-thread rings of entries that are gathered but not logged; they
+  /// bypass m_queue_mutex and the flusher and are only read by dump_recent()
+  std::mutex m_thread_recent_mutex;
+  std::vector<std::shared_ptr<ThreadRecent>> m_thread_recent;
+  std::atomic<std::size_t> m_max_recent_thread_bytes = 0;
+  const uint64_t m_id;  ///< tells Log instances apart in thread-local state
+
   std::string m_log_file;
   int m_fd = -1;
   uid_t m_uid = 0;
@@ -136,6 +147,10 @@ private:
 
   void *entry() override;
 
+  bool _gather_entry(const Entry& e);
+  std::shared_ptr<ThreadRecent> _register_thread_recent();
+  void _collect_thread_recent(EntryVector& t);
+
   void _log_safe_write(std::string_view sv);
   void _flush_logbuf();
   void _log_message(std::string_view s, bool crash);
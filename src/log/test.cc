@@ -10,6 +10,9 @@
 #include "global/global_context.h"
 #include "common/dout.h"
 
+#include <fstream>
+#include <thread>
+
 #include <unistd.h>
 
 #include <limits.h>
@@ -57,6 +60,98 @@ TEST(Log, Simple)
   log.stop();
 }
 
+TEST(Log, ThreadRecent)
+{
+  static const char* test_file = "log_thread_recent";
+  SubsystemMap subs;
+  subs.set_log_level(1, 1);
+  subs.set_gather_level(1, 20);
+
+  Log log(&subs);
+  log.set_max_recent_thread_bytes(4096);
+  log.start();
+  unlink(test_file);
+  log.set_log_file(test_file);
+  log.reopen_log_file();
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([&log, t] {
+      for (int i = 0; i < 1000; i++) {
+	MutableEntry e(10, 1);
+	e.get_ostream() << "thread " << t << " entry " << i;
+	log.submit_entry(std::move(e));
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  log.flush();
+  // none of it was written out ...
+  struct stat file_status;
+  ASSERT_EQ(stat(test_file, &file_status), 0);
+  ASSERT_EQ(file_status.st_size, 0);
+
+  // ... but the newest entries of every thread are dumped
+  log.dump_recent();
+  log.stop();
+  std::ifstream in(test_file);
+  std::string contents((std::istreambuf_iterator<char>(in)),
+		       std::istreambuf_iterator<char>());
+  for (int t = 0; t < 4; t++) {
+    ASSERT_NE(contents.find(fmt::format("thread {} entry 999", t)),
+	      std::string::npos);
+    ASSERT_EQ(contents.find(fmt::format("thread {} entry 0\n", t)),
+	      std::string::npos);
+  }
+  unlink(test_file);
+}
+
+TEST(Log, ThreadRecentExit)
+{
+  static const char* test_file = "log_thread_recent_exit";
+  SubsystemMap subs;
+  subs.set_log_level(1, 1);
+  subs.set_gather_level(1, 20);
+
+  Log log(&subs);
+  log.set_max_recent_thread_bytes(4096);
+  log.start();
+  unlink(test_file);
+  log.set_log_file(test_file);
+  log.reopen_log_file();
+
+  // logs from its destructor, after the rings of its thread are gone
+  struct log_at_exit_t {
+    Log* log = nullptr;
+    ~log_at_exit_t() {
+      if (log) {
+	MutableEntry e(10, 1);
+	e.get_ostream() << "logged at exit";
+	log->submit_entry(std::move(e));
+      }
+    }
+  };
+  std::thread([&log] {
+    static thread_local log_at_exit_t at_exit;
+    at_exit.log = &log;
+    MutableEntry e(10, 1);
+    e.get_ostream() << "logged before exit";
+    log.submit_entry(std::move(e));
+  }).join();
+  log.flush();
+
+  log.dump_recent();
+  log.stop();
+  std::ifstream in(test_file);
+  std::string contents((std::istreambuf_iterator<char>(in)),
+		       std::istreambuf_iterator<char>());
+  ASSERT_NE(contents.find("logged before exit"), std::string::npos);
+  ASSERT_NE(contents.find("logged at exit"), std::string::npos);
+  unlink(test_file);
+}
+
 TEST(Log, ReuseBad)
 {
   SubsystemMap subs;
@@ -53,6 +53,9 @@ public:
   void init(const MDSMap &mdsmap);
   void shutdown();
 
+  bool ms_can_dispatch_concurrently() const override {
+    return true;
+  }
   bool ms_dispatch2(const ref_t<Message> &m) override;
   void ms_handle_connect(Connection *c) override {}
   bool ms_handle_reset(Connection *c) override {return false;}
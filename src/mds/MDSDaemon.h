@@ -145,6 +145,9 @@ class MDSDaemon : public Dispatcher {
   class MDSSocketHook *asok_hook = nullptr;
 
  private:
+  bool ms_can_dispatch_concurrently() const override {
+    return true;
+  }
   bool ms_dispatch2(const ref_t<Message> &m) override;
   bool ms_handle_fast_authentication(Connection *con) override;
   void ms_handle_accept(Connection *con) override;
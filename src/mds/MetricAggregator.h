@@ -34,6 +34,9 @@ public:
 
   void notify_mdsmap(const MDSMap &mdsmap);
 
+  bool ms_can_dispatch_concurrently() const override {
+    return true;
+  }
   bool ms_dispatch2(const ref_t<Message> &m) override;
 
   void ms_handle_connect(Connection *c) override {
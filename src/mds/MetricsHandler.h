@@ -30,6 +30,9 @@ public:
   }
   bool ms_can_fast_dispatch2(const cref_t<Message> &m) const override;
   void ms_fast_dispatch2(const ref_t<Message> &m) override;
+  bool ms_can_dispatch_concurrently() const override {
+    return true;
+  }
   bool ms_dispatch2(const ref_t<Message> &m) override;
 
   void ms_handle_connect(Connection *c) override {
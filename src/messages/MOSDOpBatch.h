@@ -0,0 +1,152 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef CEPH_MOSDOPBATCH_H
+#define CEPH_MOSDOPBATCH_H
+
+#include "msg/Message.h"
+
+/*
+ * MOSDOpBatch - several client ops bound for the same OSD
+ *
+ * The Objecter coalesces small MOSDOps (see objecter_op_batch_max) and
+ * the OSD splits them up again before dispatch, so each op is queued,
+ * executed and replied to exactly as if it had been sent on its own.
+ * The ops travel as complete messages minus their footers; the crcs of
+ * the batch itself cover them.
+ */
+class MOSDOpBatch final : public Message {
+public:
+  static constexpr int HEAD_VERSION = 1;
+  static constexpr int COMPAT_VERSION = 1;
+
+private:
+  struct raw_op_t {
+    ceph_msg_header header;
+    ceph::buffer::list front, middle, data;
+  };
+
+  std::vector<ceph::ref_t<Message>> ops;  ///< outgoing
+  std::vector<raw_op_t> raw_ops;          ///< incoming, until split()
+
+public:
+  MOSDOpBatch()
+    : Message{MSG_OSD_OP_BATCH, HEAD_VERSION, COMPAT_VERSION} {}
+
+  void add_op(ceph::ref_t<Message> m) {
+    if (ops.empty() || m->get_priority() > get_priority())
+      set_priority(m->get_priority());
+    ops.push_back(std::move(m));
+  }
+  size_t get_num_ops() const {
+    return ops.size() + raw_ops.size();
+  }
+
+#ifndef WITH_SEASTAR
+  /**
+   * Rebuild the carried ops as messages of their own on our connection.
+   *
+   * Each op takes over its share of our messenger throttle budget, so
+   * the throttles keep accounting for it until it completes rather than
+   * until the batch is released.
+   */
+  std::vector<ceph::ref_t<Message>> split(CephContext *cct) {
+    std::vector<ceph::ref_t<Message>> out;
+    out.reserve(raw_ops.size());
+    uint64_t bytes = 0;
+    for (auto& r : raw_ops) {
+      if (r.header.type != CEPH_MSG_OSD_OP) {
+	// only ever client ops; anything else would sidestep the checks
+	// the OSD does on the peer type for other messages
+	continue;
+      }
+      ceph_msg_footer f{};
+      f.flags = CEPH_MSG_FOOTER_COMPLETE;
+      r.header.src = header.src;
+      ceph::ref_t<Message> m{
+	decode_message(cct, 0, r.header, f, r.front, r.middle, r.data,
+		       get_connection()),
+	false};
+      if (!m) {
+	continue;
+      }
+      m->set_recv_stamp(get_recv_stamp());
+      m->set_throttle_stamp(get_throttle_stamp());
+      m->set_recv_complete_stamp(get_recv_complete_stamp());
+      if (byte_throttler) {
+	m->set_byte_throttler(byte_throttler);
+	bytes += m->get_payload().length() + m->get_middle().length() +
+	  m->get_data().length();
+      }
+      if (msg_throttler) {
+	m->set_message_throttler(msg_throttler);
+      }
+      out.push_back(std::move(m));
+    }
+    raw_ops.clear();
+    if (byte_throttler) {
+      uint64_t ours = payload.length() + middle.length() + data.length();
+      byte_throttler->put(ours > bytes ? ours - bytes : 0);
+      byte_throttler = nullptr;
+    }
+    if (msg_throttler && !out.empty()) {
+      // the first op inherits our slot
+      if (out.size() > 1)
+	msg_throttler->take(out.size() - 1);
+      msg_throttler = nullptr;
+    }
+    return out;
+  }
+#endif
+
+  void encode_payload(uint64_t features) override {
+    using ceph::encode;
+    encode((uint32_t)ops.size(), payload);
+    for (auto& m : ops) {
+      m->encode(features, 0);
+      encode(m->get_header(), payload);
+      encode(m->get_payload(), payload);
+      encode(m->get_middle(), payload);
+      encode(m->get_data(), payload);
+    }
+  }
+  void decode_payload() override {
+    using ceph::decode;
+    auto p = payload.cbegin();
+    uint32_t n;
+    decode(n, p);
+    raw_ops.clear();
+    while (n--) {
+      raw_op_t r;
+      decode(r.header, p);
+      decode(r.front, p);
+      decode(r.middle, p);
+      decode(r.data, p);
+      raw_ops.push_back(std::move(r));
+    }
+  }
+
+  std::string_view get_type_name() const override { return "osd_op_batch"; }
+  void print(std::ostream& out) const override {
+    out << "osd_op_batch(" << get_num_ops() << " ops";
+    for (auto& m : ops) {
+      out << " " << *m;
+    }
+    out << ")";
+  }
+
+private:
+  template<class T, typename... Args>
+  friend boost::intrusive_ptr<T> ceph::make_message(Args&&... args);
+};
+
+#endif
@@ -120,6 +120,9 @@ public:
 
   void set_mgr_optional(bool optional_) {mgr_optional = optional_;}
 
+  bool ms_can_dispatch_concurrently() const override {
+    return true;
+  }
   bool ms_dispatch2(const ceph::ref_t<Message>& m) override;
   bool ms_handle_reset(Connection *con) override;
   void ms_handle_remote_reset(Connection *con) override {}
@@ -312,6 +312,9 @@ private:
 
   void send_log(bool flush = false);
 
+  bool ms_can_dispatch_concurrently() const override {
+    return true;
+  }
   bool ms_dispatch(Message *m) override;
   bool ms_handle_reset(Connection *con) override;
   void ms_handle_remote_reset(Connection *con) override {}
@@ -16,6 +16,8 @@
 #include "DispatchQueue.h"
 #include "Messenger.h"
 #include "common/ceph_context.h"
+#include "common/perf_counters.h"
+#include "common/perf_counters_key.h"
 
 #define dout_subsys ceph_subsys_ms
 #include "common/debug.h"
@@ -30,12 +32,104 @@ using ceph::ref_t;
 #undef dout_prefix
 #define dout_prefix *_dout << "-- " << msgr->get_myaddrs() << " "
 
+DispatchQueue::Shard::Shard(DispatchQueue *dq, const std::string& name,
+			    unsigned idx)
+  : lock(ceph::make_mutex("Messenger::DispatchQueue::lock" + name +
+			  (idx ? "-" + std::to_string(idx) : ""))),
+    mqueue(dq->cct->_conf->ms_pq_max_tokens_per_priority,
+	   dq->cct->_conf->ms_pq_min_cost),
+    dispatch_thread(dq, this)
+{
+}
+
+DispatchQueue::DispatchQueue(CephContext *cct, Messenger *msgr, std::string &name)
+  : cct(cct), msgr(msgr),
+    next_id(1),
+    local_delivery_lock(ceph::make_mutex("Messenger::DispatchQueue::local_delivery_lock" + name)),
+    stop_local_delivery(false),
+    local_delivery_thread(this),
+    dispatch_throttler(cct, std::string("msgr_dispatch_throttler-") + name,
+		       cct->_conf->ms_dispatch_throttle_bytes),
+    stop(false)
+{
+  const unsigned num_shards =
+    std::max<uint64_t>(1, cct->_conf.get_val<uint64_t>("ms_dispatch_shards"));
+  for (unsigned i = 0; i < num_shards; i++) {
+    auto& shard = *shards.emplace_back(std::make_unique<Shard>(this, name, i));
+    if (num_shards == 1) {
+      break;
+    }
+    PerfCountersBuilder plb(
+      cct,
+      ceph::perf_counters::key_create(
+	"msgr_dispatch_queue",
+	{{"messenger", name}, {"shard", std::to_string(i)}}),
+      l_dispatch_queue_first, l_dispatch_queue_last);
+    plb.add_u64(l_dispatch_queue_len, "queue_len",
+		"Messages waiting to be dispatched");
+    plb.add_time_avg(l_dispatch_queue_wait, "wait",
+		     "Time messages spent waiting to be dispatched");
+    shard.logger.reset(plb.create_perf_counters());
+    cct->get_perfcounters_collection()->add(shard.logger.get());
+  }
+}
+
+DispatchQueue::~DispatchQueue()
+{
+  for (auto& shard : shards) {
+    ceph_assert(shard->mqueue.empty());
+    ceph_assert(shard->marrival.empty());
+    if (shard->logger) {
+      cct->get_perfcounters_collection()->remove(shard->logger.get());
+    }
+  }
+  ceph_assert(local_messages.empty());
+}
+
+DispatchQueue::Shard& DispatchQueue::get_shard(const Connection *con) const
+{
+  if (shards.size() == 1 || !msgr->ms_can_dispatch_concurrently()) {
+    return *shards[0];
+  }
+  // connections are allocated, so the low bits of their addresses are
+  // all alike; mix them in
+  uint64_t h = reinterpret_cast<uintptr_t>(con) * 0x9e3779b97f4a7c15ull;
+  return *shards[(h >> 32) % shards.size()];
+}
+
 double DispatchQueue::get_max_age(utime_t now) const {
-  std::lock_guard l{lock};
-  if (marrival.empty())
-    return 0;
-  else
-    return (now - marrival.begin()->first);
+  double max_age = 0;
+  for (auto& shard : shards) {
+    std::lock_guard l{shard->lock};
+    if (!shard->marrival.empty()) {
+      max_age = std::max<double>(max_age,
+				 now - shard->marrival.begin()->first);
+    }
+  }
+  return max_age;
+}
+
+int DispatchQueue::get_queue_len() const
+{
+  int len = 0;
+  for (auto& shard : shards) {
+    std::lock_guard l{shard->lock};
+    len += shard->mqueue.length();
+  }
+  return len;
+}
+
+void DispatchQueue::queue_code(int code, Connection *con)
+{
+  auto& shard = get_shard(con);
+  std::lock_guard l{shard.lock};
+  if (stop)
+    return;
+  shard.mqueue.enqueue_strict(
+    0,
+    CEPH_MSG_PRIO_HIGHEST,
+    QueueItem(code, con));
+  shard.cond.notify_all();
 }
 
 uint64_t DispatchQueue::pre_dispatch(const ref_t<Message>& m)
@@ -82,18 +176,23 @@ void DispatchQueue::fast_preprocess(const ref_t<Message>& m)
 
 void DispatchQueue::enqueue(const ref_t<Message>& m, int priority, uint64_t id)
 {
-  std::lock_guard l{lock};
+  auto& shard = get_shard(m->get_connection().get());
+  std::lock_guard l{shard.lock};
   if (stop) {
     return;
   }
   ldout(cct,20) << "queue " << m << " prio " << priority << dendl;
-  add_arrival(m);
+  shard.add_arrival(m);
+  QueueItem qitem(m, shard.logger ? ceph::mono_clock::now() : ceph::mono_time{});
   if (priority >= CEPH_MSG_PRIO_LOW) {
-    mqueue.enqueue_strict(id, priority, QueueItem(m));
+    shard.mqueue.enqueue_strict(id, priority, std::move(qitem));
   } else {
-    mqueue.enqueue(id, priority, m->get_cost(), QueueItem(m));
+    shard.mqueue.enqueue(id, priority, m->get_cost(), std::move(qitem));
+  }
+  if (shard.logger) {
+    shard.logger->set(l_dispatch_queue_len, shard.mqueue.length());
   }
-  cond.notify_all();
+  shard.cond.notify_all();
 }
 
 void DispatchQueue::local_delivery(const ref_t<Message>& m, int priority)
@@ -153,14 +252,20 @@ void DispatchQueue::dispatch_throttle_release(uint64_t msize)
  * end of the queue. If the queue is empty; it's removed.
  * The message is then delivered and the process starts again.
  */
-void DispatchQueue::entry()
+void DispatchQueue::entry(Shard& shard)
 {
-  std::unique_lock l{lock};
+  std::unique_lock l{shard.lock};
   while (true) {
-    while (!mqueue.empty()) {
-      QueueItem qitem = mqueue.dequeue();
-      if (!qitem.is_code())
-	remove_arrival(qitem.get_message());
+    while (!shard.mqueue.empty()) {
+      QueueItem qitem = shard.mqueue.dequeue();
+      if (!qitem.is_code()) {
+	shard.remove_arrival(qitem.get_message());
+	if (shard.logger) {
+	  shard.logger->set(l_dispatch_queue_len, shard.mqueue.length());
+	  shard.logger->tinc(l_dispatch_queue_wait,
+			     ceph::mono_clock::now() - qitem.get_stamp());
+	}
+      }
       l.unlock();
 
       if (qitem.is_code()) {
@@ -209,34 +314,45 @@ void DispatchQueue::entry()
       break;
 
     // wait for something to be put on queue
-    cond.wait(l);
+    shard.cond.wait(l);
   }
 }
 
 void DispatchQueue::discard_queue(uint64_t id) {
-  std::lock_guard l{lock};
-  std::list<QueueItem> removed;
-  mqueue.remove_by_class(id, &removed);
-  for (auto i = removed.begin(); i != removed.end(); ++i) {
-    ceph_assert(!(i->is_code())); // We don't discard id 0, ever!
-    const ref_t<Message>& m = i->get_message();
-    remove_arrival(m);
-    dispatch_throttle_release(m->get_dispatch_throttle_size());
+  // we don't know which shard the connection hashed to
+  for (auto& shard : shards) {
+    std::lock_guard l{shard->lock};
+    std::list<QueueItem> removed;
+    shard->mqueue.remove_by_class(id, &removed);
+    for (auto i = removed.begin(); i != removed.end(); ++i) {
+      ceph_assert(!(i->is_code())); // We don't discard id 0, ever!
+      const ref_t<Message>& m = i->get_message();
+      shard->remove_arrival(m);
+      dispatch_throttle_release(m->get_dispatch_throttle_size());
+    }
   }
 }
 
 void DispatchQueue::start()
 {
   ceph_assert(!stop);
-  ceph_assert(!dispatch_thread.is_started());
-  dispatch_thread.create("ms_dispatch");
+  ceph_assert(!is_started());
+  for (unsigned i = 0; i < shards.size(); i++) {
+    std::string name = "ms_dispatch";
+    if (i) {
+      name += std::to_string(i);
+    }
+    shards[i]->dispatch_thread.create(name.c_str());
+  }
   local_delivery_thread.create("ms_local");
 }
 
 void DispatchQueue::wait()
 {
   local_delivery_thread.join();
-  dispatch_thread.join();
+  for (auto& shard : shards) {
+    shard->dispatch_thread.join();
+  }
 }
 
 void DispatchQueue::discard_local()
@@ -252,10 +368,10 @@ void DispatchQueue::shutdown()
     stop_local_delivery = true;
     local_delivery_cond.notify_all();
   }
-  // stop my dispatch thread
-  {
-    std::scoped_lock l{lock};
+  // stop my dispatch threads
+  for (auto& shard : shards) {
+    std::scoped_lock l{shard->lock};
     stop = true;
-    cond.notify_all();
+    shard->cond.notify_all();
   }
 }
@@ -17,12 +17,15 @@
 
 #include <atomic>
 #include <map>
+#include <memory>
 #include <queue>
+#include <vector>
 #include <boost/intrusive_ptr.hpp>
 #include "include/ceph_assert.h"
 #include "include/common_fwd.h"
 #include "common/Throttle.h"
 #include "common/ceph_mutex.h"
+#include "common/ceph_time.h"
 #include "common/Thread.h"
 #include "common/PrioritizedQueue.h"
 
@@ -31,19 +34,35 @@
 class Messenger;
 struct Connection;
 
+enum {
+  l_dispatch_queue_first = 96000,
+  l_dispatch_queue_len,
+  l_dispatch_queue_wait,
+  l_dispatch_queue_last,
+};
+
 /**
  * The DispatchQueue contains all the connections which have Messages
  * they want to be dispatched, carefully organized by Message priority
  * and permitted to deliver in a round-robin fashion.
  * See Messenger::dispatch_entry for details.
+ *
+ * With ms_dispatch_shards > 1 and only Dispatchers that can be called
+ * concurrently (see Dispatcher::ms_can_dispatch_concurrently()), the
+ * connections are spread over that many queues by hash, each with its
+ * own dispatch thread.  Messages of one connection are still delivered
+ * one at a time and in order.
  */
 class DispatchQueue {
   class QueueItem {
     int type;
     ConnectionRef con;
     ceph::ref_t<Message> m;
+    ceph::mono_time stamp;
   public:
-    explicit QueueItem(const ceph::ref_t<Message>& m) : type(-1), con(0), m(m) {}
+    /// stamp is only set if the shard tracks its queue wait time
+    QueueItem(const ceph::ref_t<Message>& m, ceph::mono_time stamp)
+      : type(-1), con(0), m(m), stamp(stamp) {}
     QueueItem(int type, Connection *con) : type(type), con(con), m(0) {}
     bool is_code() const {
       return type != -1;
@@ -60,48 +79,65 @@ class DispatchQueue {
       ceph_assert(is_code());
       return con.get();
     }
+    ceph::mono_time get_stamp() const {
+      return stamp;
+    }
   };
 
   CephContext *cct;
   Messenger *msgr;
-  mutable ceph::mutex lock;
-  ceph::condition_variable cond;
-
-  PrioritizedQueue<QueueItem, uint64_t> mqueue;
-
-  std::set<std::pair<double, ceph::ref_t<Message>>> marrival;
-  std::map<ceph::ref_t<Message>, decltype(marrival)::iterator> marrival_map;
-  void add_arrival(const ceph::ref_t<Message>& m) {
-    marrival_map.insert(
-      make_pair(
-	m,
-	marrival.insert(std::make_pair(m->get_recv_stamp(), m)).first
-	)
-      );
-  }
-  void remove_arrival(const ceph::ref_t<Message>& m) {
-    auto it = marrival_map.find(m);
-    ceph_assert(it != marrival_map.end());
-    marrival.erase(it->second);
-    marrival_map.erase(it);
-  }
-
-  std::atomic<uint64_t> next_id;
-
-  enum { D_CONNECT = 1, D_ACCEPT, D_BAD_REMOTE_RESET, D_BAD_RESET, D_CONN_REFUSED, D_NUM_CODES };
 
   /**
    * The DispatchThread runs dispatch_entry to empty out the dispatch_queue.
    */
+  struct Shard;
   class DispatchThread : public Thread {
     DispatchQueue *dq;
+    Shard *shard;
   public:
-    explicit DispatchThread(DispatchQueue *dq) : dq(dq) {}
+    DispatchThread(DispatchQueue *dq, Shard *shard) : dq(dq), shard(shard) {}
     void *entry() override {
-      dq->entry();
+      dq->entry(*shard);
       return 0;
     }
-  } dispatch_thread;
+  };
+
+  struct Shard {
+    mutable ceph::mutex lock;
+    ceph::condition_variable cond;
+
+    PrioritizedQueue<QueueItem, uint64_t> mqueue;
+
+    std::set<std::pair<double, ceph::ref_t<Message>>> marrival;
+    std::map<ceph::ref_t<Message>, decltype(marrival)::iterator> marrival_map;
+    void add_arrival(const ceph::ref_t<Message>& m) {
+      marrival_map.insert(
+	make_pair(
+	  m,
+	  marrival.insert(std::make_pair(m->get_recv_stamp(), m)).first
+	  )
+	);
+    }
+    void remove_arrival(const ceph::ref_t<Message>& m) {
+      auto it = marrival_map.find(m);
+      ceph_assert(it != marrival_map.end());
+      marrival.erase(it->second);
+      marrival_map.erase(it);
+    }
+
+    DispatchThread dispatch_thread;
+    std::unique_ptr<PerfCounters> logger;  ///< only if sharded
+
+    Shard(DispatchQueue *dq, const std::string& name, unsigned idx);
+  };
+  std::vector<std::unique_ptr<Shard>> shards;
+
+  Shard& get_shard(const Connection *con) const;
+  void queue_code(int code, Connection *con);
+
+  std::atomic<uint64_t> next_id;
+
+  enum { D_CONNECT = 1, D_ACCEPT, D_BAD_REMOTE_RESET, D_BAD_RESET, D_CONN_REFUSED, D_NUM_CODES };
 
   ceph::mutex local_delivery_lock;
   ceph::condition_variable local_delivery_cond;
@@ -125,7 +161,7 @@ class DispatchQueue {
   /// Throttle preventing us from building up a big backlog waiting for dispatch
   Throttle dispatch_throttler;
 
-  bool stop;
+  std::atomic<bool> stop;
   void local_delivery(const ceph::ref_t<Message>& m, int priority);
   void local_delivery(Message* m, int priority) {
     return local_delivery(ceph::ref_t<Message>(m, false), priority); /* consume ref */
@@ -134,10 +170,7 @@ class DispatchQueue {
 
   double get_max_age(utime_t now) const;
 
-  int get_queue_len() const {
-    std::lock_guard l{lock};
-    return mqueue.length();
-  }
+  int get_queue_len() const;
 
   /**
    * Release memory accounting back to the dispatch throttler.
@@ -147,54 +180,19 @@ class DispatchQueue {
   void dispatch_throttle_release(uint64_t msize);
 
   void queue_connect(Connection *con) {
-    std::lock_guard l{lock};
-    if (stop)
-      return;
-    mqueue.enqueue_strict(
-      0,
-      CEPH_MSG_PRIO_HIGHEST,
-      QueueItem(D_CONNECT, con));
-    cond.notify_all();
+    queue_code(D_CONNECT, con);
   }
   void queue_accept(Connection *con) {
-    std::lock_guard l{lock};
-    if (stop)
-      return;
-    mqueue.enqueue_strict(
-      0,
-      CEPH_MSG_PRIO_HIGHEST,
-      QueueItem(D_ACCEPT, con));
-    cond.notify_all();
+    queue_code(D_ACCEPT, con);
   }
   void queue_remote_reset(Connection *con) {
-    std::lock_guard l{lock};
-    if (stop)
-      return;
-    mqueue.enqueue_strict(
-      0,
-      CEPH_MSG_PRIO_HIGHEST,
-      QueueItem(D_BAD_REMOTE_RESET, con));
-    cond.notify_all();
+    queue_code(D_BAD_REMOTE_RESET, con);
   }
   void queue_reset(Connection *con) {
-    std::lock_guard l{lock};
-    if (stop)
-      return;
-    mqueue.enqueue_strict(
-      0,
-      CEPH_MSG_PRIO_HIGHEST,
-      QueueItem(D_BAD_RESET, con));
-    cond.notify_all();
+    queue_code(D_BAD_RESET, con);
   }
   void queue_refused(Connection *con) {
-    std::lock_guard l{lock};
-    if (stop)
-      return;
-    mqueue.enqueue_strict(
-      0,
-      CEPH_MSG_PRIO_HIGHEST,
-      QueueItem(D_CONN_REFUSED, con));
-    cond.notify_all();
+    queue_code(D_CONN_REFUSED, con);
   }
 
   bool can_fast_dispatch(const ceph::cref_t<Message> &m) const;
@@ -213,30 +211,15 @@ class DispatchQueue {
     return next_id++;
   }
   void start();
-  void entry();
+  void entry(Shard& shard);
   void wait();
   void shutdown();
-  bool is_started() const {return dispatch_thread.is_started();}
-
-  DispatchQueue(CephContext *cct, Messenger *msgr, std::string &name)
-    : cct(cct), msgr(msgr),
-      lock(ceph::make_mutex("Messenger::DispatchQueue::lock" + name)),
-      mqueue(cct->_conf->ms_pq_max_tokens_per_priority,
-	     cct->_conf->ms_pq_min_cost),
-      next_id(1),
-      dispatch_thread(this),
-      local_delivery_lock(ceph::make_mutex("Messenger::DispatchQueue::local_delivery_lock" + name)),
-      stop_local_delivery(false),
-      local_delivery_thread(this),
-      dispatch_throttler(cct, std::string("msgr_dispatch_throttler-") + name,
-                         cct->_conf->ms_dispatch_throttle_bytes),
-      stop(false)
-    {}
-  ~DispatchQueue() {
-    ceph_assert(mqueue.empty());
-    ceph_assert(marrival.empty());
-    ceph_assert(local_messages.empty());
+  bool is_started() const {
+    return shards[0]->dispatch_thread.is_started();
   }
+
+  DispatchQueue(CephContext *cct, Messenger *msgr, std::string &name);
+  ~DispatchQueue();
 };
 
 #endif
@@ -113,6 +113,16 @@ public:
     return ms_fast_preprocess(m.get());
   }
 
+  /**
+   * This function determines if ms_dispatch and the ms_handle_* callbacks
+   * may be called from several threads at once.  The Messenger only does
+   * so (see ms_dispatch_shards) if all of its Dispatchers agree.  Messages
+   * and events of a single Connection are still delivered one at a time
+   * and in order, but there are no guarantees across Connections.
+   * @returns True if the Dispatcher is safe to call concurrently.
+   */
+  virtual bool ms_can_dispatch_concurrently() const { return false; }
+
   /**
    * The Messenger calls this function to deliver a single message.
    *
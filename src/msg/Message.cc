@@ -69,6 +69,7 @@
 #include "messages/MOSDPing.h"
 #include "messages/MOSDOp.h"
 #include "messages/MOSDOpReply.h"
+#include "messages/MOSDOpBatch.h"
 #include "messages/MOSDRepOp.h"
 #include "messages/MOSDRepOpReply.h"
 #include "messages/MOSDMap.h"
@@ -536,6 +537,9 @@ Message *decode_message(CephContext *cct,
   case CEPH_MSG_OSD_OPREPLY:
     m = make_message<MOSDOpReply>();
     break;
+  case MSG_OSD_OP_BATCH:
+    m = make_message<MOSDOpBatch>();
+    break;
   case MSG_OSD_REPOP:
     m = make_message<MOSDRepOp>();
     break;
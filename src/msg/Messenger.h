@@ -103,6 +103,8 @@ private:
   };
   std::vector<PriorityDispatcher> dispatchers;
   std::vector<PriorityDispatcher> fast_dispatchers;
+  /// all dispatchers are fine with ms_dispatch being called concurrently
+  bool dispatch_concurrently = false;
 
   ZTracer::Endpoint trace_endpoint;
 
@@ -417,6 +419,8 @@ public:
     if (d->ms_can_fast_dispatch_any()) {
       insert_head(fast_dispatchers, entry);
     }
+    dispatch_concurrently = (first || dispatch_concurrently) &&
+      d->ms_can_dispatch_concurrently();
     if (first)
       ready();
   }
@@ -434,6 +438,8 @@ public:
     if (d->ms_can_fast_dispatch_any()) {
       insert_tail(fast_dispatchers, entry);
     }
+    dispatch_concurrently = (first || dispatch_concurrently) &&
+      d->ms_can_dispatch_concurrently();
     if (first)
       ready();
   }
@@ -734,6 +740,13 @@ public:
    *
    *  @param m The Message to deliver.
    */
+  /**
+   * Whether all our Dispatchers may have messages of different
+   * Connections delivered to them concurrently.
+   */
+  bool ms_can_dispatch_concurrently() const {
+    return dispatch_concurrently;
+  }
   void ms_deliver_dispatch(const ceph::ref_t<Message> &m) {
     m->set_dispatch_stamp(ceph_clock_now());
     for ([[maybe_unused]] const auto& [priority, dispatcher] : dispatchers) {
@@ -23,6 +23,10 @@
 #include "dpdk/EventDPDK.h"
 #endif
 
+#if defined(__linux__) && defined(HAVE_LIBURING)
+#include "EventUring.h"
+#endif
+
 #ifdef HAVE_EPOLL
 #include "EventEpoll.h"
 #else
@@ -120,6 +124,10 @@ int EventCenter::init(int nevent, unsigned center_id, const std::string &type)
   if (type == "dpdk") {
 #ifdef HAVE_DPDK
     driver = new DPDKDriver(cct);
+#endif
+  } else if (type == "io_uring") {
+#if defined(__linux__) && defined(HAVE_LIBURING)
+    driver = new UringDriver(cct);
 #endif
   } else {
 #ifdef HAVE_EPOLL
@@ -0,0 +1,230 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include <sys/epoll.h>
+
+#include "common/errno.h"
+#include "EventUring.h"
+
+#define dout_subsys ceph_subsys_ms
+
+#undef dout_prefix
+#define dout_prefix *_dout << "UringDriver."
+
+// user_data of poll removal requests, whose completions we don't care about
+static constexpr uint64_t CANCEL_USER_DATA = UINT64_MAX;
+// more than enough for the add/del churn of one loop iteration; get_sqe()
+// submits early if it is not
+static constexpr unsigned MAX_SQ_ENTRIES = 1024;
+
+int UringDriver::init(EventCenter *c, int nevent)
+{
+  unsigned entries = std::min<unsigned>(nevent, MAX_SQ_ENTRIES);
+  int r = io_uring_queue_init(entries, &ring, 0);
+  if (r < 0) {
+    lderr(cct) << __func__ << " unable to init io_uring: "
+	       << cpp_strerror(r) << dendl;
+    return r;
+  }
+  ring_inited = true;
+  fd_gen.resize(nevent, 0);
+  fd_mask.resize(nevent, EVENT_NONE);
+  fd_multishot.resize(nevent, false);
+  return 0;
+}
+
+struct io_uring_sqe *UringDriver::get_sqe()
+{
+  struct io_uring_sqe *sqe = io_uring_get_sqe(&ring);
+  if (!sqe) {
+    // SQ is full: flush what we have queued so far
+    int r = io_uring_submit(&ring);
+    if (r < 0) {
+      lderr(cct) << __func__ << " io_uring_submit failed: "
+		 << cpp_strerror(r) << dendl;
+      return nullptr;
+    }
+    sqe = io_uring_get_sqe(&ring);
+  }
+  return sqe;
+}
+
+int UringDriver::arm_poll(int fd, int mask)
+{
+  struct io_uring_sqe *sqe = get_sqe();
+  if (!sqe)
+    return -EBUSY;
+  unsigned events = EPOLLET;
+  if (mask & EVENT_READABLE)
+    events |= EPOLLIN;
+  if (mask & EVENT_WRITABLE)
+    events |= EPOLLOUT;
+  if (multishot) {
+    io_uring_prep_poll_multishot(sqe, fd, events);
+  } else {
+    io_uring_prep_poll_add(sqe, fd, events);
+  }
+  fd_multishot[fd] = multishot;
+  io_uring_sqe_set_data64(sqe, make_user_data(fd, ++fd_gen[fd]));
+  return 0;
+}
+
+int UringDriver::cancel_poll(int fd)
+{
+  struct io_uring_sqe *sqe = get_sqe();
+  if (!sqe)
+    return -EBUSY;
+  io_uring_prep_poll_remove(sqe, make_user_data(fd, fd_gen[fd]));
+  io_uring_sqe_set_data64(sqe, CANCEL_USER_DATA);
+  // anything still in flight for the old request is stale from now on
+  ++fd_gen[fd];
+  return 0;
+}
+
+void UringDriver::log_poll_error(int fd, int r)
+{
+  auto now = ceph::coarse_mono_clock::now();
+  if (now - last_poll_error_log < std::chrono::seconds(1)) {
+    ++poll_errors_suppressed;
+    return;
+  }
+  ldout(cct, 1) << __func__ << " poll on fd=" << fd << " failed: "
+		<< cpp_strerror(r);
+  if (poll_errors_suppressed) {
+    *_dout << " (" << poll_errors_suppressed << " more failures suppressed)";
+  }
+  *_dout << dendl;
+  last_poll_error_log = now;
+  poll_errors_suppressed = 0;
+}
+
+int UringDriver::add_event(int fd, int cur_mask, int add_mask)
+{
+  ldout(cct, 20) << __func__ << " add event fd=" << fd << " cur_mask=" << cur_mask
+		 << " add_mask=" << add_mask << dendl;
+  int mask = cur_mask | add_mask;
+  int r = 0;
+  if (cur_mask != EVENT_NONE) {
+    r = cancel_poll(fd);
+  }
+  if (r == 0) {
+    r = arm_poll(fd, mask);
+  }
+  if (r < 0) {
+    lderr(cct) << __func__ << " unable to watch fd=" << fd << ": "
+	       << cpp_strerror(r) << dendl;
+    return r;
+  }
+  fd_mask[fd] = mask;
+  return 0;
+}
+
+int UringDriver::del_event(int fd, int cur_mask, int delmask)
+{
+  ldout(cct, 20) << __func__ << " del event fd=" << fd << " cur_mask=" << cur_mask
+		 << " delmask=" << delmask << dendl;
+  int mask = cur_mask & (~delmask);
+  int r = cancel_poll(fd);
+  if (r == 0 && mask != EVENT_NONE) {
+    r = arm_poll(fd, mask);
+  }
+  if (r < 0) {
+    lderr(cct) << __func__ << " unable to modify fd=" << fd << " mask=" << mask
+	       << ": " << cpp_strerror(r) << dendl;
+    return r;
+  }
+  fd_mask[fd] = mask;
+  return 0;
+}
+
+int UringDriver::resize_events(int newsize)
+{
+  fd_gen.resize(newsize, 0);
+  fd_mask.resize(newsize, EVENT_NONE);
+  fd_multishot.resize(newsize, false);
+  return 0;
+}
+
+int UringDriver::event_wait(std::vector<FiredFileEvent> &fired_events,
+			    struct timeval *tvp)
+{
+  // submit the queued poll changes and wait in the same io_uring_enter()
+  struct io_uring_cqe *cqe = nullptr;
+  int r;
+  if (tvp) {
+    struct __kernel_timespec ts;
+    ts.tv_sec = tvp->tv_sec;
+    ts.tv_nsec = tvp->tv_usec * 1000;
+    r = io_uring_submit_and_wait_timeout(&ring, &cqe, 1, &ts, nullptr);
+  } else {
+    r = io_uring_submit_and_wait(&ring, 1);
+  }
+  if (r < 0 && r != -ETIME && r != -EINTR) {
+    lderr(cct) << __func__ << " io_uring wait failed: "
+	       << cpp_strerror(r) << dendl;
+    return r;
+  }
+
+  std::vector<int> rearm;
+  unsigned head;
+  unsigned seen = 0;
+  fired_events.clear();
+  io_uring_for_each_cqe(&ring, head, cqe) {
+    ++seen;
+    uint64_t user_data = io_uring_cqe_get_data64(cqe);
+    if (user_data == CANCEL_USER_DATA)
+      continue;
+    int fd = (int)(uint32_t)user_data;
+    uint32_t gen = user_data >> 32;
+    if ((size_t)fd >= fd_gen.size() || fd_gen[fd] != gen) {
+      // completion of a request we have replaced or removed
+      continue;
+    }
+    if (cqe->res < 0) {
+      if (cqe->res == -EINVAL && fd_multishot[fd]) {
+	// the kernel predates multishot polls
+	if (multishot) {
+	  ldout(cct, 1) << __func__ << " multishot poll unsupported, "
+			<< "falling back to single-shot polls" << dendl;
+	  multishot = false;
+	}
+	rearm.push_back(fd);
+	continue;
+      }
+      // don't re-arm a poll that would only fail again; report the fd as
+      // epoll reports EPOLLERR so its owner sees the error and closes it.
+      // add_event() or del_event() arm it anew.
+      log_poll_error(fd, cqe->res);
+      fired_events.push_back(FiredFileEvent{fd, EVENT_READABLE|EVENT_WRITABLE});
+      continue;
+    }
+    if (!(cqe->flags & IORING_CQE_F_MORE)) {
+      // a single-shot poll, or the kernel terminated the multishot one
+      // (e.g. on CQ overflow)
+      rearm.push_back(fd);
+    }
+    int mask = 0;
+    if (cqe->res & EPOLLIN) mask |= EVENT_READABLE;
+    if (cqe->res & EPOLLOUT) mask |= EVENT_WRITABLE;
+    if (cqe->res & EPOLLERR) mask |= EVENT_READABLE|EVENT_WRITABLE;
+    if (cqe->res & EPOLLHUP) mask |= EVENT_READABLE|EVENT_WRITABLE;
+    fired_events.push_back(FiredFileEvent{fd, mask});
+  }
+  io_uring_cq_advance(&ring, seen);
+
+  for (int fd : rearm) {
+    if (fd_mask[fd] != EVENT_NONE) {
+      arm_poll(fd, fd_mask[fd]);
+    }
+  }
+  return fired_events.size();
+}
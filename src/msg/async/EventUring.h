@@ -0,0 +1,69 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef CEPH_MSG_EVENTURING_H
+#define CEPH_MSG_EVENTURING_H
+
+#include <liburing.h>
+
+#include "common/ceph_time.h"
+#include "Event.h"
+
+/*
+ * UringDriver watches file descriptors with multishot IORING_OP_POLL_ADD
+ * requests (single-shot ones on kernels without multishot support)
+ * instead of an epoll set.  Registering, modifying and removing
+ * interest only queues SQEs; they are submitted together with the wait for
+ * completions in a single io_uring_enter() per event loop iteration.
+ */
+class UringDriver : public EventDriver {
+  struct io_uring ring;
+  bool ring_inited = false;
+  CephContext *cct;
+  // generation of the poll request currently armed for each fd; it is
+  // part of the request's user_data so that completions of requests we
+  // have since replaced or removed can be told apart and dropped.
+  std::vector<uint32_t> fd_gen;
+  std::vector<int> fd_mask;
+  // cleared if the kernel rejects multishot polls; we then re-arm a
+  // single-shot poll after every completion
+  bool multishot = true;
+  // whether the poll currently armed for each fd is multishot
+  std::vector<bool> fd_multishot;
+  // failed polls are logged at most once a second
+  ceph::coarse_mono_time last_poll_error_log;
+  unsigned poll_errors_suppressed = 0;
+
+  static uint64_t make_user_data(int fd, uint32_t gen) {
+    return ((uint64_t)gen << 32) | (uint32_t)fd;
+  }
+  struct io_uring_sqe *get_sqe();
+  int arm_poll(int fd, int mask);
+  int cancel_poll(int fd);
+  void log_poll_error(int fd, int r);
+
+ public:
+  explicit UringDriver(CephContext *c): cct(c) {}
+  ~UringDriver() override {
+    if (ring_inited)
+      io_uring_queue_exit(&ring);
+  }
+
+  int init(EventCenter *c, int nevent) override;
+  int add_event(int fd, int cur_mask, int add_mask) override;
+  int del_event(int fd, int cur_mask, int del_mask) override;
+  int resize_events(int newsize) override;
+  int event_wait(std::vector<FiredFileEvent> &fired_events,
+		 struct timeval *tp) override;
+};
+
+#endif
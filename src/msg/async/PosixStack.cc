@@ -21,6 +21,12 @@
 #include <errno.h>
 
 #include <algorithm>
+#include <deque>
+
+#if defined(__linux__) && defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+#include <linux/errqueue.h>
+#define HAVE_MSG_ZEROCOPY
+#endif
 
 #include "PosixStack.h"
 
@@ -42,11 +48,83 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
   int _fd;
   entity_addr_t sa;
   bool connected;
+  CephContext *cct;
+  PerfCounters *logger;
+
+#ifdef HAVE_MSG_ZEROCOPY
+  // MSG_ZEROCOPY sends; 0 if disabled or unsupported by the socket
+  uint64_t zerocopy_threshold = 0;
+  // send() calls whose buffers may be awaiting completion at once; beyond
+  // that we copy rather than pin ever more memory for a slow peer
+  uint64_t zerocopy_max_pending = 0;
+  // the kernel numbers successful MSG_ZEROCOPY sendmsg() calls from 0
+  uint32_t zerocopy_next_id = 0;
+  // sent data the kernel may still read from, with the id of the last
+  // sendmsg() call that referenced it
+  std::deque<std::pair<uint32_t, ceph::buffer::list>> zerocopy_pending;
+
+  void init_zerocopy() {
+    uint64_t threshold = cct->_conf->ms_tcp_zerocopy_threshold;
+    if (!threshold)
+      return;
+    int one = 1;
+    if (::setsockopt(_fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) < 0) {
+      int r = ceph_sock_errno();
+      ldout(cct, 1) << __func__ << " couldn't set SO_ZEROCOPY: "
+		    << cpp_strerror(r) << dendl;
+      return;
+    }
+    zerocopy_threshold = threshold;
+    zerocopy_max_pending = cct->_conf->ms_tcp_zerocopy_max_pending;
+  }
+
+  // drop the references to data the kernel has finished sending
+  void reap_zerocopy() {
+    while (!zerocopy_pending.empty()) {
+      char control[CMSG_SPACE(sizeof(struct sock_extended_err) +
+			      sizeof(struct sockaddr_in6))];
+      struct msghdr msg;
+      // FIPS zeroization audit 20191115: this memset is not security related.
+      memset(&msg, 0, sizeof(msg));
+      msg.msg_control = control;
+      msg.msg_controllen = sizeof(control);
+      if (::recvmsg(_fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+	return;
+      }
+      for (auto cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+	if (!((cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR) ||
+	      (cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR))) {
+	  continue;
+	}
+	auto serr = reinterpret_cast<struct sock_extended_err*>(CMSG_DATA(cmsg));
+	if (serr->ee_errno != 0 || serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+	  continue;
+	}
+	// [ee_info, ee_data] is the range of completed sendmsg() ids.  TCP
+	// completes them in order, so everything up to ee_data is done.
+	uint32_t last = serr->ee_data;
+	if (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+	  logger->inc(l_msgr_send_zerocopy_copied, last - serr->ee_info + 1);
+	}
+	while (!zerocopy_pending.empty() &&
+	       (int32_t)(zerocopy_pending.front().first - last) <= 0) {
+	  zerocopy_pending.pop_front();
+	}
+      }
+    }
+  }
+#endif
 
  public:
   explicit PosixConnectedSocketImpl(ceph::NetHandler &h, const entity_addr_t &sa,
-				    int f, bool connected)
-      : handler(h), _fd(f), sa(sa), connected(connected) {}
+				    int f, bool connected,
+				    CephContext *cct, PerfCounters *logger)
+      : handler(h), _fd(f), sa(sa), connected(connected),
+	cct(cct), logger(logger) {
+#ifdef HAVE_MSG_ZEROCOPY
+    init_zerocopy();
+#endif
+  }
 
   int is_connected() override {
     if (connected)
@@ -64,6 +142,10 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
   }
 
   ssize_t read(char *buf, size_t len) override {
+    #ifdef HAVE_MSG_ZEROCOPY
+    // completion notifications wake us up as EPOLLERR, i.e. readable
+    reap_zerocopy();
+    #endif
     #ifdef _WIN32
     ssize_t r = ::recv(_fd, buf, len, 0);
     #else
@@ -76,14 +158,23 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
 
   // return the sent length
   // < 0 means error occurred
+  // if zerocopy_calls is given, send with MSG_ZEROCOPY and count the
+  // sendmsg() calls that did; fall back to copying if the kernel runs out
+  // of memory for completion notifications.
   #ifndef _WIN32
-  static ssize_t do_sendmsg(int fd, struct msghdr &msg, unsigned len, bool more)
+  static ssize_t do_sendmsg(int fd, struct msghdr &msg, unsigned len, bool more,
+			    int *zerocopy_calls = nullptr)
   {
     size_t sent = 0;
+    int flags = MSG_NOSIGNAL | (more ? MSG_MORE : 0);
+    #ifdef HAVE_MSG_ZEROCOPY
+    if (zerocopy_calls)
+      flags |= MSG_ZEROCOPY;
+    #endif
     while (1) {
       MSGR_SIGPIPE_STOPPER;
       ssize_t r;
-      r = ::sendmsg(fd, &msg, MSG_NOSIGNAL | (more ? MSG_MORE : 0));
+      r = ::sendmsg(fd, &msg, flags);
       if (r < 0) {
         int err = ceph_sock_errno();
         if (err == EINTR) {
@@ -91,8 +182,19 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
         } else if (err == EAGAIN) {
           break;
         }
+        #ifdef HAVE_MSG_ZEROCOPY
+        if (err == ENOBUFS && (flags & MSG_ZEROCOPY)) {
+          // out of optmem for notifications; copy instead
+          flags &= ~MSG_ZEROCOPY;
+          continue;
+        }
+        #endif
         return -err;
       }
+      #ifdef HAVE_MSG_ZEROCOPY
+      if (flags & MSG_ZEROCOPY)
+        ++*zerocopy_calls;
+      #endif
 
       sent += r;
       if (len == sent) break;
@@ -115,6 +217,12 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
 
   ssize_t send(ceph::buffer::list &bl, bool more) override {
     size_t sent_bytes = 0;
+    #ifdef HAVE_MSG_ZEROCOPY
+    reap_zerocopy();
+    int zerocopy_calls = 0;
+    bool zerocopy = zerocopy_threshold &&
+      zerocopy_pending.size() < zerocopy_max_pending;
+    #endif
     auto pb = std::cbegin(bl.buffers());
     uint64_t left_pbrs = bl.get_num_buffers();
     while (left_pbrs) {
@@ -133,9 +241,32 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
 	msglen += pb->length();
 	++pb;
       }
+      #ifdef HAVE_MSG_ZEROCOPY
+      ssize_t r;
+      if (zerocopy_threshold && msglen >= zerocopy_threshold) {
+        int calls = 0;
+        r = do_sendmsg(_fd, msg, msglen, left_pbrs || more,
+                       zerocopy ? &calls : nullptr);
+        if (calls) {
+          zerocopy_calls += calls;
+          logger->inc(l_msgr_send_zerocopy_bytes, std::max<ssize_t>(r, 0));
+        } else if (r > 0) {
+          logger->inc(l_msgr_send_zerocopy_fallback);
+        }
+      } else {
+        r = do_sendmsg(_fd, msg, msglen, left_pbrs || more);
+      }
+      #else
       ssize_t r = do_sendmsg(_fd, msg, msglen, left_pbrs || more);
-      if (r < 0)
+      #endif
+      if (r < 0) {
+        #ifdef HAVE_MSG_ZEROCOPY
+        // the connection is about to fault; just keep our numbering in
+        // sync with the kernel's
+        zerocopy_next_id += zerocopy_calls;
+        #endif
         return r;
+      }
 
       // "r" is the remaining length
       sent_bytes += r;
@@ -150,8 +281,16 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
         bl.splice(sent_bytes, bl.length()-sent_bytes, &swapped);
         bl.swap(swapped);
       } else {
-        bl.clear();
+        swapped.swap(bl);
+      }
+      #ifdef HAVE_MSG_ZEROCOPY
+      if (zerocopy_calls) {
+        // the kernel may read from these buffers until it posts the
+        // completion for our last sendmsg() on the error queue
+        zerocopy_next_id += zerocopy_calls;
+        zerocopy_pending.emplace_back(zerocopy_next_id - 1, std::move(swapped));
       }
+      #endif
     }
 
     return static_cast<ssize_t>(sent_bytes);
@@ -262,7 +401,8 @@ int PosixServerSocketImpl::accept(ConnectedSocket *sock, const SocketOptions &op
   out->set_sockaddr((sockaddr*)&ss);
   handler.set_priority(sd, opt.priority, out->get_family());
 
-  std::unique_ptr<PosixConnectedSocketImpl> csi(new PosixConnectedSocketImpl(handler, *out, sd, true));
+  std::unique_ptr<PosixConnectedSocketImpl> csi(
+    new PosixConnectedSocketImpl(handler, *out, sd, true, w->cct, w->perf_logger));
   *sock = ConnectedSocket(std::move(csi));
   return 0;
 }
@@ -331,7 +471,9 @@ int PosixWorker::connect(const entity_addr_t &addr, const SocketOptions &opts, C
 
   net.set_priority(sd, opts.priority, addr.get_family());
   *socket = ConnectedSocket(
-      std::unique_ptr<PosixConnectedSocketImpl>(new PosixConnectedSocketImpl(net, addr, sd, !opts.nonblock)));
+      std::unique_ptr<PosixConnectedSocketImpl>(
+	new PosixConnectedSocketImpl(net, addr, sd, !opts.nonblock,
+				     cct, perf_logger)));
   return 0;
 }
 
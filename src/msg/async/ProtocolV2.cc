@@ -520,7 +520,7 @@ ProtocolV2::out_queue_entry_t ProtocolV2::_get_next_outgoing() {
   return out_entry;
 }
 
-ssize_t ProtocolV2::write_message(Message *m, bool more) {
+ssize_t ProtocolV2::write_message(Message *m, bool more, bool flush) {
   FUNCTRACE(cct);
   ceph_assert(connection->center->in_thread());
   m->set_seq(++out_seq);
@@ -559,6 +559,15 @@ ssize_t ProtocolV2::write_message(Message *m, bool more) {
                  << " src=" << entity_name_t(messenger->get_myname())
                  << " off=" << header2.data_off
                  << dendl;
+  if (!flush) {
+    // the frame stays in outgoing_bl and goes out together with the rest
+    // of the batch
+    ldout(cct, 20) << __func__ << " batched " << m << ", "
+                   << connection->outgoing_bl.length() << " bytes queued"
+                   << dendl;
+    m->put();
+    return 0;
+  }
   ssize_t total_send_size = connection->outgoing_bl.length();
   ssize_t rc = connection->_try_send(more);
   if (rc < 0) {
@@ -658,8 +667,12 @@ void ProtocolV2::write_event() {
 
     auto start = ceph::mono_clock::now();
     bool more;
+    // frames assembled since the last flush to the socket
+    uint64_t batched_msgs = 0;
+    const uint64_t max_batch_msgs = cct->_conf->ms_async_send_batch_messages;
+    const uint64_t max_batch_bytes = cct->_conf->ms_async_send_batch_bytes;
     do {
-      if (connection->is_queued()) {
+      if (batched_msgs == 0 && connection->is_queued()) {
 	if (r = connection->_try_send(); r!= 0) {
 	  // either fails to send or not all queued buffer is sent
 	  break;
@@ -690,7 +703,15 @@ void ProtocolV2::write_event() {
 				 out_entry.m->queue_start);
       }
 
-      r = write_message(out_entry.m, more);
+      // keep assembling frames while more messages are queued, so that
+      // a burst of small messages goes out in one send
+      const bool flush = !more ||
+        ++batched_msgs >= max_batch_msgs ||
+        connection->outgoing_bl.length() >= max_batch_bytes;
+      r = write_message(out_entry.m, more, flush);
+      if (flush) {
+        batched_msgs = 0;
+      }
 
       connection->write_lock.lock();
       if (r == 0) {
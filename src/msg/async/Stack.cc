@@ -67,6 +67,11 @@ std::shared_ptr<NetworkStack> NetworkStack::create(CephContext *c,
 
   if (t == "posix")
     stack.reset(new PosixNetworkStack(c));
+#if defined(__linux__) && defined(HAVE_LIBURING)
+  else if (t == "io_uring")
+    // posix sockets, polled through io_uring by the workers' EventCenters
+    stack.reset(new PosixNetworkStack(c));
+#endif
 #ifdef HAVE_RDMA
   else if (t == "rdma")
     stack.reset(new RDMAStack(c));
@@ -38,7 +38,12 @@ using key_t = std::array<std::uint8_t, AESGCM_KEY_LEN>;
 class AES128GCM_OnWireTxHandler : public ceph::crypto::onwire::TxHandler {
   CephContext* const cct;
   std::unique_ptr<EVP_CIPHER_CTX, decltype(&::EVP_CIPHER_CTX_free)> ectx;
-  ceph::bufferlist buffer;
+  // Ciphertext of consecutive rounds is carved out of one buffer so that
+  // a frame's (or several small frames') rounds share an allocation and
+  // go out as adjacent iovecs.  [round_start, round_end) is the window
+  // of the current round, round_off is where its next update goes.
+  ceph::bufferptr buffer;
+  uint32_t round_start = 0, round_off = 0, round_end = 0;
   nonce_t nonce, initial_nonce;
   bool used_initial_nonce;
   bool new_nonce_format;  // 64-bit counter?
@@ -72,12 +77,23 @@ public:
     ::TOPNSPC::crypto::zeroize_for_security(&initial_nonce, sizeof(initial_nonce));
   }
 
+  void reserve_tx_buffer(uint32_t len) override;
   void reset_tx_handler(const uint32_t* first, const uint32_t* last) override;
 
   void authenticated_encrypt_update(const ceph::bufferlist& plaintext) override;
   ceph::bufferlist authenticated_encrypt_final() override;
 };
 
+void AES128GCM_OnWireTxHandler::reserve_tx_buffer(uint32_t len)
+{
+  if (buffer.length() - round_end < len) {
+    // small frames are common; let a few of them share a page
+    buffer = ceph::buffer::create_small_page_aligned(
+      std::max<uint32_t>(len, CEPH_PAGE_SIZE));
+    round_start = round_off = round_end = 0;
+  }
+}
+
 void AES128GCM_OnWireTxHandler::reset_tx_handler(const uint32_t* first,
                                                  const uint32_t* last)
 {
@@ -93,8 +109,11 @@ void AES128GCM_OnWireTxHandler::reset_tx_handler(const uint32_t* first,
     throw std::runtime_error("EVP_EncryptInit_ex failed");
   }
 
-  ceph_assert(buffer.get_append_buffer_unused_tail_length() == 0);
-  buffer.reserve(std::accumulate(first, last, AESGCM_TAG_LEN));
+  ceph_assert(round_off == round_end);
+  const uint32_t round_len = std::accumulate(first, last, AESGCM_TAG_LEN);
+  reserve_tx_buffer(round_len);
+  round_start = round_off = round_end;
+  round_end = round_start + round_len;
 
   if (!new_nonce_format) {
     // msgr2.0: 32-bit counter followed by 64-bit fixed field,
@@ -108,15 +127,13 @@ void AES128GCM_OnWireTxHandler::reset_tx_handler(const uint32_t* first,
 void AES128GCM_OnWireTxHandler::authenticated_encrypt_update(
   const ceph::bufferlist& plaintext)
 {
-  ceph_assert(buffer.get_append_buffer_unused_tail_length() >=
-              plaintext.length());
-  auto filler = buffer.append_hole(plaintext.length());
+  ceph_assert(round_end - round_off >= plaintext.length() + AESGCM_TAG_LEN);
 
   for (const auto& plainbuf : plaintext.buffers()) {
     int update_len = 0;
 
     if(1 != EVP_EncryptUpdate(ectx.get(),
-	reinterpret_cast<unsigned char*>(filler.c_str()),
+	reinterpret_cast<unsigned char*>(buffer.c_str() + round_off),
 	&update_len,
 	reinterpret_cast<const unsigned char*>(plainbuf.c_str()),
 	plainbuf.length())) {
@@ -124,23 +141,22 @@ void AES128GCM_OnWireTxHandler::authenticated_encrypt_update(
     }
     ceph_assert_always(update_len >= 0);
     ceph_assert(static_cast<unsigned>(update_len) == plainbuf.length());
-    filler.advance(update_len);
+    round_off += update_len;
   }
 
   ldout(cct, 15) << __func__
 		 << " plaintext.length()=" << plaintext.length()
-		 << " buffer.length()=" << buffer.length()
+		 << " buffer.length()=" << round_off - round_start
 		 << dendl;
 }
 
 ceph::bufferlist AES128GCM_OnWireTxHandler::authenticated_encrypt_final()
 {
   int final_len = 0;
-  ceph_assert(buffer.get_append_buffer_unused_tail_length() ==
-              AESGCM_BLOCK_LEN);
-  auto filler = buffer.append_hole(AESGCM_BLOCK_LEN);
+  ceph_assert(round_end - round_off == AESGCM_BLOCK_LEN);
+  auto tag = buffer.c_str() + round_off;
   if(1 != EVP_EncryptFinal_ex(ectx.get(),
-	reinterpret_cast<unsigned char*>(filler.c_str()),
+	reinterpret_cast<unsigned char*>(tag),
 	&final_len)) {
     throw std::runtime_error("EVP_EncryptFinal_ex failed");
   }
@@ -149,15 +165,23 @@ ceph::bufferlist AES128GCM_OnWireTxHandler::authenticated_encrypt_final()
   static_assert(AESGCM_BLOCK_LEN == AESGCM_TAG_LEN);
   if(1 != EVP_CIPHER_CTX_ctrl(ectx.get(),
 	EVP_CTRL_GCM_GET_TAG, AESGCM_TAG_LEN,
-	filler.c_str())) {
+	tag)) {
     throw std::runtime_error("EVP_CIPHER_CTX_ctrl failed");
   }
+  round_off = round_end;
 
   ldout(cct, 15) << __func__
-		 << " buffer.length()=" << buffer.length()
+		 << " buffer.length()=" << round_end - round_start
 		 << " final_len=" << final_len
 		 << dendl;
-  return std::move(buffer);
+  ceph::bufferlist ciphertext;
+  ciphertext.append(buffer, round_start, round_end - round_start);
+  if (round_end == buffer.length()) {
+    // don't pin a fully used (possibly large) buffer while idle
+    buffer = ceph::bufferptr();
+    round_start = round_off = round_end = 0;
+  }
+  return ciphertext;
 }
 
 // RX PART
@@ -68,6 +68,11 @@ struct TxHandler {
   virtual void reset_tx_handler(const uint32_t* first,
                                 const uint32_t* last) = 0;
 
+  // Optional hint that the following reset-update-final rounds are going
+  // to produce about len bytes of output, so that an implementation can
+  // serve them from a single allocation.
+  virtual void reserve_tx_buffer(uint32_t len) {}
+
   void reset_tx_handler(std::initializer_list<uint32_t> update_size_sequence) {
     if (update_size_sequence.size() > 0) {
       const uint32_t* first = &*update_size_sequence.begin();
@@ -260,6 +260,8 @@ bufferlist FrameAssembler::assemble_frame(Tag tag, bufferlist segment_bls[],
         segment_bls[i].append_zero(pad_len);
       }
     }
+    // all encryption rounds of the frame are served from one buffer
+    m_crypto->tx->reserve_tx_buffer(get_frame_onwire_len());
     if (m_is_rev1) {
       return asm_secure_rev1(preamble, segment_bls);
     }
@@ -656,7 +656,10 @@ public:
     Transaction *t;
 
     uint64_t ops;
-    char* op_buffer_p;
+    // op_bl is walked in place; an Op is only copied (to op_scratch)
+    // when it straddles two segments
+    ceph::buffer::list::const_iterator op_bl_p;
+    Op op_scratch;
 
     ceph::buffer::list::const_iterator data_bl_p;
 
@@ -667,12 +670,12 @@ public:
   private:
     explicit iterator(Transaction *t)
       : t(t),
+	  op_bl_p(t->op_bl.cbegin()),
 	  data_bl_p(t->data_bl.cbegin()),
         colls(t->coll_index.size()),
         objects(t->object_index.size()) {
 
       ops = t->data.ops;
-      op_buffer_p = t->op_bl.c_str();
 
       std::map<coll_t, uint32_t>::iterator coll_index_p;
       for (coll_index_p = t->coll_index.begin();
@@ -699,8 +702,9 @@ public:
     Op* decode_op() {
       ceph_assert(ops > 0);
 
-      Op* op = reinterpret_cast<Op*>(op_buffer_p);
-      op_buffer_p += sizeof(Op);
+      auto view = op_bl_p.get_contiguous_view(
+	sizeof(Op), reinterpret_cast<char*>(&op_scratch));
+      Op* op = reinterpret_cast<Op*>(const_cast<char*>(view.data()));
       ops--;
 
       return op;
@@ -5298,6 +5298,9 @@ void *BlueStore::MempoolThread::entry()
   if (store->cache_autotune && binned_kv_cache != nullptr) {
     pcm = std::make_shared<PriorityCache::Manager>(
         store->cct, min, max, target, true, "bluestore-pricache");
+    pcm->set_cgroup_limit_ratio(store->osd_memory_cache_cgroup_aware ?
+      store->cct->_conf.get_val<double>("osd_memory_target_cgroup_limit_ratio") : 0);
+    pcm->set_pressure_threshold(store->osd_memory_cache_pressure_threshold);
     pcm->insert("kv", binned_kv_cache, true);
     pcm->insert("meta", meta_cache, true);
     pcm->insert("data", data_cache, true);
@@ -5375,8 +5378,12 @@ void *BlueStore::MempoolThread::entry()
     }
     // memory resizing (ie autotuning)
     if (resize_interval > 0 && next_resize < ceph_clock_now()) {
-      if (ceph_using_tcmalloc() && pcm != nullptr) {
-        pcm->tune_memory();
+      if (ceph_using_tcmalloc() && pcm != nullptr && pcm->tune_memory()) {
+        // under memory pressure: hand the smaller budget out right away
+        pcm->balance();
+        next_balance = ceph_clock_now();
+        next_balance += autotune_interval;
+        interval_stats_trim = true;
       }
       next_resize = ceph_clock_now();
       next_resize += resize_interval;
@@ -5496,6 +5503,9 @@ void BlueStore::MempoolThread::_update_cache_settings()
   pcm->set_target_memory(target);
   pcm->set_min_memory(min);
   pcm->set_max_memory(max);
+  pcm->set_cgroup_limit_ratio(store->osd_memory_cache_cgroup_aware ?
+    store->cct->_conf.get_val<double>("osd_memory_target_cgroup_limit_ratio") : 0);
+  pcm->set_pressure_threshold(store->osd_memory_cache_pressure_threshold);
 
   dout(5) << __func__  << " updated pcm target: " << target
                 << " pcm min: " << min
@@ -5692,7 +5702,8 @@ BlueStore::BlueStore(CephContext *cct,
   uint64_t _min_alloc_size)
   : ObjectStore(cct, path),
     throttle(cct),
-    finisher(cct, "commit_finisher", "cfin"),
+    finisher(cct, "commit_finisher", "cfin",
+	     cct->_conf.get_val<uint64_t>("bluestore_finisher_threads")),
     kv_sync_thread(this),
     kv_finalize_thread(this),
     min_alloc_size(_min_alloc_size),
@@ -5757,6 +5768,8 @@ const char **BlueStore::get_tracked_conf_keys() const
     "osd_memory_base",
     "osd_memory_cache_min",
     "osd_memory_expected_fragmentation",
+    "osd_memory_cache_cgroup_aware",
+    "osd_memory_cache_pressure_threshold",
     "bluestore_cache_autotune",
     "bluestore_cache_autotune_interval",
     "bluestore_cache_age_bin_interval",
@@ -5835,7 +5848,10 @@ void BlueStore::handle_conf_change(const ConfigProxy& conf,
   if (changed.count("osd_memory_target") ||
       changed.count("osd_memory_base") ||
       changed.count("osd_memory_cache_min") ||
-      changed.count("osd_memory_expected_fragmentation")) {
+      changed.count("osd_memory_expected_fragmentation") ||
+      changed.count("osd_memory_target_cgroup_limit_ratio") ||
+      changed.count("osd_memory_cache_cgroup_aware") ||
+      changed.count("osd_memory_cache_pressure_threshold")) {
     _update_osd_memory_options();
   }
 }
@@ -5948,6 +5964,10 @@ void BlueStore::_update_osd_memory_options()
   osd_memory_base = cct->_conf.get_val<Option::size_t>("osd_memory_base");
   osd_memory_expected_fragmentation = cct->_conf.get_val<double>("osd_memory_expected_fragmentation");
   osd_memory_cache_min = cct->_conf.get_val<Option::size_t>("osd_memory_cache_min");
+  osd_memory_cache_cgroup_aware =
+      cct->_conf.get_val<bool>("osd_memory_cache_cgroup_aware");
+  osd_memory_cache_pressure_threshold =
+      cct->_conf.get_val<double>("osd_memory_cache_pressure_threshold");
   config_changed++;
   dout(10) << __func__
            << " osd_memory_target " << osd_memory_target
@@ -5986,6 +6006,10 @@ int BlueStore::_set_cache_sizes()
   osd_memory_cache_min = cct->_conf.get_val<Option::size_t>("osd_memory_cache_min");
   osd_memory_cache_resize_interval = 
       cct->_conf.get_val<double>("osd_memory_cache_resize_interval");
+  osd_memory_cache_cgroup_aware =
+      cct->_conf.get_val<bool>("osd_memory_cache_cgroup_aware");
+  osd_memory_cache_pressure_threshold =
+      cct->_conf.get_val<double>("osd_memory_cache_pressure_threshold");
 
   if (cct->_conf->bluestore_cache_size) {
     cache_size = cct->_conf->bluestore_cache_size;
@@ -14366,7 +14390,8 @@ void BlueStore::_txc_committed_kv(TransContext *txc)
     if (txc->ch->commit_queue) {
       txc->ch->commit_queue->queue(txc->oncommits);
     } else {
-      finisher.queue(txc->oncommits);
+      finisher.queue(reinterpret_cast<uintptr_t>(txc->osr.get()),
+		     txc->oncommits);
     }
   }
   throttle.log_state_latency(*txc, logger, l_bluestore_state_kv_committing_lat);
@@ -15221,7 +15246,7 @@ void BlueStore::_deferred_aio_finish(OpSequencer *osr)
       osr->deferred_lock.unlock();
       if (deferred_aggressive) {
 	dout(20) << __func__ << " queuing async deferred_try_submit" << dendl;
-	finisher.queue(new C_DeferredTrySubmit(this));
+	finisher.queue(0, new C_DeferredTrySubmit(this));
       } else {
 	dout(20) << __func__ << " leaving queued, more pending" << dendl;
       }
@@ -15477,7 +15502,7 @@ int BlueStore::queue_transactions(
     if (c->commit_queue) {
       c->commit_queue->queue(on_applied);
     } else {
-      finisher.queue(on_applied);
+      finisher.queue(reinterpret_cast<uintptr_t>(txc->osr.get()), on_applied);
     }
   }
 
@@ -80,6 +80,7 @@
 #include "messages/MOSDFull.h"
 #include "messages/MOSDOp.h"
 #include "messages/MOSDOpReply.h"
+#include "messages/MOSDOpBatch.h"
 #include "messages/MOSDBeacon.h"
 #include "messages/MOSDBoot.h"
 #include "messages/MOSDPGTemp.h"
@@ -2418,6 +2419,8 @@ OSD::OSD(CephContext *cct_,
                                            cct->_conf->osd_op_history_duration);
   op_tracker.set_history_slow_op_size_and_threshold(cct->_conf->osd_op_history_slow_op_size,
                                                     cct->_conf->osd_op_history_slow_op_threshold);
+  op_tracker.set_sampling(cct->_conf->osd_op_history_sample_rate,
+                          cct->_conf->osd_op_history_sample_threshold);
   ObjectCleanRegions::set_max_num_intervals(cct->_conf->osd_object_clean_region_max_num_intervals);
 #ifdef WITH_BLKIN
   std::stringstream ss;
@@ -7581,6 +7584,9 @@ void OSD::ms_fast_dispatch(Message *m)
   case MSG_OSD_FORCE_RECOVERY:
     handle_fast_force_recovery(static_cast<MOSDForceRecovery*>(m));
     return;
+  case MSG_OSD_OP_BATCH:
+    handle_fast_op_batch(static_cast<MOSDOpBatch*>(m));
+    return;
   case MSG_OSD_SCRUB2:
     handle_fast_scrub(static_cast<MOSDScrub2*>(m));
     return;
@@ -9478,6 +9484,18 @@ void OSD::handle_fast_force_recovery(MOSDForceRecovery *m)
   m->put();
 }
 
+void OSD::handle_fast_op_batch(MOSDOpBatch *m)
+{
+  dout(15) << __func__ << " " << m->get_num_ops() << " ops from "
+	   << m->get_source() << dendl;
+  // dispatch each op as if it had arrived on its own, in order
+  auto ops = m->split(cct);
+  m->put();
+  for (auto& op : ops) {
+    ms_fast_dispatch(op.detach());
+  }
+}
+
 void OSD::handle_pg_query_nopg(const MQuery& q)
 {
   spg_t pgid = q.pgid;
@@ -9917,6 +9935,8 @@ const char** OSD::get_tracked_conf_keys() const
     "osd_op_history_duration",
     "osd_op_history_slow_op_size",
     "osd_op_history_slow_op_threshold",
+    "osd_op_history_sample_rate",
+    "osd_op_history_sample_threshold",
     "osd_enable_op_tracker",
     "osd_map_cache_size",
     "osd_pg_epoch_max_lag_factor",
@@ -10019,6 +10039,11 @@ void OSD::handle_conf_change(const ConfigProxy& conf,
     op_tracker.set_history_slow_op_size_and_threshold(cct->_conf->osd_op_history_slow_op_size,
                                                       cct->_conf->osd_op_history_slow_op_threshold);
   }
+  if (changed.count("osd_op_history_sample_rate") ||
+      changed.count("osd_op_history_sample_threshold")) {
+    op_tracker.set_sampling(cct->_conf->osd_op_history_sample_rate,
+                            cct->_conf->osd_op_history_sample_threshold);
+  }
   if (changed.count("osd_enable_op_tracker")) {
       op_tracker.set_tracking(cct->_conf->osd_enable_op_tracker);
   }
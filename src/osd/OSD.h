@@ -92,6 +92,7 @@ class MOSDPGNotify;
 class MOSDPGInfo;
 class MOSDPGRemove;
 class MOSDForceRecovery;
+class MOSDOpBatch;
 class MMonGetPurgedSnapsReply;
 
 class OSD;
@@ -1887,6 +1888,7 @@ public:
 protected:
 
   void handle_fast_force_recovery(MOSDForceRecovery *m);
+  void handle_fast_op_batch(MOSDOpBatch *m);
 
   // -- commands --
   void handle_command(class MCommand *m);
@@ -1912,6 +1914,7 @@ private:
     switch (m->get_type()) {
     case CEPH_MSG_PING:
     case CEPH_MSG_OSD_OP:
+    case MSG_OSD_OP_BATCH:
     case CEPH_MSG_OSD_BACKOFF:
     case MSG_OSD_SCRUB2:
     case MSG_OSD_FORCE_RECOVERY:
@@ -19,6 +19,7 @@
 #include <bit>
 #include <optional>
 #include <random>
+#include <thread>
 #include <fmt/format.h>
 
 #include <boost/algorithm/string.hpp>
@@ -1542,11 +1543,18 @@ void OSDMap::get_blocklist(std::set<entity_addr_t> *bl,
   }
 }
 
+void OSDMap::_update_osd_weight_gen()
+{
+  static std::atomic<uint64_t> last_gen = 0;
+  osd_weight_gen = ++last_gen;
+}
+
 void OSDMap::set_max_osd(int m)
 {
   max_osd = m;
   osd_state.resize(max_osd, 0);
   osd_weight.resize(max_osd, CEPH_OSD_OUT);
+  _update_osd_weight_gen();
   osd_info.resize(max_osd);
   osd_xinfo.resize(max_osd);
   osd_addrs->client_addrs.resize(max_osd);
@@ -2684,7 +2692,8 @@ void OSDMap::_pg_to_raw_osds(
   // what crush rule?
   int ruleno = pool.get_crush_rule();
   if (ruleno >= 0)
-    crush->do_rule(ruleno, pps, *osds, size, osd_weight, pg.pool());
+    crush->do_rule_cached(ruleno, pps, *osds, size, osd_weight, pg.pool(),
+			  osd_weight_gen);
 
   _remove_nonexistent_osds(pool, *osds);
 
@@ -3468,6 +3477,7 @@ void OSDMap::decode_classic(ceph::buffer::list::const_iterator& p)
     }
   }
   decode(osd_weight, p);
+  _update_osd_weight_gen();
   decode(osd_addrs->client_addrs, p);
   if (v <= 5) {
     pg_temp->clear();
@@ -3578,6 +3588,7 @@ void OSDMap::decode(ceph::buffer::list::const_iterator& bl)
       }
     }
     decode(osd_weight, bl);
+    _update_osd_weight_gen();
     decode(osd_addrs->client_addrs, bl);
 
     decode(*pg_temp, bl);
@@ -5614,7 +5625,7 @@ int OSDMap::calc_pg_upmaps(
 
     set<pg_t> to_unmap;
     map<pg_t, mempool::osdmap::vector<pair<int32_t,int32_t>>> to_upmap;
-    auto temp_pgs_by_osd = pgs_by_osd;
+    pgs_by_osd_overlay_t temp_pgs_by_osd(pgs_by_osd);
     // always start with fullest, break if we find any changes to make
     for (auto p = deviation_osd.rbegin(); p != deviation_osd.rend(); ++p) {
       if (skip_overfull && !underfull.empty()) {
@@ -5787,14 +5798,14 @@ int OSDMap::calc_pg_upmaps(
 
     // test change, apply if change is good
     ceph_assert(to_unmap.size() || to_upmap.size());
-    float new_stddev = 0;
-    map<int,float> temp_osd_deviation;
-    multimap<float,int> temp_deviation_osd;
-    float cur_max_deviation = calc_deviations(cct, temp_pgs_by_osd, osd_weight,
-    					      pgs_per_weight, temp_osd_deviation,
-					      temp_deviation_osd, new_stddev);
+    // only the osds touched by this change contribute to the difference
+    float stddev_delta = calc_deviations_delta(cct,
+					       temp_pgs_by_osd.get_changed(),
+					       osd_weight, pgs_per_weight,
+					       osd_deviation);
+    float new_stddev = stddev + stddev_delta;
     ldout(cct, 10) << " stddev " << stddev << " -> " << new_stddev << dendl;
-    if (new_stddev >= stddev) {
+    if (stddev_delta >= 0) {
       if (!aggressive) {
         ldout(cct, 10) << " break because stddev is not decreasing"
                        << " and aggressive mode is not enabled"
@@ -5823,11 +5834,14 @@ int OSDMap::calc_pg_upmaps(
     }
 
     // ready to go
-    ceph_assert(new_stddev < stddev);
+    ceph_assert(stddev_delta < 0);
     stddev = new_stddev;
-    pgs_by_osd = temp_pgs_by_osd;
-    osd_deviation = temp_osd_deviation;
-    deviation_osd = temp_deviation_osd;
+    float cur_max_deviation = apply_deviations_delta(
+      temp_pgs_by_osd.get_changed(), osd_weight, pgs_per_weight,
+      osd_deviation, deviation_osd);
+    for (auto& [oid, opgs] : temp_pgs_by_osd.get_changed()) {
+      pgs_by_osd[oid] = std::move(opgs);
+    }
     n_changes++;
 
 
@@ -5930,13 +5944,40 @@ float OSDMap::build_pool_pgs_info (
   // and returns the osd_weight_total
   //
   float osds_weight_total = 0.0;
+  auto max_threads =
+    cct->_conf.get_val<uint64_t>("osd_calc_pg_upmaps_mapping_threads");
   for (auto& [pid, pdata] : pools) {
     if (!only_pools.empty() && !only_pools.count(pid))
       continue;
-    for (unsigned ps = 0; ps < pdata.get_pg_num(); ++ps) {
+    // the mapping is const and independent per pg; for big pools spread it
+    // over a few threads and only merge the results serially.
+    unsigned pg_num = pdata.get_pg_num();
+    vector<vector<int>> ups(pg_num);
+    unsigned num_threads = std::clamp<uint64_t>(
+      pg_num / PG_UPMAPS_MIN_PGS_PER_THREAD, 1, std::max<uint64_t>(max_threads, 1));
+    auto map_range = [&](unsigned begin, unsigned end) {
+      for (unsigned ps = begin; ps < end; ++ps) {
+	tmp_osd_map.pg_to_up_acting_osds(pg_t(ps, pid), &ups[ps],
+					 nullptr, nullptr, nullptr);
+      }
+    };
+    if (num_threads > 1) {
+      vector<std::thread> workers;
+      unsigned per_thread = (pg_num + num_threads - 1) / num_threads;
+      for (unsigned begin = per_thread; begin < pg_num; begin += per_thread) {
+	workers.emplace_back(map_range, begin,
+			     std::min(begin + per_thread, pg_num));
+      }
+      map_range(0, per_thread);
+      for (auto& t : workers) {
+	t.join();
+      }
+    } else {
+      map_range(0, pg_num);
+    }
+    for (unsigned ps = 0; ps < pg_num; ++ps) {
       pg_t pg(ps, pid);
-      vector<int> up;
-      tmp_osd_map.pg_to_up_acting_osds(pg, &up, nullptr, nullptr, nullptr);
+      auto& up = ups[ps];
       ldout(cct, 20) << __func__ << " " << pg << " up " << up << dendl;
       for (auto osd : up) {
         if (osd != CRUSH_ITEM_NONE)
@@ -6000,6 +6041,62 @@ float OSDMap::calc_deviations (
   return cur_max_deviation;
 }
 
+float OSDMap::calc_deviations_delta (
+  CephContext *cct,
+  const map<int,set<pg_t>>& changed_pgs_by_osd,
+  const map<int,float>& osd_weight,
+  float pgs_per_weight,
+  const map<int,float>& osd_deviation)
+{
+  //
+  // Incremental counterpart of calc_deviations: returns how much the
+  // (squared) stddev changes if the osds in changed_pgs_by_osd take on the
+  // given PG sets, leaving every other osd's deviation as it is.
+  //
+  float delta = 0.0;
+  for (auto& [oid, opgs] : changed_pgs_by_osd) {
+    ceph_assert(osd_weight.count(oid));
+    float target = osd_weight.at(oid) * pgs_per_weight;
+    float deviation = (float)opgs.size() - target;
+    auto p = osd_deviation.find(oid);
+    float old_deviation = p != osd_deviation.end() ? p->second : -target;
+    ldout(cct, 20) << " osd." << oid
+                   << "\tpgs " << opgs.size()
+                   << "\ttarget " << target
+                   << "\tdeviation " << old_deviation << " -> " << deviation
+                   << dendl;
+    delta += deviation * deviation - old_deviation * old_deviation;
+  }
+  return delta;
+}
+
+float OSDMap::apply_deviations_delta (
+  const map<int,set<pg_t>>& changed_pgs_by_osd,
+  const map<int,float>& osd_weight,
+  float pgs_per_weight,
+  map<int,float>& osd_deviation,
+  multimap<float,int>& deviation_osd)
+{
+  //
+  // Update osd_deviation for the osds touched by an accepted change and
+  // rebuild deviation_osd from it.  The rebuild is O(osds) and keeps
+  // equal deviations ordered by osd id, as calc_deviations does, so the
+  // search order of the next iteration is not affected.
+  //
+  for (auto& [oid, opgs] : changed_pgs_by_osd) {
+    float target = osd_weight.at(oid) * pgs_per_weight;
+    osd_deviation[oid] = (float)opgs.size() - target;
+  }
+  deviation_osd.clear();
+  for (auto& [oid, deviation] : osd_deviation) {
+    deviation_osd.emplace(deviation, oid);
+  }
+  if (deviation_osd.empty())
+    return 0.0;
+  return std::max(fabsf(deviation_osd.begin()->first),
+                  fabsf(deviation_osd.rbegin()->first));
+}
+
 void OSDMap::fill_overfull_underfull (
   CephContext *cct,
   const std::multimap<float,int>& deviation_osd,
@@ -6105,7 +6202,7 @@ bool OSDMap::try_drop_remap_overfull(
   const std::vector<pg_t>& pgs,
   const OSDMap& tmp_osd_map,
   int osd,
-  map<int,std::set<pg_t>>& temp_pgs_by_osd,
+  pgs_by_osd_overlay_t& temp_pgs_by_osd,
   set<pg_t>& to_unmap,
   map<pg_t, mempool::osdmap::vector<pair<int32_t,int32_t>>>& to_upmap)
 {
@@ -6162,7 +6259,7 @@ bool OSDMap::try_drop_remap_underfull(
     CephContext *cct,
     const candidates_t& candidates,
     int osd,
-    map<int,std::set<pg_t>>& temp_pgs_by_osd,
+    pgs_by_osd_overlay_t& temp_pgs_by_osd,
     set<pg_t>& to_unmap,
     map<pg_t, mempool::osdmap::vector<std::pair<int32_t,int32_t>>>& to_upmap)
 {
@@ -6221,7 +6318,7 @@ void OSDMap::add_remap_pair(
   size_t pg_pool_size,
   int osd,
   set<int>& existing,
-  map<int,set<pg_t>>& temp_pgs_by_osd,
+  pgs_by_osd_overlay_t& temp_pgs_by_osd,
   mempool::osdmap::vector<pair<int32_t,int32_t>> new_upmap_items,
   map<pg_t, mempool::osdmap::vector<pair<int32_t,int32_t>>>& to_upmap) 
 {
@@ -584,6 +584,10 @@ private:
   entity_addrvec_t _blank_addrvec;
 
   mempool::osdmap::vector<__u32>   osd_weight;   // 16.16 fixed point, 0x10000 = "in", 0 = "out"
+  /// process-unique tag for the current osd_weight contents; keys the
+  /// crush result cache (see CrushWrapper::do_rule_cached)
+  uint64_t osd_weight_gen = 0;
+  void _update_osd_weight_gen();
   mempool::osdmap::vector<osd_info_t> osd_info;
   std::shared_ptr<PGTempMap> pg_temp;  // temp pg mapping (e.g. while we rebuild)
   std::shared_ptr< mempool::osdmap::map<pg_t,int32_t > > primary_temp;  // temp primary mapping (e.g. while we rebuild)
@@ -822,6 +826,7 @@ public:
   void set_weight(int o, unsigned w) {
     ceph_assert(o < max_osd);
     osd_weight[o] = w;
+    _update_osd_weight_gen();
     if (w)
       osd_state[o] |= CEPH_OSD_EXISTS;
   }
@@ -1534,6 +1539,35 @@ public:
 
 private: // Bunch of internal functions used only by calc_pg_upmaps (result of code refactoring)
 
+  /// don't bother with mapping threads for fewer pgs than this (each)
+  static constexpr unsigned PG_UPMAPS_MIN_PGS_PER_THREAD = 1024;
+
+  /**
+   * pgs_by_osd overlay for a single candidate change
+   *
+   * The per-osd PG sets touched by a candidate are copied on first
+   * access, so evaluating a candidate costs O(touched osds) instead of a
+   * copy of the whole pgs_by_osd map.
+   */
+  class pgs_by_osd_overlay_t {
+    const std::map<int,std::set<pg_t>>& base;
+    std::map<int,std::set<pg_t>> changed;
+  public:
+    explicit pgs_by_osd_overlay_t(const std::map<int,std::set<pg_t>>& base)
+      : base(base) {}
+    std::set<pg_t>& operator[](int osd) {
+      auto p = changed.find(osd);
+      if (p == changed.end()) {
+	auto q = base.find(osd);
+	p = changed.emplace(osd, q == base.end() ? std::set<pg_t>() : q->second).first;
+      }
+      return p->second;
+    }
+    std::map<int,std::set<pg_t>>& get_changed() {
+      return changed;
+    }
+  };
+
   float get_osds_weight(
     CephContext *cct,
     const OSDMap& tmp_osd_map,
@@ -1560,6 +1594,22 @@ private: // Bunch of internal functions used only by calc_pg_upmaps (result of c
     float& stddev
   );  // return current max deviation
 
+  float calc_deviations_delta (
+    CephContext *cct,
+    const std::map<int,std::set<pg_t>>& changed_pgs_by_osd,
+    const std::map<int,float>& osd_weight,
+    float pgs_per_weight,
+    const std::map<int,float>& osd_deviation
+  );  // return change in (squared) stddev
+
+  float apply_deviations_delta (
+    const std::map<int,std::set<pg_t>>& changed_pgs_by_osd,
+    const std::map<int,float>& osd_weight,
+    float pgs_per_weight,
+    std::map<int,float>& osd_deviation,
+    std::multimap<float,int>& deviation_osd
+  );  // return new max deviation
+
   void fill_overfull_underfull (
     CephContext *cct,
     const std::multimap<float,int>& deviation_osd,
@@ -1588,7 +1638,7 @@ private: // Bunch of internal functions used only by calc_pg_upmaps (result of c
     const std::vector<pg_t>& pgs,
     const OSDMap& tmp_osd_map,
     int osd,
-    std::map<int,std::set<pg_t>>& temp_pgs_by_osd,
+    pgs_by_osd_overlay_t& temp_pgs_by_osd,
     std::set<pg_t>& to_unmap,
     std::map<pg_t, mempool::osdmap::vector<std::pair<int32_t,int32_t>>>& to_upmap
   );
@@ -1600,7 +1650,7 @@ bool try_drop_remap_underfull(
     CephContext *cct,
     const candidates_t& candidates,
     int osd,
-    std::map<int,std::set<pg_t>>& temp_pgs_by_osd,
+    pgs_by_osd_overlay_t& temp_pgs_by_osd,
     std::set<pg_t>& to_unmap,
     std::map<pg_t, mempool::osdmap::vector<std::pair<int32_t,int32_t>>>& to_upmap
   );
@@ -1613,7 +1663,7 @@ bool try_drop_remap_underfull(
     size_t pg_pool_size,
     int osd,
     std::set<int>& existing,
-    std::map<int,std::set<pg_t>>& temp_pgs_by_osd,
+    pgs_by_osd_overlay_t& temp_pgs_by_osd,
     mempool::osdmap::vector<std::pair<int32_t,int32_t>> new_upmap_items,
     std::map<pg_t, mempool::osdmap::vector<std::pair<int32_t,int32_t>>>& to_upmap
   );
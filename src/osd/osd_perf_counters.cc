@@ -2,6 +2,7 @@
 // vim: ts=8 sw=2 smarttab
 
 #include "osd_perf_counters.h"
+#include "common/ceph_context.h"
 #include "include/common_fwd.h"
 
 
@@ -29,6 +30,7 @@ PerfCounters *build_osd_logger(CephContext *cct) {
 
   // All the basic OSD operation stats are to be considered useful
   osd_plb.set_prio_default(PerfCountersBuilder::PRIO_USEFUL);
+  osd_plb.set_sharded(cct->_conf->osd_perf_counters_sharded);
 
   osd_plb.add_u64(
     l_osd_op_wip, "op_wip",
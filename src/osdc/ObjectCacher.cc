@@ -114,6 +114,7 @@ ObjectCacher::BufferHead *ObjectCacher::Object::split(BufferHead *left,
   //inherit and if later access, this auto clean.
   right->set_dontneed(left->get_dontneed());
   right->set_nocache(left->get_nocache());
+  right->set_referenced(left->get_referenced());
 
   right->last_write_tid = left->last_write_tid;
   right->last_read_tid = left->last_read_tid;
@@ -189,6 +190,7 @@ void ObjectCacher::Object::merge_left(BufferHead *left, BufferHead *right)
 
   left->set_dontneed(right->get_dontneed() ? left->get_dontneed() : false);
   left->set_nocache(right->get_nocache() ? left->get_nocache() : false);
+  left->set_referenced(left->get_referenced() || right->get_referenced());
 
   // waiters
   for (auto p = right->waitfor_read.begin();
@@ -697,6 +699,7 @@ ObjectCacher::ObjectCacher(CephContext *cct_, string name,
   perf_start();
   finisher.start();
   scattered_write = writeback_handler.can_scattered_write();
+  bh_lru_rest.lru_set_midpoint(cct->_conf.get_val<double>("osdc_cache_mid"));
 }
 
 ObjectCacher::~ObjectCacher()
@@ -2737,10 +2740,7 @@ void ObjectCacher::bh_set_state(BufferHead *bh, int s)
     bh_lru_dirty.lru_insert_top(bh);
   } else if (s != BufferHead::STATE_DIRTY &&state == BufferHead::STATE_DIRTY) {
     bh_lru_dirty.lru_remove(bh);
-    if (bh->get_dontneed())
-      bh_lru_rest.lru_insert_bot(bh);
-    else
-      bh_lru_rest.lru_insert_top(bh);
+    bh_lru_rest_insert(bh);
   }
 
   if ((s == BufferHead::STATE_TX ||
@@ -2766,6 +2766,16 @@ void ObjectCacher::bh_set_state(BufferHead *bh, int s)
   bh_stat_add(bh);
 }
 
+void ObjectCacher::bh_lru_rest_insert(BufferHead *bh)
+{
+  if (bh->get_dontneed())
+    bh_lru_rest.lru_insert_bot(bh);
+  else if (bh->get_referenced())
+    bh_lru_rest.lru_insert_top(bh);
+  else
+    bh_lru_rest.lru_insert_mid(bh);
+}
+
 void ObjectCacher::bh_add(Object *ob, BufferHead *bh)
 {
   ceph_assert(ceph_mutex_is_locked(lock));
@@ -2775,10 +2785,7 @@ void ObjectCacher::bh_add(Object *ob, BufferHead *bh)
     bh_lru_dirty.lru_insert_top(bh);
     dirty_or_tx_bh.insert(bh);
   } else {
-    if (bh->get_dontneed())
-      bh_lru_rest.lru_insert_bot(bh);
-    else
-      bh_lru_rest.lru_insert_top(bh);
+    bh_lru_rest_insert(bh);
   }
 
   if (bh->is_tx()) {
@@ -118,6 +118,7 @@ class ObjectCacher {
     } ex;
     bool dontneed; //indicate bh don't need by anyone
     bool nocache; //indicate bh don't need by this caller
+    bool referenced; //read from since it was filled, see touch_bh()
 
   public:
     Object *ob;
@@ -137,6 +138,7 @@ class ObjectCacher {
       ref(0),
       dontneed(false),
       nocache(false),
+      referenced(false),
       ob(o),
       last_write_tid(0),
       last_read_tid(0),
@@ -210,6 +212,13 @@ class ObjectCacher {
       return nocache;
     }
 
+    void set_referenced(bool v) {
+      referenced = v;
+    }
+    bool get_referenced() const {
+      return referenced;
+    }
+
     inline bool can_merge_journal(BufferHead *bh) const {
       return (get_journal_tid() == bh->get_journal_tid());
     }
@@ -483,11 +492,23 @@ class ObjectCacher {
   loff_t get_stat_dirty_waiting() const { return stat_dirty_waiting; }
   size_t get_stat_nr_dirty_waiters() const { return stat_nr_dirty_waiters; }
 
+  /*
+   * Clean buffers enter bh_lru_rest at its midpoint and are only moved
+   * above it once they are hit a second time, i.e. read again after the
+   * read that brought them in; a sequential scan thus only churns the
+   * part of the lru below the midpoint and does not push out data that
+   * is actually being reused.
+   */
   void touch_bh(BufferHead *bh) {
-    if (bh->is_dirty())
+    if (bh->is_dirty()) {
       bh_lru_dirty.lru_touch(bh);
-    else
+    } else if (bh->get_referenced()) {
       bh_lru_rest.lru_touch(bh);
+    } else {
+      bh_lru_rest.lru_midtouch(bh);
+      if (bh->is_clean() || bh->is_zero())
+	bh->set_referenced(true);
+    }
 
     bh->set_dontneed(false);
     bh->set_nocache(false);
@@ -529,6 +550,7 @@ class ObjectCacher {
     //bh->set_dirty_stamp(ceph_clock_now());
   }
 
+  void bh_lru_rest_insert(BufferHead *bh);
   void bh_add(Object *ob, BufferHead *bh);
   void bh_remove(Object *ob, BufferHead *bh);
 
@@ -184,6 +184,15 @@ enum {
   l_osdc_replica_read_bounced,
   l_osdc_replica_read_completed,
 
+  l_osdc_crush_cache_hit,
+  l_osdc_crush_cache_miss,
+
+  l_osdc_op_lockless,
+  l_osdc_op_submit_batch,
+
+  l_osdc_op_batch,
+  l_osdc_op_batched,
+
   l_osdc_last,
 };
 
@@ -389,6 +398,21 @@ void Objecter::init()
     pcb.add_u64_counter(l_osdc_replica_read_completed, "replica_read_completed",
 			"Operations completed by replica");
 
+    pcb.add_u64_counter(l_osdc_crush_cache_hit, "crush_cache_hit",
+			"CRUSH mappings served from the result cache");
+    pcb.add_u64_counter(l_osdc_crush_cache_miss, "crush_cache_miss",
+			"CRUSH mappings computed on a result cache miss");
+
+    pcb.add_u64_counter(l_osdc_op_lockless, "op_lockless",
+			"Operations submitted without taking the objecter lock");
+    pcb.add_u64_counter(l_osdc_op_submit_batch, "op_submit_batch",
+			"Calls submitting several operations at once");
+
+    pcb.add_u64_counter(l_osdc_op_batch, "op_batch",
+			"Op batch messages sent");
+    pcb.add_u64_counter(l_osdc_op_batched, "op_batched",
+			"Operations sent as part of an op batch");
+
     logger = pcb.create_perf_counters();
     cct->get_perfcounters_collection()->add(logger);
   }
@@ -418,12 +442,13 @@ void Objecter::init()
  */
 void Objecter::start(const OSDMap* o)
 {
-  shared_lock rl(rwlock);
+  unique_lock wl(rwlock);
 
   start_tick();
   if (o) {
     osdmap->deepish_copy_from(*o);
     prune_pg_mapping(osdmap->get_pools());
+    _publish_submit_snapshot();
   } else if (osdmap->get_epoch() == 0) {
     _maybe_request_map();
   }
@@ -436,6 +461,7 @@ void Objecter::shutdown()
   unique_lock wl(rwlock);
 
   initialized = false;
+  _withdraw_submit_snapshot();
 
   wl.unlock();
   cct->_conf.remove_observer(this);
@@ -1170,6 +1196,18 @@ void Objecter::_scan_requests(
   }
 }
 
+void Objecter::_enable_crush_cache(OSDMap *m)
+{
+  // only called for crush maps we decoded ourselves: a map shared with
+  // our owner (see start()) may be in use by other threads
+  auto order = cct->_conf.get_val<uint64_t>("objecter_crush_cache_order");
+  if (order && !m->crush->has_result_cache()) {
+    m->crush->enable_result_cache(order, logger,
+				  l_osdc_crush_cache_hit,
+				  l_osdc_crush_cache_miss);
+  }
+}
+
 void Objecter::handle_osd_map(MOSDMap *m)
 {
   ceph::shunique_lock sul(rwlock, acquire_unique);
@@ -1207,7 +1245,18 @@ void Objecter::handle_osd_map(MOSDMap *m)
 		  << m->get_first() << "," << m->get_last()
 		  << "] > " << osdmap->get_epoch() << dendl;
 
+    // from here on lockless submitters must not add ops to sessions we
+    // may already have scanned
+    _withdraw_submit_snapshot();
+
     if (osdmap->get_epoch()) {
+      if (lockless_op_submit) {
+	// the current map may still be in use by submitters holding a
+	// snapshot of it; apply the new epochs to a private copy
+	auto new_osdmap = std::make_shared<OSDMap>();
+	new_osdmap->deepish_copy_from(*osdmap);
+	osdmap = std::move(new_osdmap);
+      }
       bool skipped_map = false;
       // we want incrementals
       for (epoch_t e = osdmap->get_epoch() + 1;
@@ -1220,6 +1269,9 @@ void Objecter::handle_osd_map(MOSDMap *m)
 			<< dendl;
 	  OSDMap::Incremental inc(m->incremental_maps[e]);
 	  osdmap->apply_incremental(inc);
+	  if (inc.crush.length()) {
+	    _enable_crush_cache(osdmap.get());
+	  }
 
           emit_blocklist_events(inc);
 
@@ -1227,8 +1279,9 @@ void Objecter::handle_osd_map(MOSDMap *m)
 	}
 	else if (m->maps.count(e)) {
 	  ldout(cct, 3) << "handle_osd_map decoding full epoch " << e << dendl;
-          auto new_osdmap = std::make_unique<OSDMap>();
+          auto new_osdmap = std::make_shared<OSDMap>();
           new_osdmap->decode(m->maps[e]);
+          _enable_crush_cache(new_osdmap.get());
 
           emit_blocklist_events(*osdmap, *new_osdmap);
           osdmap = std::move(new_osdmap);
@@ -1293,6 +1346,7 @@ void Objecter::handle_osd_map(MOSDMap *m)
 	ldout(cct, 3) << "handle_osd_map decoding full epoch "
 		      << m->get_last() << dendl;
 	osdmap->decode(m->maps[m->get_last()]);
+	_enable_crush_cache(osdmap.get());
         prune_pg_mapping(osdmap->get_pools());
 
 	_scan_requests(homeless_session, false, false, NULL,
@@ -1401,6 +1455,8 @@ void Objecter::handle_osd_map(MOSDMap *m)
   if (!waiting_for_map.empty()) {
     _maybe_request_map();
   }
+
+  _publish_submit_snapshot();
 }
 
 void Objecter::enable_blocklist_events()
@@ -1882,6 +1938,11 @@ int Objecter::_get_session(int osd, OSDSession **session,
   s->con->set_priv(RefCountedPtr{s});
   logger->inc(l_osdc_osd_session_open);
   logger->set(l_osdc_osd_sessions, osd_sessions.size());
+  if (std::atomic_load(&submit_snapshot)) {
+    // let lockless submitters find the new session, unless
+    // handle_osd_map() has withdrawn the snapshot
+    _publish_submit_snapshot();
+  }
   s->get();
   *session = s;
   ldout(cct, 20) << __func__ << " s=" << s << " osd=" << osd << " "
@@ -1917,6 +1978,8 @@ void Objecter::_reopen_session(OSDSession *s)
   auto addrs = osdmap->get_addrs(s->osd);
   ldout(cct, 10) << "reopen_session osd." << s->osd << " session, addr now "
 		 << addrs << dendl;
+  // the caller resends everything on the new connection
+  _session_discard_batch(s);
   if (s->con) {
     s->con->set_priv(NULL);
     s->con->mark_down();
@@ -1939,6 +2002,7 @@ void Objecter::close_session(OSDSession *s)
     logger->inc(l_osdc_osd_session_close);
   }
   unique_lock sl(s->lock);
+  _session_discard_batch(s);
 
   std::list<LingerOp*> homeless_lingers;
   std::list<CommandOp*> homeless_commands;
@@ -2286,12 +2350,170 @@ void Objecter::resend_mon_ops()
 
 void Objecter::op_submit(Op *op, ceph_tid_t *ptid, int *ctx_budget)
 {
-  shunique_lock rl(rwlock, ceph::acquire_shared);
   ceph_tid_t tid = 0;
   if (!ptid)
     ptid = &tid;
   op->trace.event("op submit");
-  _op_submit_with_budget(op, rl, ptid, ctx_budget);
+  if (!lockless_op_submit) {
+    shunique_lock rl(rwlock, ceph::acquire_shared);
+    _op_submit_with_budget(op, rl, ptid, ctx_budget);
+    return;
+  }
+
+  ceph_assert(initialized);
+
+  ceph_assert(op->ops.size() == op->out_bl.size());
+  ceph_assert(op->ops.size() == op->out_rval.size());
+  ceph_assert(op->ops.size() == op->out_handler.size());
+
+  // same as _op_submit_with_budget(), except that we can block on the
+  // throttles without a lock to drop
+  if (!op->ctx_budgeted || (ctx_budget && (*ctx_budget == -1))) {
+    int op_budget = _take_op_budget(op);
+    if (ctx_budget && (*ctx_budget == -1)) {
+      *ctx_budget = op_budget;
+    }
+  }
+
+  if (_op_submit_lockless(op, ptid)) {
+    return;
+  }
+
+  shunique_lock rl(rwlock, ceph::acquire_shared);
+  _op_add_timeout(op);
+  _op_submit(op, rl, ptid);
+}
+
+void Objecter::op_submit_batch(const std::vector<Op*>& ops)
+{
+  if (ops.empty()) {
+    return;
+  }
+  shunique_lock rl(rwlock, ceph::acquire_shared);
+  // only the pg seed is needed for the ordering, so hash the names here
+  // and leave the crush mapping to _calc_target()
+  std::vector<std::pair<pg_t, Op*>> order;
+  order.reserve(ops.size());
+  for (auto op : ops) {
+    pg_t pgid;
+    if (osdmap->object_locator_to_pg(op->target.base_oid,
+				     op->target.base_oloc, pgid) < 0) {
+      pgid = pg_t();
+    }
+    order.emplace_back(pgid, op);
+  }
+  std::stable_sort(order.begin(), order.end(),
+		   [](const auto& a, const auto& b) {
+		     return a.first < b.first;
+		   });
+  ldout(cct, 10) << __func__ << " " << ops.size() << " ops" << dendl;
+  logger->inc(l_osdc_op_submit_batch);
+  for (auto& [pgid, op] : order) {
+    op->trace.event("op submit");
+    // may drop and retake rl while blocked on the throttles, which
+    // only costs us the ordering of the remaining ops
+    _op_submit_with_budget(op, rl, nullptr);
+  }
+}
+
+void Objecter::_op_add_timeout(Op *op)
+{
+  if (osd_timeout > timespan(0)) {
+    if (op->tid == 0)
+      op->tid = ++last_tid;
+    auto tid = op->tid;
+    op->ontimeout = timer.add_event(osd_timeout,
+				    [this, tid]() {
+				      op_cancel(tid, -ETIMEDOUT); });
+  }
+}
+
+/**
+ * Place and send an op using the published SubmitSnapshot.
+ *
+ * Only the common case is handled here: a mapped, unpaused target on
+ * an OSD we already have a session with.  Anything else (and any op
+ * that races with a map change) returns false and goes through
+ * _op_submit() under rwlock.
+ */
+bool Objecter::_op_submit_lockless(Op *op, ceph_tid_t *ptid)
+{
+  if (op->target.flags & CEPH_OSD_FLAG_LOCALIZE_READS) {
+    // needs crush_location, which rwlock protects
+    return false;
+  }
+  auto snap = std::atomic_load(&submit_snapshot);
+  if (!snap) {
+    return false;
+  }
+
+  // the pg mapping cache is left alone, it has a lock of its own
+  int r = _calc_target(*snap->osdmap, &op->target, false, false);
+  if (r == RECALC_OP_TARGET_POOL_DNE ||
+      r == RECALC_OP_TARGET_POOL_EIO ||
+      op->target.paused ||
+      op->target.osd < 0 ||
+      op->target.osd >= (int)snap->sessions.size() ||
+      !snap->sessions[op->target.osd]) {
+    return false;
+  }
+  ceph_assert(op->target.flags & (CEPH_OSD_FLAG_READ|CEPH_OSD_FLAG_WRITE));
+
+  OSDSession *s = snap->sessions[op->target.osd].get();
+  unique_lock sl(s->lock);
+  if (submit_gen.load() != snap->gen) {
+    // handle_osd_map() has started and may already have scanned this
+    // session, so it would never see the op.  Pairs with the bump in
+    // _withdraw_submit_snapshot(), which happens before the scan takes
+    // s->lock.
+    return false;
+  }
+
+  _send_op_account(op);
+  logger->inc(l_osdc_op_lockless);
+  if (op->tid == 0)
+    op->tid = ++last_tid;
+  _op_add_timeout(op);
+
+  ldout(cct, 10) << __func__ << " oid " << op->target.base_oid
+		 << " '" << op->target.base_oloc << "' '"
+		 << op->target.target_oloc << "' " << op->ops << " tid "
+		 << op->tid << " osd." << s->osd
+		 << " e" << snap->osdmap->get_epoch() << dendl;
+
+  _session_op_assign(s, op);
+  _send_op(op, snap->osdmap->get_epoch());
+
+  // as in _op_submit(), op may be freed once we drop the session lock
+  *ptid = op->tid;
+  return true;
+}
+
+void Objecter::_publish_submit_snapshot()
+{
+  // rwlock is locked unique
+  if (!lockless_op_submit || !initialized || !osdmap->get_epoch()) {
+    return;
+  }
+  auto snap = std::make_shared<SubmitSnapshot>();
+  snap->osdmap = osdmap;
+  snap->sessions.resize(osdmap->get_max_osd());
+  for (auto& [osd, s] : osd_sessions) {
+    if (osd < (int)snap->sessions.size()) {
+      snap->sessions[osd] = s;
+    }
+  }
+  snap->gen = ++submit_gen;
+  std::atomic_store(&submit_snapshot,
+		    std::shared_ptr<const SubmitSnapshot>(std::move(snap)));
+}
+
+void Objecter::_withdraw_submit_snapshot()
+{
+  // rwlock is locked unique
+  ++submit_gen;
+  std::atomic_store(&submit_snapshot,
+		    std::shared_ptr<const SubmitSnapshot>());
 }
 
 void Objecter::_op_submit_with_budget(Op *op,
@@ -2316,15 +2538,7 @@ void Objecter::_op_submit_with_budget(Op *op,
     }
   }
 
-  if (osd_timeout > timespan(0)) {
-    if (op->tid == 0)
-      op->tid = ++last_tid;
-    auto tid = op->tid;
-    op->ontimeout = timer.add_event(osd_timeout,
-				    [this, tid]() {
-				      op_cancel(tid, -ETIMEDOUT); });
-  }
-
+  _op_add_timeout(op);
   _op_submit(op, sul, ptid);
 }
 
@@ -2670,16 +2884,16 @@ bool Objecter::is_pg_changed(
   return false;      // same primary (tho replicas may have changed)
 }
 
-bool Objecter::target_should_be_paused(op_target_t *t)
+bool Objecter::target_should_be_paused(const OSDMap& o, op_target_t *t)
 {
-  const pg_pool_t *pi = osdmap->get_pg_pool(t->base_oloc.pool);
-  bool pauserd = osdmap->test_flag(CEPH_OSDMAP_PAUSERD);
-  bool pausewr = osdmap->test_flag(CEPH_OSDMAP_PAUSEWR) ||
-    (t->respects_full() && (_osdmap_full_flag() || _osdmap_pool_full(*pi)));
+  const pg_pool_t *pi = o.get_pg_pool(t->base_oloc.pool);
+  bool pauserd = o.test_flag(CEPH_OSDMAP_PAUSERD);
+  bool pausewr = o.test_flag(CEPH_OSDMAP_PAUSEWR) ||
+    (t->respects_full() && (_osdmap_full_flag(o) || _osdmap_pool_full(*pi)));
 
   return (t->flags & CEPH_OSD_FLAG_READ && pauserd) ||
     (t->flags & CEPH_OSD_FLAG_WRITE && pausewr) ||
-    (osdmap->get_epoch() < epoch_barrier);
+    (o.get_epoch() < epoch_barrier);
 }
 
 /**
@@ -2727,10 +2941,10 @@ bool Objecter::_osdmap_has_pool_full() const
 /**
  * Wrapper around osdmap->test_flag for special handling of the FULL flag.
  */
-bool Objecter::_osdmap_full_flag() const
+bool Objecter::_osdmap_full_flag(const OSDMap& o) const
 {
   // Ignore the FULL flag if the caller does not have honor_osdmap_full
-  return osdmap->test_flag(CEPH_OSDMAP_FULL) && honor_pool_full;
+  return o.test_flag(CEPH_OSDMAP_FULL) && honor_pool_full;
 }
 
 void Objecter::update_pool_full_map(map<int64_t, bool>& pool_full_map)
@@ -2795,12 +3009,13 @@ void Objecter::_prune_snapc(
   }
 }
 
-int Objecter::_calc_target(op_target_t *t, Connection *con, bool any_change)
+int Objecter::_calc_target(const OSDMap& o, op_target_t *t, bool any_change,
+			   bool use_pg_mapping_cache)
 {
-  // rwlock is locked
+  // rwlock is locked, or @o is a SubmitSnapshot's map
   bool is_read = t->flags & CEPH_OSD_FLAG_READ;
   bool is_write = t->flags & CEPH_OSD_FLAG_WRITE;
-  t->epoch = osdmap->get_epoch();
+  t->epoch = o.get_epoch();
   ldout(cct,20) << __func__ << " epoch " << t->epoch
 		<< " base " << t->base_oid << " " << t->base_oloc
 		<< " precalc_pgid " << (int)t->precalc_pgid
@@ -2809,7 +3024,7 @@ int Objecter::_calc_target(op_target_t *t, Connection *con, bool any_change)
 		<< (is_write ? " is_write" : "")
 		<< dendl;
 
-  const pg_pool_t *pi = osdmap->get_pg_pool(t->base_oloc.pool);
+  const pg_pool_t *pi = o.get_pg_pool(t->base_oloc.pool);
   if (!pi) {
     t->osd = -1;
     return RECALC_OP_TARGET_POOL_DNE;
@@ -2823,7 +3038,7 @@ int Objecter::_calc_target(op_target_t *t, Connection *con, bool any_change)
 		<< " pg_num " << pi->get_pg_num() << dendl;
 
   bool force_resend = false;
-  if (osdmap->get_epoch() == pi->last_force_op_resend) {
+  if (o.get_epoch() == pi->last_force_op_resend) {
     if (t->last_force_resend < pi->last_force_op_resend) {
       t->last_force_resend = pi->last_force_op_resend;
       force_resend = true;
@@ -2840,7 +3055,7 @@ int Objecter::_calc_target(op_target_t *t, Connection *con, bool any_change)
       t->target_oloc.pool = pi->read_tier;
     if (is_write && pi->has_write_tier())
       t->target_oloc.pool = pi->write_tier;
-    pi = osdmap->get_pg_pool(t->target_oloc.pool);
+    pi = o.get_pg_pool(t->target_oloc.pool);
     if (!pi) {
       t->osd = -1;
       return RECALC_OP_TARGET_POOL_DNE;
@@ -2854,8 +3069,8 @@ int Objecter::_calc_target(op_target_t *t, Connection *con, bool any_change)
     ceph_assert(t->base_oloc.pool == (int64_t)t->base_pgid.pool());
     pgid = t->base_pgid;
   } else {
-    int ret = osdmap->object_locator_to_pg(t->target_oid, t->target_oloc,
-					   pgid);
+    int ret = o.object_locator_to_pg(t->target_oid, t->target_oloc,
+				     pgid);
     if (ret == -ENOENT) {
       t->osd = -1;
       return RECALC_OP_TARGET_POOL_DNE;
@@ -2876,16 +3091,19 @@ int Objecter::_calc_target(op_target_t *t, Connection *con, bool any_change)
   vector<int> up, acting;
   ps_t actual_ps = ceph_stable_mod(pgid.ps(), pg_num, pg_num_mask);
   pg_t actual_pgid(actual_ps, pgid.pool());
-  if (!lookup_pg_mapping(actual_pgid, osdmap->get_epoch(), &up, &up_primary,
-                         &acting, &acting_primary)) {
-    osdmap->pg_to_up_acting_osds(actual_pgid, &up, &up_primary,
-                                 &acting, &acting_primary);
-    pg_mapping_t pg_mapping(osdmap->get_epoch(),
+  if (!use_pg_mapping_cache) {
+    o.pg_to_up_acting_osds(actual_pgid, &up, &up_primary,
+			   &acting, &acting_primary);
+  } else if (!lookup_pg_mapping(actual_pgid, o.get_epoch(), &up, &up_primary,
+				&acting, &acting_primary)) {
+    o.pg_to_up_acting_osds(actual_pgid, &up, &up_primary,
+			   &acting, &acting_primary);
+    pg_mapping_t pg_mapping(o.get_epoch(),
                             up, up_primary, acting, acting_primary);
     update_pg_mapping(actual_pgid, std::move(pg_mapping));
   }
-  bool sort_bitwise = osdmap->test_flag(CEPH_OSDMAP_SORTBITWISE);
-  bool recovery_deletes = osdmap->test_flag(CEPH_OSDMAP_RECOVERY_DELETES);
+  bool sort_bitwise = o.test_flag(CEPH_OSDMAP_SORTBITWISE);
+  bool recovery_deletes = o.test_flag(CEPH_OSDMAP_RECOVERY_DELETES);
   unsigned prev_seed = ceph_stable_mod(pgid.ps(), t->pg_num, t->pg_num_mask);
   pg_t prev_pgid(prev_seed, pgid.pool());
   if (any_change && PastIntervals::is_new_interval(
@@ -2922,7 +3140,7 @@ int Objecter::_calc_target(op_target_t *t, Connection *con, bool any_change)
   }
 
   bool unpaused = false;
-  bool should_be_paused = target_should_be_paused(t);
+  bool should_be_paused = target_should_be_paused(o, t);
   if (t->paused && !should_be_paused) {
     unpaused = true;
   }
@@ -2995,7 +3213,7 @@ int Objecter::_calc_target(op_target_t *t, Connection *con, bool any_change)
 	int best = -1;
 	int best_locality = 0;
 	for (unsigned i = 0; i < t->acting.size(); ++i) {
-	  int locality = osdmap->crush->get_common_ancestor_distance(
+	  int locality = o.crush->get_common_ancestor_distance(
 		 cct, t->acting[i], crush_location);
 	  ldout(cct, 20) << __func__ << " localize: rank " << i
 			 << " osd." << t->acting[i]
@@ -3022,8 +3240,8 @@ int Objecter::_calc_target(op_target_t *t, Connection *con, bool any_change)
     return RECALC_OP_TARGET_NEED_RESEND;
   }
   if (split_or_merge &&
-      (osdmap->require_osd_release >= ceph_release_t::luminous ||
-       HAVE_FEATURE(osdmap->get_xinfo(acting_primary).features,
+      (o.require_osd_release >= ceph_release_t::luminous ||
+       HAVE_FEATURE(o.get_xinfo(acting_primary).features,
 		    RESEND_ON_SPLIT))) {
     return RECALC_OP_TARGET_NEED_RESEND;
   }
@@ -3209,7 +3427,7 @@ void Objecter::_finish_op(Op *op, int r)
   op->put();
 }
 
-Objecter::MOSDOp *Objecter::_prepare_osd_op(Op *op)
+Objecter::MOSDOp *Objecter::_prepare_osd_op(Op *op, epoch_t epoch)
 {
   // rwlock is locked
 
@@ -3230,7 +3448,7 @@ Objecter::MOSDOp *Objecter::_prepare_osd_op(Op *op)
   hobject_t hobj = op->target.get_hobj();
   auto m = new MOSDOp(client_inc, op->tid,
 		      hobj, op->target.actual_pgid,
-		      osdmap->get_epoch(),
+		      epoch,
 		      flags, op->features);
 
   m->set_snapid(op->snapid);
@@ -3268,9 +3486,9 @@ Objecter::MOSDOp *Objecter::_prepare_osd_op(Op *op)
   return m;
 }
 
-void Objecter::_send_op(Op *op)
+void Objecter::_send_op(Op *op, epoch_t epoch)
 {
-  // rwlock is locked
+  // rwlock is locked, or @epoch is that of a SubmitSnapshot we hold
   // op->session->lock is locked
 
   // backoff?
@@ -3298,7 +3516,7 @@ void Objecter::_send_op(Op *op)
   }
 
   ceph_assert(op->tid > 0);
-  MOSDOp *m = _prepare_osd_op(op);
+  MOSDOp *m = _prepare_osd_op(op, epoch);
 
   if (op->target.actual_pgid != m->get_spg()) {
     ldout(cct, 10) << __func__ << " " << op->tid << " pgid change from "
@@ -3338,9 +3556,73 @@ void Objecter::_send_op(Op *op)
   if (op->trace.valid()) {
     m->trace.init("op msg", nullptr, &op->trace);
   }
+  // only OSDs that understand MOSDOpBatch get their ops batched
+  if (op_batch_max > 1 && con->has_features(CEPH_FEATUREMASK_OSD_OP_BATCH)) {
+    uint64_t bytes = 0;
+    for (auto& o : m->ops) {
+      bytes += o.indata.length();
+    }
+    _session_batch_op(op->session, m, bytes);
+    return;
+  }
+  _session_flush_batch(op->session);
   op->session->con->send_message(m);
 }
 
+/*
+ * Small ops are not sent right away but collected per session, and go
+ * out together in one MOSDOpBatch once objecter_op_batch_max of them or
+ * objecter_op_batch_max_bytes of data have accumulated, or when
+ * objecter_op_batch_window_us has passed since the first one came in,
+ * whichever is first.  An op too large to be batched flushes the batch
+ * ahead of it, so ops still reach the OSD in the order they were sent.
+ */
+void Objecter::_session_batch_op(OSDSession *s, MOSDOp *m, uint64_t bytes)
+{
+  // s->lock is locked unique
+  auto send = [this, s](MessageRef m, size_t num_ops) {
+    _session_send_batch(s, std::move(m), num_ops);
+  };
+  if (s->batch.add(MessageRef{m, false}, bytes, send)) {
+    batch_timer->add_event(
+      op_batch_window,
+      [this, s = boost::intrusive_ptr<OSDSession>{s}] {
+	unique_lock sl(s->lock);
+	s->batch.scheduled_flush([this, s = s.get()](MessageRef m,
+						     size_t num_ops) {
+	  _session_send_batch(s, std::move(m), num_ops);
+	});
+      });
+  }
+}
+
+void Objecter::_session_flush_batch(OSDSession *s)
+{
+  // s->lock is locked unique
+  s->batch.flush([this, s](MessageRef m, size_t num_ops) {
+    _session_send_batch(s, std::move(m), num_ops);
+  });
+}
+
+void Objecter::_session_send_batch(OSDSession *s, MessageRef m,
+				   size_t num_ops)
+{
+  // s->lock is locked unique
+  if (num_ops > 1) {
+    ldout(cct, 15) << __func__ << " " << num_ops << " ops to osd." << s->osd
+		   << dendl;
+    logger->inc(l_osdc_op_batch);
+    logger->inc(l_osdc_op_batched, num_ops);
+  }
+  s->con->send_message2(std::move(m));
+}
+
+void Objecter::_session_discard_batch(OSDSession *s)
+{
+  // s->lock is locked unique
+  s->batch.discard();
+}
+
 int Objecter::calc_op_budget(const bc::small_vector_base<OSDOp>& ops)
 {
   int op_budget = 0;
@@ -5111,6 +5393,9 @@ Objecter::Objecter(CephContext *cct,
 {
   mon_timeout = cct->_conf.get_val<std::chrono::seconds>("rados_mon_op_timeout");
   osd_timeout = cct->_conf.get_val<std::chrono::seconds>("rados_osd_op_timeout");
+  if (op_batch_max > 1) {
+    batch_timer.emplace();
+  }
 }
 
 Objecter::~Objecter()
@@ -5145,7 +5430,7 @@ void Objecter::set_epoch_barrier(epoch_t epoch)
   unique_lock wl(rwlock);
 
   ldout(cct, 7) << __func__ << ": barrier " << epoch << " (was "
-		<< epoch_barrier << ") current epoch " << osdmap->get_epoch()
+		<< epoch_barrier.load() << ") current epoch " << osdmap->get_epoch()
 		<< dendl;
   if (epoch > epoch_barrier) {
     epoch_barrier = epoch;
@@ -20,6 +20,7 @@
 #include <map>
 #include <mutex>
 #include <memory>
+#include <optional>
 #include <sstream>
 #include <string>
 #include <string_view>
@@ -66,6 +67,8 @@
 #include "osd/OSDMap.h"
 #include "osd/error_code.h"
 
+#include "osdc/OpBatcher.h"
+
 class Context;
 class Messenger;
 class MonClient;
@@ -1706,7 +1709,7 @@ public:
       finish_strand{service.get_executor()};
   ZTracer::Endpoint trace_endpoint{"0.0.0.0", 0, "Objecter"};
 private:
-  std::unique_ptr<OSDMap> osdmap{std::make_unique<OSDMap>()};
+  std::shared_ptr<OSDMap> osdmap{std::make_shared<OSDMap>()};
 public:
   using Dispatcher::cct;
   std::multimap<std::string,std::string> crush_location;
@@ -1720,6 +1723,13 @@ private:
   uint64_t max_linger_id{0};
   std::atomic<unsigned> num_in_flight{0};
   std::atomic<int> global_op_flags{0}; // flags which are applied to each IO op
+  const bool lockless_op_submit =
+    cct->_conf.get_val<bool>("objecter_lockless_op_submit");
+  // see _session_batch_op()
+  const uint64_t op_batch_max =
+    cct->_conf.get_val<uint64_t>("objecter_op_batch_max");
+  const std::chrono::microseconds op_batch_window{
+    cct->_conf.get_val<uint64_t>("objecter_op_batch_window_us")};
   bool keep_balanced_budget = false;
   bool honor_pool_full = true;
 
@@ -1798,6 +1808,7 @@ public:
 private:
 
   void _maybe_request_map();
+  void _enable_crush_cache(OSDMap *m);
 
   version_t last_seen_osdmap_version = 0;
   version_t last_seen_pgmap_version = 0;
@@ -1805,6 +1816,9 @@ private:
   mutable ceph::shared_mutex rwlock =
 	   ceph::make_shared_mutex("Objecter::rwlock");
   ceph::timer<ceph::coarse_mono_clock> timer;
+  // flushes op batches, only started if objecter_op_batch_max > 1; the
+  // coarse clock is too coarse for windows in the microseconds
+  std::optional<ceph::timer<ceph::mono_clock>> batch_timer;
 
   PerfCounters* logger = nullptr;
 
@@ -2474,11 +2488,16 @@ public:
 
     int incarnation;
     ConnectionRef con;
+    // MOSDOps waiting to go out in one MOSDOpBatch; see
+    // Objecter::_session_batch_op()
+    OpBatcher batch;
     int num_locks;
     std::unique_ptr<std::mutex[]> completion_locks;
 
     OSDSession(CephContext *cct, int o) :
       osd(o), incarnation(0), con(NULL),
+      batch(cct->_conf.get_val<uint64_t>("objecter_op_batch_max"),
+	    cct->_conf.get_val<Option::size_t>("objecter_op_batch_max_bytes")),
       num_locks(cct->_conf->objecter_completion_locks_per_session),
       completion_locks(new std::mutex[num_locks]) {}
 
@@ -2490,6 +2509,29 @@ public:
   };
   std::map<int,OSDSession*> osd_sessions;
 
+ private:
+  /**
+   * What _op_submit_lockless() needs to place an op without taking
+   * rwlock: an OSDMap that is never modified again and the sessions
+   * that were open when it was published.  Holding a snapshot keeps
+   * both alive.
+   */
+  struct SubmitSnapshot {
+    uint64_t gen = 0;
+    std::shared_ptr<const OSDMap> osdmap;
+    /// indexed by osd id, null where we have no session yet
+    std::vector<boost::intrusive_ptr<OSDSession>> sessions;
+  };
+  // accessed with std::atomic_load/atomic_store
+  std::shared_ptr<const SubmitSnapshot> submit_snapshot;
+  /// bumped whenever submit_snapshot is replaced or withdrawn
+  std::atomic<uint64_t> submit_gen{0};
+
+  void _publish_submit_snapshot();
+  void _withdraw_submit_snapshot();
+
+ public:
+
   bool osdmap_full_flag() const;
   bool osdmap_pool_full(const int64_t pool_id) const;
 
@@ -2533,9 +2575,16 @@ public:
   ceph::timespan mon_timeout;
   ceph::timespan osd_timeout;
 
-  MOSDOp *_prepare_osd_op(Op *op);
-  void _send_op(Op *op);
+  MOSDOp *_prepare_osd_op(Op *op, epoch_t epoch);
+  void _send_op(Op *op) {
+    _send_op(op, osdmap->get_epoch());
+  }
+  void _send_op(Op *op, epoch_t epoch);
   void _send_op_account(Op *op);
+  void _session_batch_op(OSDSession *s, MOSDOp *m, uint64_t bytes);
+  void _session_flush_batch(OSDSession *s);
+  void _session_discard_batch(OSDSession *s);
+  void _session_send_batch(OSDSession *s, MessageRef m, size_t num_ops);
   void _cancel_linger_op(Op *op);
   void _finish_op(Op *op, int r);
   static bool is_pg_changed(
@@ -2552,15 +2601,25 @@ public:
     RECALC_OP_TARGET_OSD_DOWN,
     RECALC_OP_TARGET_POOL_EIO,
   };
-  bool _osdmap_full_flag() const;
+  bool _osdmap_full_flag() const {
+    return _osdmap_full_flag(*osdmap);
+  }
+  bool _osdmap_full_flag(const OSDMap& o) const;
   bool _osdmap_has_pool_full() const;
   void _prune_snapc(
     const mempool::osdmap::map<int64_t, snap_interval_set_t>& new_removed_snaps,
     Op *op);
 
-  bool target_should_be_paused(op_target_t *op);
+  bool target_should_be_paused(op_target_t *op) {
+    return target_should_be_paused(*osdmap, op);
+  }
+  bool target_should_be_paused(const OSDMap& o, op_target_t *op);
   int _calc_target(op_target_t *t, Connection *con,
-		   bool any_change = false);
+		   bool any_change = false) {
+    return _calc_target(*osdmap, t, any_change, true);
+  }
+  int _calc_target(const OSDMap& o, op_target_t *t, bool any_change,
+		   bool use_pg_mapping_cache);
   int _map_session(op_target_t *op, OSDSession **s,
 		   ceph::shunique_lock<ceph::shared_mutex>& lc);
 
@@ -2647,6 +2706,19 @@ private:
   int calc_op_budget(const boost::container::small_vector_base<OSDOp>& ops);
   void _throttle_op(Op *op, ceph::shunique_lock<ceph::shared_mutex>& sul,
 		    int op_size = 0);
+  int _take_op_budget(Op *op) {
+    // no lock held, so we can simply block on the throttles
+    int op_budget = calc_op_budget(op->ops);
+    if (keep_balanced_budget) {
+      op_throttle_bytes.get(op_budget);
+      op_throttle_ops.get(1);
+    } else {
+      op_throttle_bytes.take(op_budget);
+      op_throttle_ops.take(1);
+    }
+    op->budget = op_budget;
+    return op_budget;
+  }
   int _take_op_budget(Op *op, ceph::shunique_lock<ceph::shared_mutex>& sul) {
     ceph_assert(sul && sul.mutex() == &rwlock);
     int op_budget = calc_op_budget(op->ops);
@@ -2730,6 +2802,9 @@ private:
 
   // messages
  public:
+  bool ms_can_dispatch_concurrently() const override {
+    return true;
+  }
   bool ms_dispatch(Message *m) override;
   bool ms_can_fast_dispatch_any() const override {
     return true;
@@ -2812,9 +2887,20 @@ private:
 			      ceph::shunique_lock<ceph::shared_mutex>& lc,
 			      ceph_tid_t *ptid,
 			      int *ctx_budget = NULL);
+  bool _op_submit_lockless(Op *op, ceph_tid_t *ptid);
+  void _op_add_timeout(Op *op);
   // public interface
 public:
   void op_submit(Op *op, ceph_tid_t *ptid = NULL, int *ctx_budget = NULL);
+  /**
+   * Submit several ops under a single hold of rwlock.
+   *
+   * The ops go out ordered by placement group, so that those for the
+   * same pg share a warm pg mapping cache entry and leave back to back
+   * (and can ride in the same MOSDOpBatch, see objecter_op_batch_max).
+   * Each op still completes on its own.
+   */
+  void op_submit_batch(const std::vector<Op*>& ops);
   bool is_active() {
     std::shared_lock l(rwlock);
     return !((!inflight_ops) && linger_ops.empty() &&
@@ -4037,7 +4123,7 @@ public:
   void blocklist_self(bool set);
 
 private:
-  epoch_t epoch_barrier = 0;
+  std::atomic<epoch_t> epoch_barrier{0};
   bool retry_writes_after_first_reply =
     cct->_conf->objecter_retry_writes_after_first_reply;
 
@@ -0,0 +1,108 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef CEPH_OSDC_OPBATCHER_H
+#define CEPH_OSDC_OPBATCHER_H
+
+#include <vector>
+
+#include "messages/MOSDOpBatch.h"
+
+/*
+ * OpBatcher - the small ops of one OSD session waiting to go out together
+ *
+ * Ops are held back until max_ops of them or max_bytes of data have
+ * accumulated, or until the owner flushes them once the batch window has
+ * passed.  An op too large to be batched flushes the batch ahead of it,
+ * so ops are still sent in the order they were added.  Whatever is to be
+ * sent is handed to a callback taking the message and the number of ops
+ * it carries.  Not thread safe; the owner serializes access.
+ */
+class OpBatcher {
+  uint64_t max_ops;
+  uint64_t max_bytes;
+  std::vector<ceph::ref_t<Message>> ops;
+  uint64_t bytes = 0;
+  bool flush_scheduled = false;
+
+public:
+  OpBatcher(uint64_t max_ops, uint64_t max_bytes)
+    : max_ops(max_ops), max_bytes(max_bytes) {}
+
+  bool empty() const {
+    return ops.empty();
+  }
+  size_t size() const {
+    return ops.size();
+  }
+
+  /**
+   * Add op @p m carrying @p len bytes of data.
+   *
+   * @returns true if the owner is to call scheduled_flush() once the
+   * batch window has passed
+   */
+  template <typename Send>
+  bool add(ceph::ref_t<Message> m, uint64_t len, Send&& send) {
+    if (len >= max_bytes) {
+      flush(send);
+      send(std::move(m), 1);
+      return false;
+    }
+    ops.push_back(std::move(m));
+    bytes += len;
+    if (ops.size() >= max_ops || bytes >= max_bytes) {
+      flush(send);
+      return false;
+    }
+    if (flush_scheduled) {
+      return false;
+    }
+    flush_scheduled = true;
+    return true;
+  }
+
+  /// send what we have, as a lone op or as one MOSDOpBatch
+  template <typename Send>
+  void flush(Send&& send) {
+    if (ops.empty()) {
+      return;
+    }
+    size_t n = ops.size();
+    if (n == 1) {
+      send(std::move(ops.front()), 1);
+    } else {
+      auto b = ceph::make_message<MOSDOpBatch>();
+      for (auto& m : ops) {
+	b->add_op(std::move(m));
+      }
+      send(std::move(b), n);
+    }
+    ops.clear();
+    bytes = 0;
+  }
+
+  /// the batch window requested by add() has passed
+  template <typename Send>
+  void scheduled_flush(Send&& send) {
+    flush_scheduled = false;
+    flush(send);
+  }
+
+  /// drop what we have; the ops are resent some other way
+  void discard() {
+    ops.clear();
+    bytes = 0;
+  }
+};
+
+#endif
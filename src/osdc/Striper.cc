@@ -116,6 +116,123 @@ void add_partial_sparse_result(
   }
 }
 
+template <bool SingleStripe>
+void map_file_extents(CephContext *cct, const file_layout_t *layout,
+                      uint64_t offset, uint64_t len, uint64_t trunc_size,
+                      uint64_t buffer_offset,
+                      striper::LightweightObjectExtents* object_extents) {
+  /*
+   * we want only one extent per object!  this means that each extent
+   * we read may map into different bits of the final read
+   * buffer.. hence buffer_extents
+   */
+
+  __u32 object_size = layout->object_size;
+  __u32 su = layout->stripe_unit;
+  __u32 stripe_count = layout->stripe_count;
+  ceph_assert(object_size >= su);
+  if constexpr (SingleStripe) {
+    ldout(cct, 20) << " sc is one, reset su to os" << dendl;
+    su = object_size;
+
+    // each object is visited once, in order.  only size a fresh vector:
+    // callers that append once per image extent rely on the geometric
+    // growth of push_back, an exact reserve every call would be quadratic
+    if (len > 0 && object_extents->empty()) {
+      object_extents->reserve((offset + len - 1) / object_size -
+                              offset / object_size + 1);
+    }
+  }
+  uint64_t stripes_per_object = object_size / su;
+  ldout(cct, 20) << " su " << su << " sc " << stripe_count << " os "
+		 << object_size << " stripes_per_object " << stripes_per_object
+		 << dendl;
+
+  uint64_t cur = offset;
+  uint64_t left = len;
+  while (left > 0) {
+    uint64_t objectno;
+    uint64_t x_offset;
+    uint64_t max;
+    if constexpr (SingleStripe) {
+      // the object set is a single object made of a single block
+      objectno = cur / object_size;
+      x_offset = cur % object_size;
+      max = object_size - x_offset;
+
+      ldout(cct, 20) << " off " << cur << " objectno " << objectno
+		     << " " << x_offset << "~" << std::min(left, max)
+		     << dendl;
+    } else {
+      // layout into objects
+      uint64_t blockno = cur / su; // which block
+      // which horizontal stripe (Y)
+      uint64_t stripeno = blockno / stripe_count;
+      // which object in the object set (X)
+      uint64_t stripepos = blockno % stripe_count;
+      // which object set
+      uint64_t objectsetno = stripeno / stripes_per_object;
+      // object id
+      objectno = objectsetno * stripe_count + stripepos;
+
+      // map range into object
+      uint64_t block_start = (stripeno % stripes_per_object) * su;
+      uint64_t block_off = cur % su;
+      max = su - block_off;
+      x_offset = block_start + block_off;
+
+      ldout(cct, 20) << " off " << cur << " blockno " << blockno << " stripeno "
+		     << stripeno << " stripepos " << stripepos << " objectsetno "
+		     << objectsetno << " objectno " << objectno
+		     << " block_start " << block_start << " block_off "
+		     << block_off << " " << x_offset << "~" << std::min(left, max)
+		     << dendl;
+    }
+
+    uint64_t x_len;
+    if (left > max)
+      x_len = max;
+    else
+      x_len = left;
+
+    // extents are kept sorted by object; only search if we are not
+    // simply moving on past the last one
+    striper::LightweightObjectExtent* ex = nullptr;
+    auto it = object_extents->end();
+    if (!object_extents->empty() &&
+        object_extents->back().object_no > objectno) {
+      it = std::upper_bound(object_extents->begin(), object_extents->end(),
+                            objectno, OrderByObject());
+    }
+    striper::LightweightObjectExtents::reverse_iterator rev_it(it);
+    if (rev_it == object_extents->rend() ||
+        rev_it->object_no != objectno ||
+        rev_it->offset + rev_it->length != x_offset) {
+      // expect up to "stripe-width - 1" vector shifts in the worst-case
+      ex = &(*object_extents->emplace(
+        it, objectno, x_offset, x_len,
+        Striper::object_truncate_size(cct, layout, objectno, trunc_size)));
+        ldout(cct, 20) << " added new " << *ex << dendl;
+    } else {
+      ex = &(*rev_it);
+      ceph_assert(ex->offset + ex->length == x_offset);
+
+      ldout(cct, 20) << " adding in to " << *ex << dendl;
+      ex->length += x_len;
+    }
+
+    ex->buffer_extents.emplace_back(cur - offset + buffer_offset, x_len);
+
+    ldout(cct, 15) << "file_to_extents  " << *ex << dendl;
+    // ldout(cct, 0) << "map: ino " << ino << " oid " << ex.oid << " osd "
+    //		  << ex.osd << " offset " << ex.offset << " len " << ex.len
+    //		  << " ... left " << left << dendl;
+
+    left -= x_len;
+    cur += x_len;
+  }
+}
+
 } // anonymous namespace
 
 void Striper::file_to_extents(CephContext *cct, const char *object_format,
@@ -130,6 +247,7 @@ void Striper::file_to_extents(CephContext *cct, const char *object_format,
                   &lightweight_object_extents);
 
   // convert lightweight object extents to heavyweight version
+  auto oloc = OSDMap::file_to_object_locator(*layout);
   extents.reserve(lightweight_object_extents.size());
   for (auto& lightweight_object_extent : lightweight_object_extents) {
     auto& object_extent = extents.emplace_back(
@@ -138,7 +256,7 @@ void Striper::file_to_extents(CephContext *cct, const char *object_format,
       lightweight_object_extent.offset, lightweight_object_extent.length,
       lightweight_object_extent.truncate_size);
 
-    object_extent.oloc = OSDMap::file_to_object_locator(*layout);
+    object_extent.oloc = oloc;
     object_extent.buffer_extents.reserve(
       lightweight_object_extent.buffer_extents.size());
     object_extent.buffer_extents.insert(
@@ -161,6 +279,7 @@ void Striper::file_to_extents(
                   &lightweight_object_extents);
 
   // convert lightweight object extents to heavyweight version
+  auto oloc = OSDMap::file_to_object_locator(*layout);
   for (auto& lightweight_object_extent : lightweight_object_extents) {
     auto oid = format_oid(object_format, lightweight_object_extent.object_no);
     auto& object_extent = object_extents[oid].emplace_back(
@@ -168,7 +287,7 @@ void Striper::file_to_extents(
       lightweight_object_extent.offset, lightweight_object_extent.length,
       lightweight_object_extent.truncate_size);
 
-      object_extent.oloc = OSDMap::file_to_object_locator(*layout);
+      object_extent.oloc = oloc;
       object_extent.buffer_extents.reserve(
         lightweight_object_extent.buffer_extents.size());
       object_extent.buffer_extents.insert(
@@ -185,87 +304,12 @@ void Striper::file_to_extents(
   ldout(cct, 10) << "file_to_extents " << offset << "~" << len << dendl;
   ceph_assert(len > 0);
 
-  /*
-   * we want only one extent per object!  this means that each extent
-   * we read may map into different bits of the final read
-   * buffer.. hence buffer_extents
-   */
-
-  __u32 object_size = layout->object_size;
-  __u32 su = layout->stripe_unit;
-  __u32 stripe_count = layout->stripe_count;
-  ceph_assert(object_size >= su);
-  if (stripe_count == 1) {
-    ldout(cct, 20) << " sc is one, reset su to os" << dendl;
-    su = object_size;
-  }
-  uint64_t stripes_per_object = object_size / su;
-  ldout(cct, 20) << " su " << su << " sc " << stripe_count << " os "
-		 << object_size << " stripes_per_object " << stripes_per_object
-		 << dendl;
-
-  uint64_t cur = offset;
-  uint64_t left = len;
-  while (left > 0) {
-    // layout into objects
-    uint64_t blockno = cur / su; // which block
-    // which horizontal stripe (Y)
-    uint64_t stripeno = blockno / stripe_count;
-    // which object in the object set (X)
-    uint64_t stripepos = blockno % stripe_count;
-    // which object set
-    uint64_t objectsetno = stripeno / stripes_per_object;
-    // object id
-    uint64_t objectno = objectsetno * stripe_count + stripepos;
-
-    // map range into object
-    uint64_t block_start = (stripeno % stripes_per_object) * su;
-    uint64_t block_off = cur % su;
-    uint64_t max = su - block_off;
-
-    uint64_t x_offset = block_start + block_off;
-    uint64_t x_len;
-    if (left > max)
-      x_len = max;
-    else
-      x_len = left;
-
-    ldout(cct, 20) << " off " << cur << " blockno " << blockno << " stripeno "
-		   << stripeno << " stripepos " << stripepos << " objectsetno "
-		   << objectsetno << " objectno " << objectno
-		   << " block_start " << block_start << " block_off "
-		   << block_off << " " << x_offset << "~" << x_len
-		   << dendl;
-
-    striper::LightweightObjectExtent* ex = nullptr;
-    auto it = std::upper_bound(object_extents->begin(), object_extents->end(),
-                               objectno, OrderByObject());
-    striper::LightweightObjectExtents::reverse_iterator rev_it(it);
-    if (rev_it == object_extents->rend() ||
-        rev_it->object_no != objectno ||
-        rev_it->offset + rev_it->length != x_offset) {
-      // expect up to "stripe-width - 1" vector shifts in the worst-case
-      ex = &(*object_extents->emplace(
-        it, objectno, x_offset, x_len,
-        object_truncate_size(cct, layout, objectno, trunc_size)));
-        ldout(cct, 20) << " added new " << *ex << dendl;
-    } else {
-      ex = &(*rev_it);
-      ceph_assert(ex->offset + ex->length == x_offset);
-
-      ldout(cct, 20) << " adding in to " << *ex << dendl;
-      ex->length += x_len;
-    }
-
-    ex->buffer_extents.emplace_back(cur - offset + buffer_offset, x_len);
-
-    ldout(cct, 15) << "file_to_extents  " << *ex << dendl;
-    // ldout(cct, 0) << "map: ino " << ino << " oid " << ex.oid << " osd "
-    //		  << ex.osd << " offset " << ex.offset << " len " << ex.len
-    //		  << " ... left " << left << dendl;
-
-    left -= x_len;
-    cur += x_len;
+  if (layout->stripe_count == 1) {
+    map_file_extents<true>(cct, layout, offset, len, trunc_size,
+                           buffer_offset, object_extents);
+  } else {
+    map_file_extents<false>(cct, layout, offset, len, trunc_size,
+                            buffer_offset, object_extents);
   }
 }
 
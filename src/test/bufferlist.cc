@@ -903,6 +903,51 @@ TEST(BufferListIterator, get_ptr_and_advance)
   ASSERT_EQ(0u, p.get_remaining());
 }
 
+TEST(BufferListIterator, get_contiguous_view)
+{
+  bufferptr a("one", 3);
+  bufferptr b("two", 3);
+  bufferptr c("three", 5);
+  bufferlist bl;
+  bl.append(a);
+  bl.append(b);
+  bl.append(c);
+  char scratch[8];
+  auto p = bl.cbegin();
+  // within the first segment: referenced in place
+  auto view = p.get_contiguous_view(2u, scratch);
+  ASSERT_EQ("on", view);
+  ASSERT_NE(scratch, view.data());
+  // straddling segments: gathered into scratch
+  view = p.get_contiguous_view(5u, scratch);
+  ASSERT_EQ("etwot", view);
+  ASSERT_EQ(scratch, view.data());
+  ASSERT_EQ("hree", p.get_contiguous_view(4u, scratch));
+  ASSERT_EQ(0u, p.get_remaining());
+  ASSERT_THROW(p.get_contiguous_view(1u, scratch), buffer::end_of_buffer);
+}
+
+TEST(BufferListIterator, for_each_fragment)
+{
+  bufferptr a("one", 3);
+  bufferptr b("two", 3);
+  bufferptr c("three", 5);
+  bufferlist bl;
+  bl.append(a);
+  bl.append(b);
+  bl.append(c);
+  auto p = bl.cbegin();
+  p += 1;
+  std::vector<std::string> fragments;
+  p.for_each_fragment(7u, [&](const char *data, size_t len) {
+    fragments.emplace_back(data, len);
+  });
+  ASSERT_EQ((std::vector<std::string>{"ne", "two", "th"}), fragments);
+  ASSERT_EQ(3u, p.get_remaining());
+  ASSERT_THROW(p.for_each_fragment(4u, [](const char*, size_t) {}),
+	       buffer::end_of_buffer);
+}
+
 TEST(BufferListIterator, iterator_crc32c) {
   bufferlist bl1;
   bufferlist bl2;
@@ -1337,6 +1382,39 @@ TEST(BufferList, BenchAlloc) {
   bench_bufferlist_alloc(4, 100000, 16);
 }
 
+void bench_bufferlist_small_encode(int num, int fields)
+{
+  // many tiny encodes into short-lived bufferlists, as message and
+  // transaction encoding does.  with CEPH_BUFFER_NO_SLAB=1 every ptr_node
+  // and append buffer comes from the heap.
+  buffer::track_slab(true);
+  const int hits = buffer::get_slab_hits();
+  const int misses = buffer::get_slab_misses();
+  utime_t start = ceph_clock_now();
+  for (int i=0; i<num; ++i) {
+    bufferlist bl;
+    for (int j=0; j<fields; ++j)
+      encode((uint32_t)j, bl);
+    bufferlist payload;
+    payload.claim_append(bl);
+    payload.append(buffer::create(fields * 4));
+  }
+  utime_t end = ceph_clock_now();
+  buffer::track_slab(false);
+  cout << num << " encodes of " << fields << " fields"
+       << " in " << (end - start)
+       << ", heap allocations/op "
+       << (double)(buffer::get_slab_misses() - misses) / num
+       << ", cached allocations/op "
+       << (double)(buffer::get_slab_hits() - hits) / num << std::endl;
+}
+
+TEST(BufferList, BenchSmallEncode) {
+  bench_bufferlist_small_encode(1000000, 4);
+  bench_bufferlist_small_encode(1000000, 32);
+  bench_bufferlist_small_encode(100000, 256);
+}
+
 /*
  * append_bench tests now have multiple variants:
  *
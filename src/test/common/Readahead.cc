@@ -130,3 +130,71 @@ TEST(Readahead, alignment) {
   ASSERT_RA(1400, 300, r.update(1290, 10, Readahead::NO_LIMIT)); // internal readahead size 320
   ASSERT_RA(0, 0, r.update(1300, 10, Readahead::NO_LIMIT));
 }
+
+TEST(Readahead, interleaved_streams) {
+  Readahead r;
+  r.set_trigger_requests(2);
+  r.set_max_streams(2);
+  ASSERT_RA(0, 0, r.update(1000, 10, Readahead::NO_LIMIT));
+  ASSERT_RA(0, 0, r.update(5000, 10, Readahead::NO_LIMIT));
+  ASSERT_RA(0, 0, r.update(1010, 10, Readahead::NO_LIMIT));
+  ASSERT_RA(0, 0, r.update(5010, 10, Readahead::NO_LIMIT));
+  ASSERT_RA(1030, 20, r.update(1020, 10, Readahead::NO_LIMIT));
+  ASSERT_RA(5030, 20, r.update(5020, 10, Readahead::NO_LIMIT));
+  ASSERT_RA(1050, 40, r.update(1030, 10, Readahead::NO_LIMIT));
+  ASSERT_RA(5050, 40, r.update(5030, 10, Readahead::NO_LIMIT));
+  Readahead::stats_t stats = r.get_stats();
+  ASSERT_EQ(120u, stats.issued_bytes);
+  ASSERT_EQ(20u, stats.hit_bytes);
+  ASSERT_EQ(0u, stats.wasted_bytes);
+
+  // a third stream replaces the least recently used one
+  ASSERT_RA(0, 0, r.update(9000, 10, Readahead::NO_LIMIT));
+  ASSERT_RA(0, 0, r.update(5040, 10, Readahead::NO_LIMIT));
+  ASSERT_RA(0, 0, r.update(1040, 10, Readahead::NO_LIMIT));
+  stats = r.get_stats();
+  ASSERT_EQ(30u, stats.hit_bytes);
+  ASSERT_EQ(50u, stats.wasted_bytes);
+}
+
+TEST(Readahead, interleaved_streams_single) {
+  Readahead r;
+  r.set_trigger_requests(2);
+  ASSERT_RA(0, 0, r.update(1000, 10, Readahead::NO_LIMIT));
+  ASSERT_RA(0, 0, r.update(5000, 10, Readahead::NO_LIMIT));
+  ASSERT_RA(0, 0, r.update(1010, 10, Readahead::NO_LIMIT));
+  ASSERT_RA(0, 0, r.update(5010, 10, Readahead::NO_LIMIT));
+  ASSERT_RA(0, 0, r.update(1020, 10, Readahead::NO_LIMIT));
+  ASSERT_RA(0, 0, r.update(5020, 10, Readahead::NO_LIMIT));
+}
+
+TEST(Readahead, strided) {
+  Readahead r;
+  r.set_trigger_requests(2);
+  r.set_max_stride(100);
+  ASSERT_RA(0, 0, r.update(1000, 10, Readahead::NO_LIMIT));
+  ASSERT_RA(0, 0, r.update(1050, 10, Readahead::NO_LIMIT));
+  ASSERT_RA(0, 0, r.update(1100, 10, Readahead::NO_LIMIT));
+  ASSERT_RA(1160, 100, r.update(1150, 10, Readahead::NO_LIMIT));
+  ASSERT_RA(1260, 200, r.update(1200, 10, Readahead::NO_LIMIT));
+  ASSERT_RA(0, 0, r.update(1250, 10, Readahead::NO_LIMIT));
+  ASSERT_EQ(20u, r.get_stats().hit_bytes);
+
+  // a gap larger than the maximum stride starts over
+  ASSERT_RA(0, 0, r.update(2000, 10, Readahead::NO_LIMIT));
+  ASSERT_RA(0, 0, r.update(2200, 10, Readahead::NO_LIMIT));
+  ASSERT_RA(0, 0, r.update(2400, 10, Readahead::NO_LIMIT));
+}
+
+TEST(Readahead, wasted) {
+  Readahead r;
+  r.set_trigger_requests(2);
+  ASSERT_RA(0, 0, r.update(1000, 10, Readahead::NO_LIMIT));
+  ASSERT_RA(0, 0, r.update(1010, 10, Readahead::NO_LIMIT));
+  ASSERT_RA(1030, 20, r.update(1020, 10, Readahead::NO_LIMIT));
+  ASSERT_RA(0, 0, r.update(5000, 10, Readahead::NO_LIMIT));
+  Readahead::stats_t stats = r.get_stats();
+  ASSERT_EQ(20u, stats.issued_bytes);
+  ASSERT_EQ(0u, stats.hit_bytes);
+  ASSERT_EQ(20u, stats.wasted_bytes);
+}
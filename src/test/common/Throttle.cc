@@ -22,6 +22,7 @@
 #include <stdio.h>
 #include <signal.h>
 
+#include <atomic>
 #include <chrono>
 #include <list>
 #include <mutex>
@@ -30,6 +31,7 @@
 
 #include "gtest/gtest.h"
 #include "common/Thread.h"
+#include "common/ceph_time.h"
 #include "common/Throttle.h"
 #include "common/ceph_argparse.h"
 
@@ -212,6 +214,102 @@ TEST_F(ThrottleTest, wait) {
   } while(!waited);
 }
 
+TEST_F(ThrottleTest, get_put_concurrent) {
+  // more room than the threads can ever ask for, and barely enough for one
+  for (int64_t throttle_max : {1000, 4}) {
+    Throttle throttle(g_ceph_context, "throttle", throttle_max);
+    std::atomic<int64_t> highest = 0;
+    vector<std::thread> threads;
+    for (int t = 0; t < 8; t++) {
+      threads.emplace_back([&throttle, &highest, t] {
+	for (int i = 0; i < 10000; i++) {
+	  int64_t c = 1 + (i + t) % 4;
+	  throttle.get(c);
+	  int64_t cur = throttle.get_current();
+	  int64_t prev = highest;
+	  while (cur > prev && !highest.compare_exchange_weak(prev, cur));
+	  throttle.put(c);
+	}
+      });
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+    ASSERT_EQ(throttle.get_current(), 0);
+    ASSERT_LE(highest, throttle_max);
+  }
+}
+
+TEST_F(ThrottleTest, get_fifo) {
+  int64_t throttle_max = 10;
+  Throttle throttle(g_ceph_context, "throttle", throttle_max);
+  std::atomic<int> small_done = 0;
+  int small_done_before_large = -1;
+
+  ASSERT_FALSE(throttle.get(throttle_max / 2));
+  std::thread large([&] {
+    throttle.get(throttle_max);
+    small_done_before_large = small_done;
+    throttle.put(throttle_max);
+  });
+  // get_or_fail() stops succeeding once the large get() is queued
+  while (throttle.get_or_fail(1)) {
+    throttle.put(1);
+    usleep(1);
+  }
+  // small gets that would fit must not overtake the queued large one
+  vector<std::thread> small;
+  for (int t = 0; t < 4; t++) {
+    small.emplace_back([&] {
+      for (int i = 0; i < 1000; i++) {
+	throttle.get(1);
+	throttle.put(1);
+	small_done++;
+      }
+    });
+  }
+  usleep(1000);
+  ASSERT_EQ(throttle.put(throttle_max / 2), 0);
+  large.join();
+  for (auto& t : small) {
+    t.join();
+  }
+  ASSERT_EQ(small_done_before_large, 0);
+  ASSERT_EQ(throttle.get_current(), 0);
+}
+
+TEST(ThrottleBench, DISABLED_get_put)
+{
+  constexpr int nops = 200000;
+  // room for everybody, so that only the lockless path is taken, vs. room
+  // for one or two in-flight gets, so that most of them queue up
+  for (int64_t throttle_max : {1 << 20, 2}) {
+    for (int nthreads : {1, 2, 4, 8, 16}) {
+      Throttle throttle(g_ceph_context, "throttle_bench", throttle_max);
+      auto start = ceph::mono_clock::now();
+      vector<std::thread> threads;
+      for (int t = 0; t < nthreads; t++) {
+	threads.emplace_back([&throttle] {
+	  for (int i = 0; i < nops; i++) {
+	    throttle.get(1);
+	    throttle.put(1);
+	  }
+	});
+      }
+      for (auto& t : threads) {
+	t.join();
+      }
+      auto elapsed = ceph::mono_clock::now() - start;
+      ASSERT_EQ(throttle.get_current(), 0);
+      cout << "max " << throttle_max << ", " << nthreads << " threads: "
+	   << (uint64_t)nthreads * nops * 1000 /
+	        std::max<uint64_t>(1, std::chrono::duration_cast<
+				       std::chrono::microseconds>(elapsed).count())
+	   << " get+put/ms" << std::endl;
+    }
+  }
+}
+
 std::pair<double, std::chrono::duration<double> > test_backoff(
   double low_threshhold,
   double high_threshhold,
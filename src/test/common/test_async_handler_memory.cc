@@ -0,0 +1,146 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include "common/async/handler_memory.h"
+
+#include <cstdint>
+#include <optional>
+#include <boost/asio/any_completion_handler.hpp>
+#include <boost/asio/append.hpp>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/defer.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#include <gtest/gtest.h>
+
+namespace ceph::async {
+
+namespace asio = boost::asio;
+using boost::system::error_code;
+
+using Signature = void(error_code);
+using Handler = asio::any_completion_handler<Signature>;
+
+template <typename T>
+auto capture(std::optional<T>& opt)
+{
+  return [&opt] (T value) { opt = std::move(value); };
+}
+
+// an operation that type-erases its handler, like neorados does
+template <typename CompletionToken>
+auto async_store(std::optional<Handler>& handler, CompletionToken&& token)
+{
+  return asio::async_initiate<CompletionToken, Signature>(
+      [&handler] (auto h) { handler.emplace(std::move(h)); }, token);
+}
+
+void complete(asio::io_context& ctx, std::optional<Handler>& handler)
+{
+  asio::defer(ctx.get_executor(),
+              asio::append(std::move(*handler), error_code{}));
+  handler.reset();
+}
+
+TEST(handler_memory, allocator)
+{
+  handler_memory<64, 2> memory;
+  auto alloc = memory.get_allocator();
+  using char_alloc = std::allocator_traits<
+      decltype(alloc)>::rebind_alloc<char>;
+  char_alloc a{alloc};
+
+  char* p1 = a.allocate(64);
+  char* p2 = a.allocate(32);
+  EXPECT_EQ(2u, memory.slots_in_use());
+  // every slot is aligned for any type
+  EXPECT_EQ(0u, reinterpret_cast<std::uintptr_t>(p1) % alignof(std::max_align_t));
+  EXPECT_EQ(0u, reinterpret_cast<std::uintptr_t>(p2) % alignof(std::max_align_t));
+  char* p3 = a.allocate(16); // all slots busy
+  char* p4 = a.allocate(128); // too big
+  EXPECT_EQ(2u, memory.slots_in_use());
+
+  a.deallocate(p3, 16);
+  a.deallocate(p4, 128);
+  a.deallocate(p1, 64);
+  EXPECT_EQ(1u, memory.slots_in_use());
+  char* p5 = a.allocate(8);
+  EXPECT_EQ(p1, p5);
+  a.deallocate(p5, 8);
+  a.deallocate(p2, 32);
+  EXPECT_EQ(0u, memory.slots_in_use());
+}
+
+TEST(handler_memory, any_completion_handler)
+{
+  asio::io_context ctx;
+  handler_memory<> memory;
+  std::optional<Handler> handler;
+
+  std::optional<error_code> result;
+  async_store(handler, bind_handler_memory(memory, capture(result)));
+  ASSERT_TRUE(handler);
+  EXPECT_EQ(1u, memory.slots_in_use());
+
+  complete(ctx, handler);
+  EXPECT_EQ(2u, memory.slots_in_use()); // handler + deferred operation
+
+  ctx.poll();
+  ASSERT_TRUE(result);
+  EXPECT_FALSE(*result);
+  EXPECT_EQ(0u, memory.slots_in_use());
+}
+
+TEST(handler_memory, coroutine)
+{
+  asio::io_context ctx;
+  handler_memory<> memory;
+  std::optional<Handler> handler;
+
+  constexpr int count = 3;
+  auto cr = [&] () -> asio::awaitable<void> {
+    for (int i = 0; i < count; ++i) {
+      co_await async_store(handler, bind_handler_memory(memory,
+                                                        asio::use_awaitable));
+    }
+  };
+  std::optional<std::exception_ptr> result;
+  asio::co_spawn(ctx, cr(), capture(result));
+
+  for (int i = 0; i < count; ++i) {
+    ctx.poll();
+    ctx.restart();
+    ASSERT_TRUE(handler);
+    EXPECT_EQ(1u, memory.slots_in_use());
+    complete(ctx, handler);
+  }
+  ctx.poll();
+  ASSERT_TRUE(result);
+  EXPECT_FALSE(*result);
+  EXPECT_EQ(0u, memory.slots_in_use());
+}
+
+TEST(handler_memory, outlive_memory)
+{
+  std::optional<Handler> handler;
+  std::optional<error_code> result;
+  {
+    handler_memory<> memory;
+    async_store(handler, bind_handler_memory(memory, capture(result)));
+    ASSERT_TRUE(handler);
+  }
+  // releases its slot after the handler_memory is gone
+  handler.reset();
+  EXPECT_FALSE(result);
+}
+
+} // namespace ceph::async
@@ -0,0 +1,78 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include <atomic>
+#include <list>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "common/Finisher.h"
+#include "global/global_context.h"
+
+TEST(ShardedFinisher, per_key_order)
+{
+  constexpr unsigned nkeys = 16;
+  constexpr unsigned nqueuers = 4;
+  constexpr unsigned per_key = 5000;
+  ShardedFinisher fin(g_ceph_context, "test_sharded", "tfin", 4);
+  fin.start();
+
+  // each key is queued to by a single thread, so its order is well defined
+  std::vector<std::vector<unsigned>> seen(nkeys);
+  std::vector<std::thread> queuers;
+  for (unsigned q = 0; q < nqueuers; q++) {
+    queuers.emplace_back([&, q] {
+      for (unsigned n = 0; n < per_key; n++) {
+	for (unsigned k = q; k < nkeys; k += nqueuers) {
+	  if (n % 2) {
+	    fin.queue(k, new LambdaContext([&seen, k, n](int) {
+	      seen[k].push_back(n);
+	    }));
+	  } else {
+	    std::list<Context*> ls;
+	    ls.push_back(new LambdaContext([&seen, k, n](int) {
+	      seen[k].push_back(n);
+	    }));
+	    fin.queue(k, ls);
+	    ASSERT_TRUE(ls.empty());
+	  }
+	}
+      }
+    });
+  }
+  for (auto& t : queuers) {
+    t.join();
+  }
+  fin.wait_for_empty();
+  ASSERT_TRUE(fin.is_empty());
+  for (unsigned k = 0; k < nkeys; k++) {
+    ASSERT_EQ(per_key, seen[k].size());
+    for (unsigned n = 0; n < per_key; n++) {
+      ASSERT_EQ(n, seen[k][n]);
+    }
+  }
+  fin.stop();
+}
+
+TEST(ShardedFinisher, stop_drains)
+{
+  ShardedFinisher fin(g_ceph_context, "test_sharded_stop", "tfin", 2);
+  fin.start();
+  std::atomic<unsigned> done = 0;
+  for (unsigned i = 0; i < 1000; i++) {
+    fin.queue(i, new LambdaContext([&done](int r) {
+      ASSERT_EQ(-EAGAIN, r);
+      ++done;
+    }), -EAGAIN);
+  }
+  fin.stop();
+  ASSERT_EQ(1000u, done);
+
+  // and it can be restarted
+  fin.start();
+  fin.queue(0, new LambdaContext([&done](int) { ++done; }));
+  fin.wait_for_empty();
+  ASSERT_EQ(1001u, done);
+  fin.stop();
+}
@@ -0,0 +1,132 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "common/TrackedOp.h"
+#include "global/global_context.h"
+
+class TestOp : public TrackedOp {
+public:
+  using Ref = boost::intrusive_ptr<TestOp>;
+
+  explicit TestOp(OpTracker *tracker)
+    : TrackedOp(tracker, ceph_clock_now()) {}
+
+  bool is_light() const {
+    std::lock_guard l(lock);
+    return light;
+  }
+  std::vector<std::string> get_events() const {
+    std::lock_guard l(lock);
+    _expand_light_events();
+    std::vector<std::string> ret;
+    for (auto& e : events) {
+      ret.push_back(e.str);
+    }
+    return ret;
+  }
+
+private:
+  void _dump_op_descriptor(std::ostream& stream) const override {
+    stream << "test op " << seq;
+  }
+};
+
+class TrackedOpTest : public ::testing::Test {
+public:
+  OpTracker tracker{g_ceph_context, true, 1};
+
+  TestOp::Ref start_op() {
+    TestOp::Ref op(new TestOp(&tracker));
+    op->tracking_start();
+    return op;
+  }
+  void TearDown() override {
+    tracker.on_shutdown();
+  }
+};
+
+TEST_F(TrackedOpTest, sample_rate)
+{
+  tracker.set_sampling(4, 0);
+  std::vector<TestOp::Ref> ops;
+  unsigned sampled = 0;
+  for (int i = 0; i < 16; i++) {
+    ops.push_back(start_op());
+    sampled += !ops.back()->is_light();
+  }
+  ASSERT_EQ(4u, sampled);
+
+  // everything is sampled at rate 1
+  tracker.set_sampling(1, 0);
+  for (int i = 0; i < 4; i++) {
+    ASSERT_FALSE(start_op()->is_light());
+  }
+}
+
+TEST_F(TrackedOpTest, light_events)
+{
+  tracker.set_sampling(1000000, 0);
+  auto op = start_op();
+  ASSERT_TRUE(op->is_light());
+  op->mark_event("queued_for_pg");
+  op->mark_event("a rather long event name that gets truncated");
+  ASSERT_EQ("a rather long event nam", op->state_string());
+  // looking at the events turns them into regular ones
+  ASSERT_FALSE(op->is_light());
+  ASSERT_EQ((std::vector<std::string>{
+	"initiated", "queued_for_pg", "a rather long event nam"}),
+    op->get_events());
+  // and later events are kept in full
+  op->mark_event("a rather long event name that is kept in full");
+  ASSERT_EQ("a rather long event name that is kept in full",
+	    op->state_string());
+}
+
+TEST_F(TrackedOpTest, light_events_overflow)
+{
+  tracker.set_sampling(1000000, 0);
+  auto op = start_op();
+  for (int i = 0; i < 40; i++) {
+    op->mark_event("event " + std::to_string(i));
+  }
+  op->mark_event("done");
+  // the latest event survives a full array
+  auto events = op->get_events();
+  ASSERT_EQ(16u, events.size());
+  ASSERT_EQ("initiated", events.front());
+  ASSERT_EQ("done", events.back());
+  ASSERT_LT(op->get_duration(), 60.0);
+}
+
+TEST_F(TrackedOpTest, history_threshold)
+{
+  tracker.set_sampling(1000000, 3600);
+  auto light = start_op();
+  ASSERT_TRUE(light->is_light());
+  // only unsampled ops slower than the threshold make it to the history
+  ASSERT_FALSE(tracker.want_history_op(*light));
+  tracker.set_sampling(1000000, 0);
+  ASSERT_TRUE(tracker.want_history_op(*light));
+
+  tracker.set_sampling(1, 3600);
+  auto sampled = start_op();
+  ASSERT_FALSE(sampled->is_light());
+  ASSERT_TRUE(tracker.want_history_op(*sampled));
+
+  tracker.set_tracking(false);
+  ASSERT_FALSE(tracker.want_history_op(*sampled));
+  tracker.set_tracking(true);
+}
@@ -13,6 +13,7 @@
  */
 
 #include <filesystem>
+#include <fstream>
 
 #include "gtest/gtest.h"
 #include "common/ceph_context.h"
@@ -39,4 +40,75 @@ TEST(util, collect_sys_info)
   ASSERT_TRUE(sys_info.find("distro_description") != sys_info.end());
 }
 
+// a fake /proc and /sys for the cgroup v2 and PSI readers
+class CgroupTest : public ::testing::Test {
+protected:
+  fs::path root;
+  fs::path cgdir;
+
+  void SetUp() override {
+    std::string tmpl = (fs::temp_directory_path() / "test_util.XXXXXX");
+    ASSERT_NE(nullptr, mkdtemp(tmpl.data()));
+    root = tmpl;
+    cgdir = root / "sys/fs/cgroup/system.slice/ceph-osd@0.service";
+    fs::create_directories(root / "proc/self");
+    fs::create_directories(cgdir);
+    write(root / "proc/self/cgroup",
+	  "12:memory:/system.slice/ceph-osd@0.service\n"
+	  "0::/system.slice/ceph-osd@0.service\n");
+  }
+  void TearDown() override {
+    fs::remove_all(root);
+  }
+  static void write(const fs::path& p, const std::string& content) {
+    std::ofstream f{p};
+    f << content;
+  }
+};
+
+TEST_F(CgroupTest, memory_usage)
+{
+  uint64_t current = 0, max = 0;
+  // no memory controller enabled for us
+  ASSERT_EQ(-ENOENT, get_cgroup_memory_usage(&current, &max, root));
+
+  write(cgdir / "memory.current", "123456\n");
+  write(cgdir / "memory.max", "1073741824\n");
+  ASSERT_EQ(0, get_cgroup_memory_usage(&current, &max, root));
+  ASSERT_EQ(123456u, current);
+  ASSERT_EQ(1073741824u, max);
+
+  write(cgdir / "memory.max", "max\n");
+  ASSERT_EQ(0, get_cgroup_memory_usage(&current, &max, root));
+  ASSERT_EQ(0u, max);
+
+  write(cgdir / "memory.max", "12x\n");
+  ASSERT_EQ(-EINVAL, get_cgroup_memory_usage(&current, &max, root));
+
+  // cgroup v1 only
+  write(root / "proc/self/cgroup",
+	"12:memory:/system.slice/ceph-osd@0.service\n");
+  ASSERT_EQ(-ENOENT, get_cgroup_memory_usage(&current, &max, root));
+}
+
+TEST_F(CgroupTest, memory_pressure)
+{
+  double avg10 = 0;
+  // the system wide numbers are of no interest
+  fs::create_directories(root / "proc/pressure");
+  write(root / "proc/pressure/memory",
+	"some avg10=50.00 avg60=0.00 avg300=0.00 total=0\n");
+  ASSERT_EQ(-ENOENT, get_memory_pressure(&avg10, root));
+
+  write(cgdir / "memory.pressure",
+	"some avg10=12.34 avg60=1.00 avg300=0.10 total=123456\n"
+	"full avg10=5.00 avg60=0.50 avg300=0.05 total=23456\n");
+  ASSERT_EQ(0, get_memory_pressure(&avg10, root));
+  ASSERT_DOUBLE_EQ(12.34, avg10);
+
+  write(cgdir / "memory.pressure",
+	"full avg10=5.00 avg60=0.50 avg300=0.05 total=23456\n");
+  ASSERT_EQ(-EINVAL, get_memory_pressure(&avg10, root));
+}
+
 #endif
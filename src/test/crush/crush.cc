@@ -378,6 +378,43 @@ TEST_P(IndepTest, out_progressive) {
 
 }
 
+TEST_P(IndepTest, result_cache) {
+  std::unique_ptr<CrushWrapper> c(build_indep_map(cct, 3, 3, 3));
+  c->enable_result_cache(10);
+  vector<__u32> weight(c->get_max_devices(), 0x10000);
+
+  for (int pass = 0; pass < 2; ++pass) {
+    for (int x = 0; x < 100; ++x) {
+      vector<int> out, cached;
+      c->do_rule(0, x, out, 5, weight, 0);
+      c->do_rule_cached(0, x, cached, 5, weight, 0, 1);
+      ASSERT_EQ(out, cached);
+    }
+  }
+  const CrushResultCache *cache = c->get_result_cache();
+  ASSERT_EQ(200u, cache->get_hits() + cache->get_misses());
+  ASSERT_LT(0u, cache->get_hits());
+
+  // a new weights generation must not return the old mapping
+  for (int x = 0; x < 100; ++x) {
+    vector<int> out;
+    c->do_rule_cached(0, x, out, 5, weight, 0, 1);
+    weight[out[0]] = 0;
+    vector<int> expected, cached;
+    c->do_rule(0, x, expected, 5, weight, 0);
+    c->do_rule_cached(0, x, cached, 5, weight, 0, 2 + x);
+    ASSERT_EQ(expected, cached);
+    weight[out[0]] = 0x10000;
+  }
+
+  // nor may anything survive invalidation
+  uint64_t hits = cache->get_hits();
+  c->invalidate_result_cache();
+  vector<int> out;
+  c->do_rule_cached(0, 0, out, 5, weight, 0, 1);
+  ASSERT_EQ(hits, cache->get_hits());
+}
+
 INSTANTIATE_TEST_SUITE_P(
   IndepTest,
   IndepTest,
@@ -216,7 +216,7 @@ TEST_F(TestSimplePolicy, test_evict_list_0) {
   ASSERT_TRUE(evict_entry_list.size() == 0);
 }
 
-TEST_F(TestSimplePolicy, test_evict_list_10) {
+TEST_F(TestSimplePolicy, test_evict_list_to_low_watermark) {
   uint64_t left_entry_num = m_cache_size - m_promoted_lru.size();
   for (uint64_t i = 0; i < left_entry_num; i++, ++m_entry_index) {
     insert_entry_into_promoted_lru(generate_file_name(m_entry_index));
@@ -224,12 +224,37 @@ TEST_F(TestSimplePolicy, test_evict_list_10) {
   ASSERT_TRUE(0 == m_simple_policy->get_free_size());
   std::list<std::string> evict_entry_list;
   m_simple_policy->get_evict_list(&evict_entry_list);
-  // evict 10% of old entries
-  ASSERT_TRUE(m_cache_size*0.1 == evict_entry_list.size());
-  ASSERT_TRUE(m_cache_size - m_cache_size*0.1  == m_simple_policy->get_promoted_entry_num());
+  // evict old entries until back under 90% of the water mark
+  uint64_t low_watermark = m_cache_size * 0.9 * 0.9;
+  ASSERT_EQ(m_cache_size - low_watermark, evict_entry_list.size());
+  ASSERT_EQ(low_watermark, m_simple_policy->get_promoted_entry_num());
 
   for (auto it = evict_entry_list.begin(); it != evict_entry_list.end(); it++) {
     ASSERT_TRUE(*it == m_promoted_lru.front());
     m_promoted_lru.erase(m_promoted_lru.begin());
   }
 }
+
+TEST_F(TestSimplePolicy, test_evict_list_by_size) {
+  // one large object takes the cache over the water mark
+  uint64_t large_size = m_simple_policy->get_free_size() - 2;
+  std::string large_file_name = generate_file_name(m_entry_index++);
+  ASSERT_EQ(OBJ_CACHE_NONE, m_simple_policy->lookup_object(large_file_name));
+  m_simple_policy->update_status(large_file_name, OBJ_CACHE_PROMOTED,
+                                 large_size);
+  ASSERT_EQ(OBJ_CACHE_PROMOTED, m_simple_policy->lookup_object(large_file_name));
+
+  // only as many of the small cold entries as needed are evicted
+  std::list<std::string> evict_entry_list;
+  m_simple_policy->get_evict_list(&evict_entry_list);
+  uint64_t low_watermark = m_cache_size * 0.9 * 0.9;
+  ASSERT_EQ(m_cache_size - 2 - low_watermark, evict_entry_list.size());
+  for (auto& file_name : evict_entry_list) {
+    ASSERT_EQ(m_promoted_lru.front(), file_name);
+    m_simple_policy->evict_entry(file_name);
+    m_promoted_lru.erase(m_promoted_lru.begin());
+  }
+  ASSERT_EQ(m_cache_size - low_watermark,
+            m_simple_policy->get_free_size());
+  m_promoted_lru.push_back(large_file_name);
+}
@@ -2466,3 +2466,85 @@ TEST(LibRadosAio, MultiReads) {
     ASSERT_EQ(0, memcmp(buf, bl.c_str(), sizeof(buf)));
   }
 }
+
+TEST(LibRadosAio, OperateBatchPP) {
+  AioTestDataPP test_data;
+  ASSERT_EQ("", test_data.init());
+  constexpr int num_objs = 16;
+
+  std::deque<ObjectWriteOperation> wops;
+  std::vector<std::pair<std::string, ObjectWriteOperation*>> writes;
+  for (int i = 0; i < num_objs; ++i) {
+    bufferlist bl;
+    bl.append("obj" + std::to_string(i));
+    auto& op = wops.emplace_back();
+    op.write_full(bl);
+    writes.emplace_back("batch" + std::to_string(i), &op);
+  }
+  std::vector<int> rvals;
+  auto wc = std::unique_ptr<AioCompletion>{Rados::aio_create_completion()};
+  ASSERT_TRUE(wc);
+  ASSERT_EQ(0, test_data.m_ioctx.aio_operate_batch(wc.get(), writes, &rvals, 0));
+  {
+    TestAlarm alarm;
+    ASSERT_EQ(0, wc->wait_for_complete());
+  }
+  ASSERT_EQ(0, wc->get_return_value());
+  ASSERT_EQ(std::vector<int>(num_objs, 0), rvals);
+
+  std::deque<ObjectReadOperation> rops;
+  std::deque<bufferlist> bls;
+  std::vector<std::pair<std::string, ObjectReadOperation*>> reads;
+  for (int i = 0; i < num_objs; ++i) {
+    auto& op = rops.emplace_back();
+    op.read(0, 0, &bls.emplace_back(), nullptr);
+    reads.emplace_back("batch" + std::to_string(i), &op);
+  }
+  auto rc = std::unique_ptr<AioCompletion>{Rados::aio_create_completion()};
+  ASSERT_TRUE(rc);
+  ASSERT_EQ(0, test_data.m_ioctx.aio_operate_batch(rc.get(), reads, &rvals, 0));
+  {
+    TestAlarm alarm;
+    ASSERT_EQ(0, rc->wait_for_complete());
+  }
+  ASSERT_EQ(0, rc->get_return_value());
+  ASSERT_EQ(std::vector<int>(num_objs, 0), rvals);
+  for (int i = 0; i < num_objs; ++i) {
+    ASSERT_EQ("obj" + std::to_string(i), bls[i].to_str());
+  }
+}
+
+TEST(LibRadosAio, OperateBatchErrorPP) {
+  AioTestDataPP test_data;
+  ASSERT_EQ("", test_data.init());
+  bufferlist bl;
+  bl.append("exists");
+  ASSERT_EQ(0, test_data.m_ioctx.write_full("batch_exists", bl));
+
+  ObjectReadOperation op1, op2;
+  uint64_t size = 0;
+  op1.stat(&size, nullptr, nullptr);
+  op2.stat(nullptr, nullptr, nullptr);
+  std::vector<std::pair<std::string, ObjectReadOperation*>> reads = {
+    {"batch_exists", &op1},
+    {"batch_missing", &op2},
+  };
+  std::vector<int> rvals;
+  auto c = std::unique_ptr<AioCompletion>{Rados::aio_create_completion()};
+  ASSERT_TRUE(c);
+  ASSERT_EQ(0, test_data.m_ioctx.aio_operate_batch(c.get(), reads, &rvals, 0));
+  {
+    TestAlarm alarm;
+    ASSERT_EQ(0, c->wait_for_complete());
+  }
+  ASSERT_EQ(-ENOENT, c->get_return_value());
+  ASSERT_EQ(2u, rvals.size());
+  ASSERT_EQ(0, rvals[0]);
+  ASSERT_EQ(-ENOENT, rvals[1]);
+  ASSERT_EQ(bl.length(), size);
+
+  auto c2 = std::unique_ptr<AioCompletion>{Rados::aio_create_completion()};
+  std::vector<std::pair<std::string, ObjectReadOperation*>> none;
+  ASSERT_EQ(-EINVAL, test_data.m_ioctx.aio_operate_batch(c2.get(), none,
+							  nullptr, 0));
+}
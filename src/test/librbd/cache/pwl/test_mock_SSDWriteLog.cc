@@ -11,6 +11,8 @@
 #include "librbd/cache/pwl/ImageCacheState.h"
 #include "librbd/cache/pwl/Types.h"
 #include "librbd/cache/ImageWriteback.h"
+#include "librbd/api/Io.h"
+#include "librbd/io/ReadResult.h"
 #include "librbd/plugin/Api.h"
 
 namespace librbd {
@@ -629,6 +631,86 @@ TEST_F(TestMockCacheSSDWriteLog, flush) {
   ASSERT_EQ(0, finish_ctx3.wait());
 }
 
+TEST_F(TestMockCacheSSDWriteLog, coalesce_writeback) {
+  MockSSDWriteLog::CoalescedWriteback wb;
+  wb.image_offset = 4096;
+  wb.bl.append(std::string(4096, '1'));
+
+  // only an entry that starts where the write ends joins it
+  ASSERT_TRUE(wb.can_append(8192, 4096));
+  ASSERT_FALSE(wb.can_append(6144, 4096));
+  ASSERT_FALSE(wb.can_append(4096, 4096));
+  ASSERT_FALSE(wb.can_append(0, 4096));
+  ASSERT_FALSE(wb.can_append(12288, 4096));
+
+  // adjacent entries are merged up to MAX_COALESCED_WRITEBACK_BYTES
+  uint64_t entries = 1;
+  while (wb.can_append(wb.image_offset + wb.bl.length(), 4096)) {
+    wb.bl.append(std::string(4096, '1'));
+    ++entries;
+  }
+  ASSERT_EQ(MAX_COALESCED_WRITEBACK_BYTES, wb.bl.length());
+  ASSERT_EQ(MAX_COALESCED_WRITEBACK_BYTES / 4096, entries);
+  ASSERT_FALSE(wb.can_append(wb.image_offset + wb.bl.length(), 1));
+}
+
+TEST_F(TestMockCacheSSDWriteLog, flush_coalesced) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  MockImageCtx mock_image_ctx(*ictx);
+  MockImageWriteback mock_image_writeback(mock_image_ctx);
+  MockApi mock_api;
+  MockSSDWriteLog ssd(
+      mock_image_ctx, get_cache_state(mock_image_ctx, mock_api),
+      mock_image_writeback, mock_api);
+
+  expect_op_work_queue(mock_image_ctx);
+  expect_metadata_set(mock_image_ctx);
+
+  MockContextSSD finish_ctx1;
+  expect_context_complete(finish_ctx1, 0);
+  ssd.init(&finish_ctx1);
+  ASSERT_EQ(0, finish_ctx1.wait());
+
+  // three adjacent writes, then one overlapping the last two
+  std::vector<std::pair<Extent, char>> writes{
+    {{0, 4096}, '1'}, {{4096, 4096}, '2'}, {{8192, 4096}, '3'},
+    {{6144, 4096}, '4'}};
+  bufferlist expected_bl;
+  expected_bl.append(std::string(4096, '1'));
+  expected_bl.append(std::string(2048, '2'));
+  expected_bl.append(std::string(4096, '4'));
+  expected_bl.append(std::string(2048, '3'));
+
+  for (auto& [extent, c] : writes) {
+    MockContextSSD finish_ctx2;
+    expect_context_complete(finish_ctx2, 0);
+    bufferlist bl;
+    bl.append(std::string(extent.second, c));
+    ssd.write({extent}, std::move(bl), 0, &finish_ctx2);
+    ASSERT_EQ(0, finish_ctx2.wait());
+  }
+
+  MockContextSSD finish_ctx_flush;
+  expect_context_complete(finish_ctx_flush, 0);
+  ssd.flush(&finish_ctx_flush);
+  ASSERT_EQ(0, finish_ctx_flush.wait());
+
+  // the image got the data in log order, however it was written back
+  bufferlist read_bl;
+  ASSERT_EQ(static_cast<ssize_t>(expected_bl.length()),
+            api::Io<>::read(*ictx, 0, expected_bl.length(),
+                            io::ReadResult{&read_bl}, 0));
+  ASSERT_TRUE(expected_bl.contents_equal(read_bl));
+
+  MockContextSSD finish_ctx3;
+  expect_context_complete(finish_ctx3, 0);
+  ssd.shut_down(&finish_ctx3);
+
+  ASSERT_EQ(0, finish_ctx3.wait());
+}
+
 TEST_F(TestMockCacheSSDWriteLog, flush_source_shutdown) {
   librbd::ImageCtx *ictx;
   ASSERT_EQ(0, open_image(m_image_name, &ictx));
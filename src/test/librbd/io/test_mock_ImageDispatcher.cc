@@ -0,0 +1,233 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "test/librbd/test_mock_fixture.h"
+#include "test/librbd/test_support.h"
+#include "test/librbd/mock/MockImageCtx.h"
+#include "test/librbd/mock/io/MockImageDispatch.h"
+#include "librbd/io/ImageDispatch.h"
+#include "librbd/io/ImageDispatchSpec.h"
+#include "librbd/io/QosImageDispatch.h"
+#include "librbd/io/QueueImageDispatch.h"
+#include "librbd/io/RefreshImageDispatch.h"
+#include "librbd/io/Utils.h"
+#include "librbd/io/WriteBlockImageDispatch.h"
+#include <vector>
+
+namespace librbd {
+namespace {
+
+struct MockTestImageCtx : public MockImageCtx {
+  MockTestImageCtx(ImageCtx &image_ctx) : MockImageCtx(image_ctx) {
+  }
+};
+
+} // anonymous namespace
+
+namespace io {
+
+// records the layers that requests were dispatched to
+struct MockTestImageDispatch : public MockImageDispatch {
+  static std::vector<ImageDispatchLayer> s_dispatched;
+
+  ImageDispatchLayer dispatch_layer;
+
+  MockTestImageDispatch(ImageDispatchLayer dispatch_layer)
+    : dispatch_layer(dispatch_layer) {
+  }
+
+  ImageDispatchLayer get_dispatch_layer() const override {
+    return dispatch_layer;
+  }
+
+  void shut_down(Context* on_finish) override {
+    on_finish->complete(0);
+  }
+
+  bool write(
+      AioCompletion* aio_comp, Extents &&image_extents, bufferlist &&bl,
+      int op_flags, const ZTracer::Trace &parent_trace,
+      uint64_t tid, std::atomic<uint32_t>* image_dispatch_flags,
+      DispatchResult* dispatch_result, Context** on_finish,
+      Context* on_dispatched) override {
+    s_dispatched.push_back(dispatch_layer);
+    return false;
+  }
+
+  bool flush(
+      AioCompletion* aio_comp, FlushSource flush_source,
+      const ZTracer::Trace &parent_trace, uint64_t tid,
+      std::atomic<uint32_t>* image_dispatch_flags,
+      DispatchResult* dispatch_result, Context** on_finish,
+      Context* on_dispatched) override {
+    s_dispatched.push_back(dispatch_layer);
+    return false;
+  }
+};
+
+std::vector<ImageDispatchLayer> MockTestImageDispatch::s_dispatched;
+
+template <>
+struct ImageDispatch<MockTestImageCtx> : public MockTestImageDispatch {
+  ImageDispatch(MockTestImageCtx*)
+    : MockTestImageDispatch(IMAGE_DISPATCH_LAYER_CORE) {
+  }
+};
+
+template <>
+struct QueueImageDispatch<MockTestImageCtx> : public MockTestImageDispatch {
+  QueueImageDispatch(MockTestImageCtx*)
+    : MockTestImageDispatch(IMAGE_DISPATCH_LAYER_QUEUE) {
+  }
+};
+
+template <>
+struct QosImageDispatch<MockTestImageCtx> : public MockTestImageDispatch {
+  uint64_t qos_enabled_flag = 0;
+
+  QosImageDispatch(MockTestImageCtx*)
+    : MockTestImageDispatch(IMAGE_DISPATCH_LAYER_QOS) {
+  }
+
+  void apply_qos_schedule_tick_min(uint64_t tick) {
+  }
+  void apply_qos_limit(uint64_t flag, uint64_t limit, uint64_t burst,
+                       uint64_t burst_seconds) {
+    if (limit != 0) {
+      qos_enabled_flag |= flag;
+    } else {
+      qos_enabled_flag &= ~flag;
+    }
+  }
+  void apply_qos_exclude_ops(uint64_t exclude_ops) {
+  }
+  bool is_enabled() const {
+    return qos_enabled_flag != 0;
+  }
+};
+
+template <>
+struct RefreshImageDispatch<MockTestImageCtx> : public MockTestImageDispatch {
+  RefreshImageDispatch(MockTestImageCtx*)
+    : MockTestImageDispatch(IMAGE_DISPATCH_LAYER_REFRESH) {
+  }
+};
+
+template <>
+struct WriteBlockImageDispatch<MockTestImageCtx>
+  : public MockTestImageDispatch {
+  WriteBlockImageDispatch(MockTestImageCtx*)
+    : MockTestImageDispatch(IMAGE_DISPATCH_LAYER_WRITE_BLOCK) {
+  }
+
+  bool writes_blocked() const {
+    return false;
+  }
+  int block_writes() {
+    return 0;
+  }
+  void block_writes(Context *on_blocked) {
+    on_blocked->complete(0);
+  }
+  void unblock_writes() {
+  }
+  void wait_on_writes_unblocked(Context *on_unblocked) {
+    on_unblocked->complete(0);
+  }
+};
+
+namespace util {
+
+template <>
+int clip_request(MockTestImageCtx* image_ctx, Extents* image_extents,
+                 ImageArea area) {
+  return 0;
+}
+
+} // namespace util
+} // namespace io
+} // namespace librbd
+
+#include "librbd/io/ImageDispatcher.cc"
+
+namespace librbd {
+namespace io {
+
+template <>
+void ImageDispatcher<MockTestImageCtx>::shut_down(Context* on_finish) {
+  Dispatcher<MockTestImageCtx, ImageDispatcherInterface>::shut_down(on_finish);
+}
+
+struct TestMockIoImageDispatcher : public TestMockFixture {
+  typedef ImageDispatcher<MockTestImageCtx> MockTestImageDispatcher;
+
+  // stands in for the image the dispatch specs are created against
+  struct DispatcherImageCtx {
+    ImageDispatcherInterface* io_image_dispatcher;
+  };
+
+  std::vector<ImageDispatchLayer> send(
+      MockTestImageDispatcher& mock_image_dispatcher, bool flush) {
+    MockTestImageDispatch::s_dispatched.clear();
+
+    DispatcherImageCtx image_ctx{&mock_image_dispatcher};
+    auto aio_comp = AioCompletion::create(nullptr, nullptr, nullptr);
+    ImageDispatchSpec* spec;
+    if (flush) {
+      spec = ImageDispatchSpec::create_flush(
+        image_ctx, IMAGE_DISPATCH_LAYER_NONE, aio_comp, FLUSH_SOURCE_USER,
+        {});
+    } else {
+      bufferlist bl;
+      bl.append("1");
+      spec = ImageDispatchSpec::create_write(
+        image_ctx, IMAGE_DISPATCH_LAYER_NONE, aio_comp, {{0, 1}},
+        ImageArea::DATA, std::move(bl), 0, {});
+    }
+    spec->send();
+    aio_comp->release();
+    return MockTestImageDispatch::s_dispatched;
+  }
+
+  void shut_down(MockTestImageDispatcher& mock_image_dispatcher) {
+    C_SaferCond ctx;
+    mock_image_dispatcher.shut_down(&ctx);
+    ASSERT_EQ(0, ctx.wait());
+  }
+};
+
+TEST_F(TestMockIoImageDispatcher, QosBypass) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  MockTestImageCtx mock_image_ctx(*ictx);
+  MockTestImageDispatcher mock_image_dispatcher(&mock_image_ctx);
+
+  const std::vector<ImageDispatchLayer> all_layers{
+    IMAGE_DISPATCH_LAYER_QUEUE, IMAGE_DISPATCH_LAYER_QOS,
+    IMAGE_DISPATCH_LAYER_REFRESH, IMAGE_DISPATCH_LAYER_WRITE_BLOCK,
+    IMAGE_DISPATCH_LAYER_CORE};
+  const std::vector<ImageDispatchLayer> qos_bypassed{
+    IMAGE_DISPATCH_LAYER_QUEUE, IMAGE_DISPATCH_LAYER_REFRESH,
+    IMAGE_DISPATCH_LAYER_WRITE_BLOCK, IMAGE_DISPATCH_LAYER_CORE};
+
+  // no limits: IO steps over the QoS layer, flushes still visit it
+  ASSERT_EQ(qos_bypassed, send(mock_image_dispatcher, false));
+  ASSERT_EQ(all_layers, send(mock_image_dispatcher, true));
+
+  // a limit set at runtime puts the layer back in the IO path
+  mock_image_dispatcher.apply_qos_limit(IMAGE_DISPATCH_FLAG_QOS_IOPS_THROTTLE,
+                                        100, 0, 1);
+  ASSERT_EQ(all_layers, send(mock_image_dispatcher, false));
+  ASSERT_EQ(all_layers, send(mock_image_dispatcher, true));
+
+  // and clearing it takes it out again
+  mock_image_dispatcher.apply_qos_limit(IMAGE_DISPATCH_FLAG_QOS_IOPS_THROTTLE,
+                                        0, 0, 1);
+  ASSERT_EQ(qos_bypassed, send(mock_image_dispatcher, false));
+
+  shut_down(mock_image_dispatcher);
+}
+
+} // namespace io
+} // namespace librbd
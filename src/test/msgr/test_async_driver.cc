@@ -23,6 +23,7 @@
 #include <pthread.h>
 #include <stdint.h>
 #include <arpa/inet.h>
+#include "acconfig.h"
 #include "include/Context.h"
 #include "common/ceph_mutex.h"
 #include "common/Cond.h"
@@ -55,6 +56,9 @@
 #include "msg/async/EventKqueue.h"
 #endif
 #include "msg/async/EventSelect.h"
+#if defined(__linux__) && defined(HAVE_LIBURING)
+#include "msg/async/EventUring.h"
+#endif
 
 #include <gtest/gtest.h>
 
@@ -68,16 +72,20 @@ class EventDriverTest : public ::testing::TestWithParam<const char*> {
   void SetUp() override {
     cerr << __func__ << " start set up " << GetParam() << std::endl;
 #ifdef HAVE_EPOLL
-    if (strcmp(GetParam(), "epoll"))
+    if (!strcmp(GetParam(), "epoll"))
       driver = new EpollDriver(g_ceph_context);
 #endif
 #ifdef HAVE_KQUEUE
-    if (strcmp(GetParam(), "kqueue"))
+    if (!strcmp(GetParam(), "kqueue"))
       driver = new KqueueDriver(g_ceph_context);
 #endif
-    if (strcmp(GetParam(), "select"))
+#if defined(__linux__) && defined(HAVE_LIBURING)
+    if (!strcmp(GetParam(), "io_uring"))
+      driver = new UringDriver(g_ceph_context);
+#endif
+    if (!strcmp(GetParam(), "select"))
       driver = new SelectDriver(g_ceph_context);
-    driver->init(NULL, 100);
+    ASSERT_EQ(0, driver->init(NULL, 100));
   }
   void TearDown() override {
     delete driver;
@@ -139,6 +147,31 @@ TEST_P(EventDriverTest, PipeTest) {
   ASSERT_EQ(r, 0);
 }
 
+// a poll that fails must not be reported over and over
+TEST_P(EventDriverTest, BadFdTest) {
+  int fds[2];
+  vector<FiredFileEvent> fired_events;
+  struct timeval tv;
+  tv.tv_sec = 0;
+  tv.tv_usec = 1;
+
+  int r = pipe(fds);
+  ASSERT_EQ(r, 0);
+  ::close(fds[0]);
+  ::close(fds[1]);
+  r = driver->add_event(fds[0], EVENT_NONE, EVENT_READABLE);
+  if (r == 0) {
+    // the error may be reported once, as with EPOLLERR
+    r = driver->event_wait(fired_events, &tv);
+    ASSERT_LE(r, 1);
+    fired_events.clear();
+    for (int i = 0; i < 3; ++i) {
+      r = driver->event_wait(fired_events, &tv);
+      ASSERT_EQ(r, 0);
+    }
+  }
+}
+
 void* echoclient(void *arg)
 {
   intptr_t port = (intptr_t)arg;
@@ -340,6 +373,9 @@ INSTANTIATE_TEST_SUITE_P(
 #endif
 #ifdef HAVE_KQUEUE
     "kqueue",
+#endif
+#if defined(__linux__) && defined(HAVE_LIBURING)
+    "io_uring",
 #endif
     "select"
   )
@@ -271,6 +271,104 @@ TEST_P(NetworkWorkerTest, SimpleTest) {
   });
 }
 
+// the sent buffers stay referenced until the kernel completes the
+// MSG_ZEROCOPY send, and sends beyond ms_tcp_zerocopy_max_pending copy
+TEST_P(NetworkWorkerTest, ZeroCopySendTest) {
+  if (strcmp(GetParam(), "posix")) {
+    GTEST_SKIP() << "MSG_ZEROCOPY is only used by the posix stack";
+  }
+  entity_addr_t bind_addr;
+  ASSERT_TRUE(bind_addr.parse(get_addr().c_str()));
+  g_ceph_context->_conf.set_val_or_die("ms_tcp_zerocopy_threshold", "4096");
+
+  exec_events([this, bind_addr](Worker *worker) mutable {
+    if (worker->id != 0) {
+      return;
+    }
+    EventCenter *center = &worker->center;
+    SocketOptions options;
+    ServerSocket bind_socket;
+    ssize_t r = worker->listen(bind_addr, 0, options, &bind_socket);
+    ASSERT_EQ(0, r);
+
+    // send 64k from a single buffer, and return whether the kernel took
+    // it without copying
+    auto send_once = [&](bool *zerocopy) {
+      ConnectedSocket cli_socket, srv_socket;
+      r = worker->connect(bind_addr, options, &cli_socket);
+      ASSERT_EQ(0, r);
+      C_poll cb(center);
+      center->create_file_event(bind_socket.fd(), EVENT_READABLE, &cb);
+      ASSERT_TRUE(cb.poll(500));
+      center->delete_file_event(bind_socket.fd(), EVENT_READABLE);
+      entity_addr_t cli_addr;
+      r = bind_socket.accept(&srv_socket, options, &cli_addr, worker);
+      ASSERT_EQ(0, r);
+      cb.reset();
+      center->create_file_event(cli_socket.fd(), EVENT_READABLE, &cb);
+      r = cli_socket.is_connected();
+      if (r == 0) {
+        ASSERT_TRUE(cb.poll(500));
+        r = cli_socket.is_connected();
+      }
+      ASSERT_EQ(1, r);
+      center->delete_file_event(cli_socket.fd(), EVENT_READABLE);
+
+      const unsigned len = 65536;
+      bufferptr bp(buffer::create_page_aligned(len));
+      bp.zero();
+      bufferlist bl;
+      bl.append(bp);
+      r = cli_socket.send(bl, false);
+      ASSERT_EQ((ssize_t)len, r);
+      *zerocopy = bp.raw_nref() > 1;
+
+      char buf[4096];
+      unsigned left = len;
+      cb.reset();
+      center->create_file_event(srv_socket.fd(), EVENT_READABLE, &cb);
+      while (left) {
+        r = srv_socket.read(buf, sizeof(buf));
+        if (r == -EAGAIN) {
+          ASSERT_TRUE(cb.poll(500));
+          cb.reset();
+          continue;
+        }
+        ASSERT_GT(r, 0);
+        left -= r;
+      }
+      center->delete_file_event(srv_socket.fd(), EVENT_READABLE);
+
+      // the completion is reaped by the next read() or send()
+      for (int i = 0; i < 1000 && bp.raw_nref() > 1; ++i) {
+        usleep(1000);
+        ASSERT_EQ(-EAGAIN, cli_socket.read(buf, sizeof(buf)));
+      }
+      ASSERT_EQ(1, bp.raw_nref());
+      cli_socket.close();
+      srv_socket.close();
+    };
+
+    bool zerocopy = false;
+    send_once(&zerocopy);
+    if (!zerocopy) {
+      std::cerr << "SO_ZEROCOPY not supported, skipping" << std::endl;
+      bind_socket.abort_accept();
+      return;
+    }
+
+    g_ceph_context->_conf.set_val_or_die("ms_tcp_zerocopy_max_pending", "0");
+    auto fallback = worker->perf_logger->get(l_msgr_send_zerocopy_fallback);
+    send_once(&zerocopy);
+    ASSERT_FALSE(zerocopy);
+    ASSERT_EQ(fallback + 1,
+	      worker->perf_logger->get(l_msgr_send_zerocopy_fallback));
+    bind_socket.abort_accept();
+  });
+  g_ceph_context->_conf.set_val_or_die("ms_tcp_zerocopy_threshold", "0");
+  g_ceph_context->_conf.set_val_or_die("ms_tcp_zerocopy_max_pending", "128");
+}
+
 TEST_P(NetworkWorkerTest, ConnectFailedTest) {
   entity_addr_t bind_addr;
   ASSERT_TRUE(bind_addr.parse(get_addr().c_str()));
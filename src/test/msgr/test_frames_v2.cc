@@ -14,6 +14,8 @@
 
 #include "msg/async/frames_v2.h"
 
+#include <chrono>
+#include <iostream>
 #include <numeric>
 #include <ostream>
 #include <string>
@@ -24,6 +26,7 @@
 #include "common/ceph_argparse.h"
 #include "global/global_init.h"
 #include "global/global_context.h"
+#include "common/ceph_time.h"
 #include "include/Context.h"
 
 #include <gtest/gtest.h>
@@ -279,6 +282,34 @@ TEST_P(RoundTripTest, Reuse) {
   }
 }
 
+TEST_P(RoundTripTest, Batch) {
+  // frames assembled back to back into one buffer, as ProtocolV2 does
+  // when several messages are queued, must disassemble one by one
+  static constexpr int num_frames = 8;
+  bufferlist batch_bl;
+  for (int i = 0; i < num_frames; i++) {
+    auto tx_frame = TestFrame::Encode(m_header, m_front, m_middle, m_data);
+    batch_bl.claim_append(tx_frame.get_buffer(m_tx_frame_asm));
+  }
+  EXPECT_EQ(num_frames * m_tx_frame_asm.get_frame_onwire_len(),
+            batch_bl.length());
+
+  for (int i = 0; i < num_frames; i++) {
+    Tag rx_tag;
+    segment_bls_t rx_segment_bls;
+    ASSERT_TRUE(disassemble_frame(m_rx_frame_asm, batch_bl, rx_tag,
+                                  rx_segment_bls));
+    EXPECT_EQ(TestFrame::tag, rx_tag);
+
+    auto rx_frame = TestFrame::Decode(rx_segment_bls);
+    EXPECT_TRUE(m_header.contents_equal(rx_frame.header()));
+    EXPECT_TRUE(m_front.contents_equal(rx_frame.front()));
+    EXPECT_TRUE(m_middle.contents_equal(rx_frame.middle()));
+    EXPECT_TRUE(m_data.contents_equal(rx_frame.data()));
+  }
+  EXPECT_EQ(0, batch_bl.length());
+}
+
 static const round_trip_instance_t round_trip_instances[] = {
   // first segment is empty
   { 0,   0,   0,   0, 1, {{32,  0,  17,   0,   0,  0},
@@ -436,6 +467,28 @@ TEST_P(RoundTripPerfTest, DISABLED_Basic) {
   }
 }
 
+TEST_P(RoundTripPerfTest, DISABLED_Batch) {
+  // assemble batches of frames the way ProtocolV2::write_event() does
+  // with ms_async_send_batch_messages and report the tx rate
+  static constexpr int num_batches = 10000;
+  static constexpr int batch_size = 16;
+  auto start = ceph::mono_clock::now();
+  uint64_t bytes = 0;
+  for (int i = 0; i < num_batches; i++) {
+    bufferlist batch_bl;
+    for (int j = 0; j < batch_size; j++) {
+      auto tx_frame = TestFrame::Encode(m_header, m_front, m_middle, m_data);
+      batch_bl.claim_append(tx_frame.get_buffer(m_tx_frame_asm));
+    }
+    bytes += batch_bl.length();
+  }
+  double elapsed = std::chrono::duration<double>(
+    ceph::mono_clock::now() - start).count();
+  std::cout << std::get<0>(GetParam()) << " " << std::get<1>(GetParam())
+            << ": " << num_batches * batch_size / elapsed << " msgs/sec, "
+            << bytes / elapsed / (1 << 20) << " MiB/sec" << std::endl;
+}
+
 static const round_trip_instance_t round_trip_perf_instances[] = {
   {41, 250, 0,       0, 2, {{32, 41, 250, 17,       0,  0},
                             {32, 48, 256, 32,       0,  0},
@@ -17,8 +17,10 @@
 #include <atomic>
 #include <iostream>
 #include <list>
+#include <map>
 #include <memory>
 #include <set>
+#include <thread>
 #include <stdlib.h>
 #include <time.h>
 #include <unistd.h>
@@ -1160,6 +1162,114 @@ TEST_P(MessengerTest, TimeoutTest) {
   g_ceph_context->_conf.set_val("ms_connection_idle_timeout", "900");
 }
 
+class ShardedDispatcher : public Dispatcher {
+ public:
+  ceph::mutex lock = ceph::make_mutex("ShardedDispatcher::lock");
+  ceph::condition_variable cond;
+  std::map<Connection*, uint64_t> last_tid;
+  std::set<Connection*> in_dispatch;
+  std::set<std::thread::id> threads;
+  uint64_t count = 0;
+  bool out_of_order = false;
+  bool concurrent = false;
+
+  ShardedDispatcher() : Dispatcher(g_ceph_context) {}
+  bool ms_can_dispatch_concurrently() const override { return true; }
+  bool ms_dispatch(Message *m) override {
+    Connection *con = m->get_connection().get();
+    {
+      std::lock_guard l{lock};
+      concurrent |= !in_dispatch.insert(con).second;
+      out_of_order |= m->get_tid() != last_tid[con] + 1;
+      last_tid[con] = m->get_tid();
+      threads.insert(std::this_thread::get_id());
+    }
+    // give other messages of this connection a chance to overtake us
+    usleep(100);
+    std::lock_guard l{lock};
+    in_dispatch.erase(con);
+    count++;
+    cond.notify_all();
+    m->put();
+    return true;
+  }
+  bool ms_handle_reset(Connection *con) override { return true; }
+  void ms_handle_remote_reset(Connection *con) override {}
+  bool ms_handle_refused(Connection *con) override { return false; }
+};
+
+TEST_P(MessengerTest, ShardedDispatchTest) {
+  g_ceph_context->_conf.set_val("ms_dispatch_shards", "4");
+  Messenger *sharded_msgr = Messenger::create(
+    g_ceph_context, string(GetParam()), entity_name_t::OSD(1), "sharded",
+    getpid());
+  g_ceph_context->_conf.set_val("ms_dispatch_shards", "1");
+  sharded_msgr->set_default_policy(Messenger::Policy::stateless_server(0));
+  sharded_msgr->set_auth_client(&dummy_auth);
+  sharded_msgr->set_auth_server(&dummy_auth);
+  sharded_msgr->set_require_authorizer(false);
+  ShardedDispatcher srv_dispatcher;
+  entity_addr_t bind_addr;
+  bind_addr.parse("v2:127.0.0.1");
+  sharded_msgr->bind(bind_addr);
+  sharded_msgr->add_dispatcher_head(&srv_dispatcher);
+  sharded_msgr->start();
+  ASSERT_TRUE(sharded_msgr->ms_can_dispatch_concurrently());
+
+  // one messenger, and so one connection, per client
+  const unsigned num_clients = 8;
+  const uint64_t num_msgs = 100;
+  std::vector<std::unique_ptr<FakeDispatcher>> cli_dispatchers;
+  std::vector<Messenger*> clients;
+  for (unsigned i = 0; i < num_clients; i++) {
+    auto msgr = Messenger::create(g_ceph_context, string(GetParam()),
+				  entity_name_t::CLIENT(-1), "client", getpid());
+    msgr->set_default_policy(Messenger::Policy::lossy_client(0));
+    msgr->set_auth_client(&dummy_auth);
+    msgr->set_auth_server(&dummy_auth);
+    cli_dispatchers.emplace_back(new FakeDispatcher(false));
+    msgr->add_dispatcher_head(cli_dispatchers.back().get());
+    msgr->start();
+    clients.push_back(msgr);
+  }
+  std::vector<ConnectionRef> conns;
+  for (auto msgr : clients) {
+    conns.push_back(msgr->connect_to(sharded_msgr->get_mytype(),
+				     sharded_msgr->get_myaddrs()));
+  }
+  for (uint64_t tid = 1; tid <= num_msgs; tid++) {
+    for (auto& conn : conns) {
+      auto m = new MCommand();
+      m->set_tid(tid);
+      ASSERT_EQ(conn->send_message(m), 0);
+    }
+  }
+  {
+    std::unique_lock l{srv_dispatcher.lock};
+    srv_dispatcher.cond.wait(l, [&] {
+      return srv_dispatcher.count == num_clients * num_msgs;
+    });
+    ASSERT_EQ(num_clients, srv_dispatcher.last_tid.size());
+    for (auto& [con, tid] : srv_dispatcher.last_tid) {
+      ASSERT_EQ(num_msgs, tid);
+    }
+    // every connection is delivered in order by a single thread at a time
+    ASSERT_FALSE(srv_dispatcher.out_of_order);
+    ASSERT_FALSE(srv_dispatcher.concurrent);
+    ASSERT_LE(srv_dispatcher.threads.size(), 4u);
+  }
+  ASSERT_EQ(0, sharded_msgr->get_dispatch_queue_len());
+
+  for (auto msgr : clients) {
+    msgr->shutdown();
+    msgr->wait();
+    delete msgr;
+  }
+  sharded_msgr->shutdown();
+  sharded_msgr->wait();
+  delete sharded_msgr;
+}
+
 TEST_P(MessengerTest, StatefulTest) {
   Message *m;
   FakeDispatcher cli_dispatcher(false), srv_dispatcher(true);
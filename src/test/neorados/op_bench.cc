@@ -0,0 +1,297 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+/*
+ * Compare the ops/sec and heap allocations/op of small neorados ops
+ * completed through a callback, awaited by coroutines, and awaited by
+ * coroutines that keep their handler memory in their frame.
+ *
+ *   ceph_test_neorados_op_bench --pool rbd --op stat --coroutines 64
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#include <boost/system/system_error.hpp>
+
+#include "include/neorados/RADOS.hpp"
+
+#include "common/async/blocked_completion.h"
+#include "common/async/context_pool.h"
+#include "common/async/handler_memory.h"
+#include "common/ceph_argparse.h"
+#include "global/global_init.h"
+
+namespace asio = boost::asio;
+namespace bs = boost::system;
+namespace ca = ceph::async;
+namespace R = neorados;
+
+using Clock = std::chrono::steady_clock;
+
+static std::atomic<uint64_t> num_allocs{0};
+
+void* operator new(std::size_t size)
+{
+  num_allocs.fetch_add(1, std::memory_order_relaxed);
+  if (void* p = std::malloc(size ? size : 1)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+  std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+  std::free(p);
+}
+
+struct bench_opts {
+  std::string pool = "rbd";
+  std::string op = "stat";
+  int seconds = 10;
+  int coroutines = 16;
+  int objects = 1024;
+  int size = 4096;
+};
+
+static std::string oid_of(int i)
+{
+  return "neorados_op_bench_" + std::to_string(i);
+}
+
+struct bench_state {
+  const bench_opts& opts;
+  R::RADOS& rados;
+  R::IOContext ioc;
+  ceph::bufferlist data;
+  Clock::time_point deadline;
+  std::atomic<uint64_t> done{0};
+  std::atomic<int> running{0};
+  std::atomic<bool> failed{false};
+};
+
+template <typename CompletionToken>
+static auto async_bench_op(bench_state& s, unsigned& seed,
+			   ceph::bufferlist* bl, CompletionToken&& token)
+{
+  R::Object oid{oid_of(rand_r(&seed) % s.opts.objects)};
+  if (s.opts.op == "write") {
+    R::WriteOp op;
+    op.write(0, ceph::bufferlist{s.data});
+    return s.rados.execute(std::move(oid), s.ioc, std::move(op),
+			   std::forward<CompletionToken>(token));
+  }
+  R::ReadOp op;
+  if (s.opts.op == "read") {
+    op.read(0, s.opts.size, bl);
+  } else {
+    op.stat(nullptr, nullptr);
+  }
+  return s.rados.execute(std::move(oid), s.ioc, std::move(op), nullptr,
+			 std::forward<CompletionToken>(token));
+}
+
+// completion handlers resubmit the next op
+struct callback_worker {
+  bench_state& s;
+  unsigned seed;
+  ceph::bufferlist bl;
+
+  void submit() {
+    bl.clear();
+    async_bench_op(s, seed, &bl, [this] (bs::error_code ec) {
+      if (ec && ec != bs::errc::no_such_file_or_directory) {
+	std::cerr << "op failed: " << ec.message() << std::endl;
+	s.failed = true;
+      } else {
+	++s.done;
+      }
+      if (s.failed || Clock::now() >= s.deadline) {
+	--s.running;
+	return;
+      }
+      submit();
+    });
+  }
+};
+
+template <typename MakeToken>
+static asio::awaitable<void> coroutine_worker(bench_state& s, unsigned seed,
+					      MakeToken make_token)
+{
+  ceph::bufferlist bl;
+  while (!s.failed && Clock::now() < s.deadline) {
+    bl.clear();
+    try {
+      co_await async_bench_op(s, seed, &bl, make_token());
+      ++s.done;
+    } catch (const bs::system_error& e) {
+      if (e.code() != bs::errc::no_such_file_or_directory) {
+	std::cerr << "op failed: " << e.what() << std::endl;
+	s.failed = true;
+      }
+    }
+  }
+  --s.running;
+}
+
+static asio::awaitable<void> memory_worker(bench_state& s, unsigned seed)
+{
+  // lives in the coroutine frame for all of the worker's ops
+  ca::handler_memory<> memory;
+  co_await coroutine_worker(s, seed, [&memory] {
+    return ca::bind_handler_memory(memory, asio::use_awaitable);
+  });
+}
+
+static int run(const bench_opts& opts, R::RADOS& rados, R::IOContext ioc,
+	       const std::string& mode)
+{
+  bench_state s{opts, rados, std::move(ioc)};
+  s.data.append_zero(opts.size);
+  s.deadline = Clock::now() + std::chrono::seconds(opts.seconds);
+  s.running = opts.coroutines;
+
+  std::vector<callback_worker> callbacks;
+  callbacks.reserve(opts.coroutines);
+  uint64_t allocs_before = num_allocs;
+  auto start = Clock::now();
+  for (int i = 0; i < opts.coroutines; ++i) {
+    unsigned seed = i + 1;
+    if (mode == "callback") {
+      callbacks.push_back(callback_worker{s, seed});
+      callbacks.back().submit();
+    } else if (mode == "awaitable") {
+      asio::co_spawn(rados.get_executor(),
+		     coroutine_worker(s, seed, [] { return asio::use_awaitable; }),
+		     asio::detached);
+    } else {
+      asio::co_spawn(rados.get_executor(), memory_worker(s, seed),
+		     asio::detached);
+    }
+  }
+  while (s.running > 0) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  std::chrono::duration<double> elapsed = Clock::now() - start;
+  uint64_t allocs = num_allocs - allocs_before;
+  if (s.failed) {
+    return -1;
+  }
+
+  uint64_t done = s.done;
+  std::cout << std::setw(18) << mode
+	    << std::setw(14) << std::fixed << std::setprecision(0)
+	    << done / elapsed.count()
+	    << std::setw(14) << std::setprecision(2)
+	    << (done ? (double)allocs / done : 0.0)
+	    << std::endl;
+  return 0;
+}
+
+int main(int argc, char** argv)
+{
+  auto args = argv_to_vec(argc, argv);
+  env_to_vec(args);
+
+  auto cct = global_init(nullptr, args, CEPH_ENTITY_TYPE_CLIENT,
+			 CODE_ENVIRONMENT_UTILITY, 0);
+  common_init_finish(cct.get());
+
+  bench_opts opts;
+  std::string val;
+  for (auto i = args.begin(); i != args.end();) {
+    if (ceph_argparse_witharg(args, i, &val, "--pool", (char*)NULL)) {
+      opts.pool = val;
+    } else if (ceph_argparse_witharg(args, i, &val, "--op", (char*)NULL)) {
+      opts.op = val;
+    } else if (ceph_argparse_witharg(args, i, &val, "--seconds", (char*)NULL)) {
+      opts.seconds = atoi(val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "--coroutines",
+				     (char*)NULL)) {
+      opts.coroutines = atoi(val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "--objects", (char*)NULL)) {
+      opts.objects = atoi(val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "--size", (char*)NULL)) {
+      opts.size = atoi(val.c_str());
+    } else {
+      std::cerr << "unknown option " << *i << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  if ((opts.op != "stat" && opts.op != "read" && opts.op != "write") ||
+      opts.seconds <= 0 || opts.coroutines <= 0 || opts.objects <= 0 ||
+      opts.size <= 0) {
+    std::cerr << "usage: " << argv[0] << " [--pool <name>]"
+	      << " [--op stat|read|write] [--seconds <n>]"
+	      << " [--coroutines <n>] [--objects <n>] [--size <bytes>]"
+	      << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  try {
+    ca::io_context_pool p(1);
+    auto r = R::RADOS::make_with_cct(cct.get(), p, ca::use_blocked);
+    auto pool = r.lookup_pool(opts.pool, ca::use_blocked);
+    R::IOContext ioc(pool);
+
+    if (opts.op == "read") {
+      ceph::bufferlist bl;
+      bl.append_zero(opts.size);
+      for (int i = 0; i < opts.objects; ++i) {
+	R::WriteOp op;
+	op.write_full(ceph::bufferlist{bl});
+	r.execute(oid_of(i), ioc, std::move(op), ca::use_blocked);
+      }
+    }
+
+    std::cout << std::setw(18) << "completion" << std::setw(14) << "ops/sec"
+	      << std::setw(14) << "allocs/op" << std::endl;
+    for (auto mode : {"callback", "awaitable", "awaitable+memory"}) {
+      if (run(opts, r, ioc, mode) < 0) {
+	return EXIT_FAILURE;
+      }
+    }
+
+    if (opts.op != "stat") {
+      for (int i = 0; i < opts.objects; ++i) {
+	R::WriteOp op;
+	op.remove();
+	try {
+	  r.execute(oid_of(i), ioc, std::move(op), ca::use_blocked);
+	} catch (const bs::system_error&) {
+	  // never written
+	}
+      }
+    }
+  } catch (const bs::system_error& e) {
+    std::cerr << "Error: " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -351,6 +351,86 @@ int correctness_test(uint64_t delay_ns)
   return EXIT_FAILURE;
 }
 
+/*
+ * Clean buffers enter the lru at its midpoint (osdc_cache_mid): a single
+ * pass over more data than fits in the cache must not push out data
+ * that was read more than once.
+ */
+int scan_resistance_test(uint64_t delay_ns)
+{
+  std::cerr << "starting scan resistance test" << std::endl;
+  ceph::mutex lock = ceph::make_mutex("object_cacher_stress::object_cacher");
+  MemWriteback writeback(g_ceph_context, &lock, delay_ns);
+
+  const uint64_t obj_size = 1<<18;
+  const int num_scan = 16; // twice the cache size
+  ObjectCacher obc(g_ceph_context, "test", writeback, lock, NULL, NULL,
+		   1<<21, // max cache size, 2MB
+		   num_scan + 1, // max objects
+		   0, // max dirty, we only read
+		   0, // target dirty
+		   g_conf()->client_oc_max_dirty_age,
+		   true);
+  obc.start();
+
+  ObjectCacher::ObjectSet object_set(NULL, 0, 0);
+  ceph::bufferlist zeroes_bl;
+  zeroes_bl.append_zero(obj_size);
+  writeback.write_object_data("hot", 0, obj_size, zeroes_bl);
+  for (int i = 0; i < num_scan; ++i) {
+    writeback.write_object_data("scan." + stringify(i), 0, obj_size,
+				zeroes_bl);
+  }
+
+  // returns true if the object was cached
+  auto read = [&](const std::string& oid, uint64_t objectno) {
+    bufferlist readbl;
+    C_SaferCond readcond;
+    ObjectCacher::OSDRead *rd = obc.prepare_read(CEPH_NOSNAP, &readbl, 0);
+    ObjectExtent extent(oid, objectno, 0, obj_size, 0);
+    extent.oloc.pool = 0;
+    extent.buffer_extents.push_back(make_pair(0, obj_size));
+    rd->extents.push_back(extent);
+    lock.lock();
+    int r = obc.readx(rd, &object_set, &readcond);
+    lock.unlock();
+    bool hit = (r != 0);
+    if (r == 0) {
+      r = readcond.wait();
+    }
+    ceph_assert(r == (int)obj_size);
+    return hit;
+  };
+
+  // the hot set is read in, and read again
+  ceph_assert(!read("hot", 0));
+  ceph_assert(read("hot", 0));
+
+  std::cout << "Reading " << num_scan << " objects once" << std::endl;
+  for (int i = 0; i < num_scan; ++i) {
+    read("scan." + stringify(i), i + 1);
+  }
+
+  int ret = EXIT_SUCCESS;
+  if (!read("hot", 0)) {
+    std::cout << "hot object was evicted by a one-pass scan!" << std::endl;
+    ret = EXIT_FAILURE;
+  } else if (read("scan.0", 1)) {
+    std::cout << "scanned objects were not evicted!" << std::endl;
+    ret = EXIT_FAILURE;
+  }
+
+  lock.lock();
+  obc.release_set(&object_set);
+  lock.unlock();
+  obc.stop();
+
+  if (ret == EXIT_SUCCESS) {
+    std::cout << "Testing ObjectCacher scan resistance complete" << std::endl;
+  }
+  return ret;
+}
+
 int main(int argc, const char **argv)
 {
   auto args = argv_to_vec(argc, argv);
@@ -367,6 +447,7 @@ int main(int argc, const char **argv)
   int seed = time(0) % 100000;
   bool stress = false;
   bool correctness = false;
+  bool scan = false;
   std::ostringstream err;
   std::vector<const char*>::iterator i;
   for (i = args.begin(); i != args.end();) {
@@ -409,6 +490,8 @@ int main(int argc, const char **argv)
       stress = true;
     } else if (ceph_argparse_flag(args, i, "--correctness-test", NULL)) {
       correctness = true;
+    } else if (ceph_argparse_flag(args, i, "--scan-test", NULL)) {
+      scan = true;
     } else {
       cerr << "unknown option " << *i << std::endl;
       return EXIT_FAILURE;
@@ -422,4 +505,7 @@ int main(int argc, const char **argv)
   if (correctness) {
     return correctness_test(delay_ns);
   }
+  if (scan) {
+    return scan_resistance_test(delay_ns);
+  }
 }
@@ -0,0 +1,331 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+/*
+ * Measure how many small ops per second librados clients sharing one
+ * Objecter can push through as the number of submitting threads grows,
+ * with and without objecter_lockless_op_submit.  With --batch, each
+ * completion covers that many ops submitted with aio_operate_batch().
+ *
+ *   ceph_test_objecter_bench --pool rbd --threads 1,2,4,8,16,32 --compare
+ *   ceph_test_objecter_bench --pool rbd --op read --batch 32
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "include/rados/librados.hpp"
+
+using namespace std;
+using Clock = std::chrono::steady_clock;
+
+struct bench_opts {
+  string pool = "rbd";
+  string rados_id = "admin";
+  string op = "stat";
+  vector<int> threads = {1, 2, 4, 8, 16};
+  int seconds = 10;
+  int queue_depth = 16;
+  int objects = 1024;
+  int size = 4096;
+  int batch = 1;
+  bool compare = false;
+};
+
+static void usage(const char *argv0)
+{
+  cout << "usage: " << argv0 << " [options]\n"
+       << "  --pool <name>          pool to use (default rbd)\n"
+       << "  --name <id>            rados id (default admin)\n"
+       << "  --op stat|read|write   op to issue (default stat)\n"
+       << "  --threads <n,n,...>    client thread counts to run (default 1,2,4,8,16)\n"
+       << "  --seconds <n>          duration of each run (default 10)\n"
+       << "  --queue-depth <n>      ops in flight per thread (default 16)\n"
+       << "  --objects <n>          number of objects to spread ops over (default 1024)\n"
+       << "  --size <bytes>         read/write size (default 4096)\n"
+       << "  --batch <n>            ops per completion, via aio_operate_batch (default 1)\n"
+       << "  --compare              run with objecter_lockless_op_submit off, then on\n"
+       << "other arguments are passed to librados\n";
+}
+
+static string oid_of(int i)
+{
+  return "objecter_bench_" + to_string(i);
+}
+
+static int connect(const bench_opts& opts, vector<const char*>& args,
+		   bool lockless, librados::Rados& rados,
+		   librados::IoCtx& ioctx)
+{
+  int r = rados.init(opts.rados_id.c_str());
+  if (r < 0) {
+    cerr << "error during init: " << r << std::endl;
+    return r;
+  }
+  rados.conf_read_file(nullptr);
+  rados.conf_parse_env(nullptr);
+  r = rados.conf_parse_argv(args.size(), args.data());
+  if (r < 0) {
+    cerr << "error parsing args: " << r << std::endl;
+    return r;
+  }
+  rados.conf_set("objecter_lockless_op_submit", lockless ? "true" : "false");
+  r = rados.connect();
+  if (r < 0) {
+    cerr << "error during connect: " << r << std::endl;
+    return r;
+  }
+  r = rados.ioctx_create(opts.pool.c_str(), ioctx);
+  if (r < 0) {
+    cerr << "error opening pool " << opts.pool << ": " << r << std::endl;
+    rados.shutdown();
+    return r;
+  }
+  return 0;
+}
+
+static int prepare_objects(const bench_opts& opts, librados::IoCtx& ioctx)
+{
+  ceph::bufferlist bl;
+  bl.append_zero(opts.size);
+  for (int i = 0; i < opts.objects; ++i) {
+    int r = ioctx.write_full(oid_of(i), bl);
+    if (r < 0) {
+      cerr << "error writing " << oid_of(i) << ": " << r << std::endl;
+      return r;
+    }
+  }
+  return 0;
+}
+
+static void cleanup_objects(const bench_opts& opts, librados::IoCtx& ioctx)
+{
+  for (int i = 0; i < opts.objects; ++i) {
+    ioctx.remove(oid_of(i));
+  }
+}
+
+struct slot_t {
+  librados::AioCompletion *c = nullptr;
+  ceph::bufferlist bl;
+  uint64_t size = 0;
+  time_t mtime = 0;
+  // --batch
+  std::deque<librados::ObjectReadOperation> rops;
+  std::deque<librados::ObjectWriteOperation> wops;
+  std::deque<ceph::bufferlist> bls;
+};
+
+static int submit_batch(const bench_opts& opts, librados::IoCtx& ioctx,
+			slot_t& s, unsigned& seed, const ceph::bufferlist& data)
+{
+  s.rops.clear();
+  s.wops.clear();
+  s.bls.clear();
+  int r;
+  if (opts.op == "write") {
+    vector<pair<string, librados::ObjectWriteOperation*>> ops;
+    for (int i = 0; i < opts.batch; ++i) {
+      auto& op = s.wops.emplace_back();
+      op.write(0, data);
+      ops.emplace_back(oid_of(rand_r(&seed) % opts.objects), &op);
+    }
+    r = ioctx.aio_operate_batch(s.c, ops, nullptr, 0);
+  } else {
+    vector<pair<string, librados::ObjectReadOperation*>> ops;
+    for (int i = 0; i < opts.batch; ++i) {
+      auto& op = s.rops.emplace_back();
+      if (opts.op == "read") {
+	op.read(0, opts.size, &s.bls.emplace_back(), nullptr);
+      } else {
+	op.stat(nullptr, nullptr, nullptr);
+      }
+      ops.emplace_back(oid_of(rand_r(&seed) % opts.objects), &op);
+    }
+    r = ioctx.aio_operate_batch(s.c, ops, nullptr, 0);
+  }
+  return r;
+}
+
+static int submit(const bench_opts& opts, librados::IoCtx& ioctx,
+		  slot_t& s, unsigned& seed, const ceph::bufferlist& data)
+{
+  s.c = librados::Rados::aio_create_completion();
+  string oid = oid_of(rand_r(&seed) % opts.objects);
+  int r;
+  if (opts.batch > 1) {
+    r = submit_batch(opts, ioctx, s, seed, data);
+  } else if (opts.op == "read") {
+    s.bl.clear();
+    r = ioctx.aio_read(oid, s.c, &s.bl, opts.size, 0);
+  } else if (opts.op == "write") {
+    r = ioctx.aio_write(oid, s.c, data, data.length(), 0);
+  } else {
+    r = ioctx.aio_stat(oid, s.c, &s.size, &s.mtime);
+  }
+  if (r < 0) {
+    cerr << "error submitting op: " << r << std::endl;
+    s.c->release();
+    s.c = nullptr;
+  }
+  return r;
+}
+
+static double run(const bench_opts& opts, librados::IoCtx& ioctx, int nthreads)
+{
+  std::atomic<uint64_t> total{0};
+  std::atomic<bool> failed{false};
+  auto deadline = Clock::now() + std::chrono::seconds(opts.seconds);
+  ceph::bufferlist data;
+  data.append_zero(opts.size);
+
+  auto start = Clock::now();
+  vector<std::thread> threads;
+  for (int t = 0; t < nthreads; ++t) {
+    threads.emplace_back([&, t] {
+      unsigned seed = t + 1;
+      vector<slot_t> slots(opts.queue_depth);
+      uint64_t done = 0;
+      for (auto& s : slots) {
+	if (submit(opts, ioctx, s, seed, data) < 0) {
+	  failed = true;
+	}
+      }
+      for (size_t i = 0; Clock::now() < deadline && !failed; ++i) {
+	auto& s = slots[i % slots.size()];
+	s.c->wait_for_complete();
+	int r = s.c->get_return_value();
+	s.c->release();
+	s.c = nullptr;
+	if (r < 0 && r != -ENOENT) {
+	  cerr << "op failed: " << r << std::endl;
+	  failed = true;
+	  break;
+	}
+	done += opts.batch;
+	if (submit(opts, ioctx, s, seed, data) < 0) {
+	  failed = true;
+	}
+      }
+      for (auto& s : slots) {
+	if (s.c) {
+	  s.c->wait_for_complete();
+	  s.c->release();
+	}
+      }
+      total += done;
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  if (failed) {
+    return -1;
+  }
+  std::chrono::duration<double> elapsed = Clock::now() - start;
+  return total / elapsed.count();
+}
+
+int main(int argc, const char **argv)
+{
+  bench_opts opts;
+  vector<const char*> args;
+  args.push_back(argv[0]);
+  for (int i = 1; i < argc; ++i) {
+    string a = argv[i];
+    bool has_val = i + 1 < argc;
+    if (a == "--help" || a == "-h") {
+      usage(argv[0]);
+      return EXIT_SUCCESS;
+    } else if (a == "--pool" && has_val) {
+      opts.pool = argv[++i];
+    } else if (a == "--name" && has_val) {
+      opts.rados_id = argv[++i];
+    } else if (a == "--op" && has_val) {
+      opts.op = argv[++i];
+      if (opts.op != "stat" && opts.op != "read" && opts.op != "write") {
+	usage(argv[0]);
+	return EXIT_FAILURE;
+      }
+    } else if (a == "--threads" && has_val) {
+      opts.threads.clear();
+      string v = argv[++i];
+      size_t pos = 0;
+      while (pos < v.size()) {
+	size_t end = v.find(',', pos);
+	if (end == string::npos)
+	  end = v.size();
+	opts.threads.push_back(atoi(v.substr(pos, end - pos).c_str()));
+	pos = end + 1;
+      }
+    } else if (a == "--seconds" && has_val) {
+      opts.seconds = atoi(argv[++i]);
+    } else if (a == "--queue-depth" && has_val) {
+      opts.queue_depth = atoi(argv[++i]);
+    } else if (a == "--objects" && has_val) {
+      opts.objects = atoi(argv[++i]);
+    } else if (a == "--size" && has_val) {
+      opts.size = atoi(argv[++i]);
+    } else if (a == "--batch" && has_val) {
+      opts.batch = atoi(argv[++i]);
+    } else if (a == "--compare") {
+      opts.compare = true;
+    } else {
+      args.push_back(argv[i]);
+    }
+  }
+  if (opts.threads.empty() || opts.seconds <= 0 || opts.queue_depth <= 0 ||
+      opts.objects <= 0 || opts.size <= 0 || opts.batch <= 0) {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  vector<bool> modes;
+  if (opts.compare) {
+    modes = {false, true};
+  } else {
+    modes = {true};
+  }
+
+  cout << std::setw(10) << "lockless" << std::setw(10) << "threads"
+       << std::setw(14) << "ops/sec" << std::endl;
+  bool prepared = false;
+  for (bool lockless : modes) {
+    librados::Rados rados;
+    librados::IoCtx ioctx;
+    int r = connect(opts, args, lockless, rados, ioctx);
+    if (r < 0) {
+      return EXIT_FAILURE;
+    }
+    if (opts.op == "read" && !prepared) {
+      r = prepare_objects(opts, ioctx);
+      if (r < 0) {
+	return EXIT_FAILURE;
+      }
+      prepared = true;
+    }
+    for (int n : opts.threads) {
+      double rate = run(opts, ioctx, n);
+      if (rate < 0) {
+	return EXIT_FAILURE;
+      }
+      cout << std::setw(10) << (lockless ? "true" : "false")
+	   << std::setw(10) << n
+	   << std::setw(14) << std::fixed << std::setprecision(0) << rate
+	   << std::endl;
+    }
+    if (opts.op != "stat" && lockless == modes.back()) {
+      cleanup_objects(opts, ioctx);
+    }
+    ioctx.close();
+    rados.shutdown();
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,133 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+/*
+ * Measure how fast Striper::file_to_extents() maps file (image) extents
+ * to object extents, comparing the lightweight interface used by librbd
+ * with the ObjectExtent vector and map interfaces, which also name each
+ * object.
+ *
+ *   ceph_test_striper_bench --io-size 4096 --stripe-count 1
+ *   ceph_test_striper_bench --io-size 1048576 --stripe-unit 65536 --stripe-count 8
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "common/ceph_argparse.h"
+#include "common/common_init.h"
+#include "global/global_init.h"
+#include "osdc/Striper.h"
+
+using namespace std;
+using Clock = std::chrono::steady_clock;
+
+struct bench_opts {
+  long long object_size = 4 << 20;
+  long long stripe_unit = 4 << 20;
+  long long stripe_count = 1;
+  long long io_size = 4096;
+  long long file_size = 1ll << 40;
+  long long iterations = 1000000;
+};
+
+template <typename F>
+static void run(const char *name, const bench_opts& opts, F&& map_extents)
+{
+  std::mt19937_64 rng(1);
+  uint64_t extents = 0;
+  auto start = Clock::now();
+  for (long long i = 0; i < opts.iterations; ++i) {
+    uint64_t off = rng() % (opts.file_size - opts.io_size);
+    extents += map_extents(off, opts.io_size);
+  }
+  std::chrono::duration<double> elapsed = Clock::now() - start;
+  cout << std::setw(14) << name
+       << std::setw(16) << std::fixed << std::setprecision(0)
+       << opts.iterations / elapsed.count()
+       << std::setw(16) << extents / elapsed.count()
+       << std::endl;
+}
+
+int main(int argc, const char **argv)
+{
+  auto args = argv_to_vec(argc, argv);
+  auto cct = global_init(nullptr, args, CEPH_ENTITY_TYPE_CLIENT,
+			 CODE_ENVIRONMENT_UTILITY,
+			 CINIT_FLAG_NO_DEFAULT_CONFIG_FILE);
+  common_init_finish(g_ceph_context);
+
+  bench_opts opts;
+  std::ostringstream err;
+  for (auto i = args.begin(); i != args.end();) {
+    if (ceph_argparse_witharg(args, i, &opts.object_size, err,
+			      "--object-size", (char*)NULL) ||
+	ceph_argparse_witharg(args, i, &opts.stripe_unit, err,
+			      "--stripe-unit", (char*)NULL) ||
+	ceph_argparse_witharg(args, i, &opts.stripe_count, err,
+			      "--stripe-count", (char*)NULL) ||
+	ceph_argparse_witharg(args, i, &opts.io_size, err,
+			      "--io-size", (char*)NULL) ||
+	ceph_argparse_witharg(args, i, &opts.iterations, err,
+			      "--iterations", (char*)NULL)) {
+      if (!err.str().empty()) {
+	cerr << argv[0] << ": " << err.str() << std::endl;
+	return EXIT_FAILURE;
+      }
+    } else {
+      cerr << "unknown option " << *i << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  if (opts.object_size <= 0 || opts.stripe_unit <= 0 ||
+      opts.stripe_count <= 0 || opts.io_size <= 0 ||
+      opts.iterations <= 0 || opts.object_size % opts.stripe_unit != 0 ||
+      opts.io_size >= opts.file_size) {
+    cerr << "invalid layout or io size" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  file_layout_t layout;
+  layout.object_size = opts.object_size;
+  layout.stripe_unit = opts.stripe_unit;
+  layout.stripe_count = opts.stripe_count;
+  layout.pool_id = 1;
+
+  cout << "object_size " << opts.object_size
+       << " stripe_unit " << opts.stripe_unit
+       << " stripe_count " << opts.stripe_count
+       << " io_size " << opts.io_size << std::endl;
+  cout << std::setw(14) << "interface" << std::setw(16) << "calls/sec"
+       << std::setw(16) << "extents/sec" << std::endl;
+
+  striper::LightweightObjectExtents lightweight_extents;
+  run("lightweight", opts, [&](uint64_t off, uint64_t len) {
+    lightweight_extents.clear();
+    Striper::file_to_extents(g_ceph_context, &layout, off, len, 0, 0,
+			     &lightweight_extents);
+    return lightweight_extents.size();
+  });
+
+  run("vector", opts, [&](uint64_t off, uint64_t len) {
+    vector<ObjectExtent> extents;
+    Striper::file_to_extents(g_ceph_context, "rbd_data.1234.%016llx",
+			     &layout, off, len, 0, extents);
+    return extents.size();
+  });
+
+  run("map", opts, [&](uint64_t off, uint64_t len) {
+    map<object_t, vector<ObjectExtent>> extents;
+    Striper::file_to_extents(g_ceph_context, "rbd_data.1234.%016llx",
+			     &layout, off, len, 0, extents);
+    return extents.size();
+  });
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,216 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "common/Throttle.h"
+#include "global/global_context.h"
+#include "messages/MOSDOp.h"
+#include "messages/MOSDOpBatch.h"
+#include "messages/MPing.h"
+#include "osdc/OpBatcher.h"
+
+static ceph::ref_t<MOSDOp> make_op(ceph_tid_t tid, unsigned len)
+{
+  hobject_t hobj(object_t("obj" + std::to_string(tid)), "", CEPH_NOSNAP, 0,
+		 1, "");
+  spg_t pgid(pg_t(0, 1));
+  auto m = ceph::make_message<MOSDOp>(0, tid, hobj, pgid, 1, 0,
+				      CEPH_FEATURES_ALL);
+  ceph::buffer::list bl;
+  bl.append(std::string(len, 'x'));
+  m->write(0, len, bl);
+  return m;
+}
+
+static uint64_t msg_bytes(Message& m)
+{
+  return m.get_payload().length() + m.get_middle().length() +
+    m.get_data().length();
+}
+
+TEST(MOSDOpBatch, encode_decode_split)
+{
+  auto b = ceph::make_message<MOSDOpBatch>();
+  b->add_op(make_op(1, 100));
+  // anything but client ops is dropped by split()
+  b->add_op(ceph::make_message<MPing>());
+  b->add_op(make_op(2, 0));
+  b->add_op(make_op(3, 4000));
+  ASSERT_EQ(4u, b->get_num_ops());
+
+  ceph::buffer::list bl;
+  encode_message(b.get(), CEPH_FEATURES_ALL, bl);
+  auto p = bl.cbegin();
+  ceph::ref_t<Message> m{decode_message(g_ceph_context, 0, p), false};
+  ASSERT_TRUE(m);
+  ASSERT_EQ(MSG_OSD_OP_BATCH, m->get_type());
+  auto d = ceph::ref_cast<MOSDOpBatch>(m);
+  ASSERT_EQ(4u, d->get_num_ops());
+
+  // what the messenger does when it reads the batch
+  Throttle bytes(g_ceph_context, "bytes", 1 << 20);
+  Throttle msgs(g_ceph_context, "msgs", 100);
+  bytes.take(msg_bytes(*d));
+  msgs.take(1);
+  d->set_byte_throttler(&bytes);
+  d->set_message_throttler(&msgs);
+  d->set_src(entity_name_t::CLIENT(4242));
+
+  auto ops = d->split(g_ceph_context);
+  ASSERT_EQ(0u, d->get_num_ops());
+  ASSERT_EQ(3u, ops.size());
+  uint64_t op_bytes = 0;
+  ceph_tid_t tid = 0;
+  for (auto& op : ops) {
+    ASSERT_EQ(CEPH_MSG_OSD_OP, op->get_type());
+    // the ops come from whoever sent the batch, whatever they claim
+    ASSERT_EQ(entity_name_t::CLIENT(4242), op->get_source());
+    ASSERT_LT(tid, op->get_tid());
+    tid = op->get_tid();
+    op_bytes += msg_bytes(*op);
+  }
+  ASSERT_EQ(4000u, ops.back()->get_data().length());
+
+  // the ops took over the batch's throttle budget...
+  ASSERT_EQ(op_bytes, bytes.get_current());
+  ASSERT_EQ(3, msgs.get_current());
+  d.reset();
+  m.reset();
+  ASSERT_EQ(op_bytes, bytes.get_current());
+  ASSERT_EQ(3, msgs.get_current());
+  // ...and give it back when they are done
+  ops.pop_back();
+  ASSERT_EQ(2, msgs.get_current());
+  ops.clear();
+  ASSERT_EQ(0, bytes.get_current());
+  ASSERT_EQ(0, msgs.get_current());
+}
+
+class OpBatcherTest : public ::testing::Test {
+public:
+  static constexpr uint64_t max_ops = 4;
+  static constexpr uint64_t max_bytes = 1000;
+  OpBatcher batcher{max_ops, max_bytes};
+  // what was sent, in order
+  std::vector<std::pair<ceph::ref_t<Message>, size_t>> sent;
+
+  auto sender() {
+    return [this](ceph::ref_t<Message> m, size_t num_ops) {
+      sent.emplace_back(std::move(m), num_ops);
+    };
+  }
+  bool add(ceph::ref_t<Message> m, uint64_t len) {
+    return batcher.add(std::move(m), len, sender());
+  }
+  // the ops of batch @p i, or the op itself if it went out on its own
+  std::vector<ceph_tid_t> tids(size_t i) {
+    std::vector<ceph_tid_t> ret;
+    auto& [m, n] = sent.at(i);
+    if (m->get_type() != MSG_OSD_OP_BATCH) {
+      ret.push_back(m->get_tid());
+    } else {
+      // only decoded batches can be looked into
+      ceph::buffer::list bl;
+      encode_message(m.get(), CEPH_FEATURES_ALL, bl);
+      auto p = bl.cbegin();
+      ceph::ref_t<Message> d{decode_message(g_ceph_context, 0, p), false};
+      for (auto& op : ceph::ref_cast<MOSDOpBatch>(d)->split(g_ceph_context)) {
+	ret.push_back(op->get_tid());
+      }
+    }
+    EXPECT_EQ(n, ret.size());
+    return ret;
+  }
+};
+
+TEST_F(OpBatcherTest, full)
+{
+  // the first op asks for the window to be started
+  ASSERT_TRUE(add(make_op(1, 10), 10));
+  ASSERT_FALSE(add(make_op(2, 10), 10));
+  ASSERT_FALSE(add(make_op(3, 10), 10));
+  ASSERT_TRUE(sent.empty());
+  ASSERT_FALSE(add(make_op(4, 10), 10));
+  ASSERT_EQ(1u, sent.size());
+  ASSERT_EQ((std::vector<ceph_tid_t>{1, 2, 3, 4}), tids(0));
+  ASSERT_TRUE(batcher.empty());
+
+  // as many ops as carry max_bytes together
+  ASSERT_FALSE(add(make_op(5, 600), 600));
+  ASSERT_FALSE(add(make_op(6, 400), 400));
+  ASSERT_EQ(2u, sent.size());
+  ASSERT_EQ((std::vector<ceph_tid_t>{5, 6}), tids(1));
+}
+
+TEST_F(OpBatcherTest, oversized)
+{
+  ASSERT_TRUE(add(make_op(1, 10), 10));
+  ASSERT_FALSE(add(make_op(2, 10), 10));
+  // flushes the batch ahead of itself
+  ASSERT_FALSE(add(make_op(3, max_bytes), max_bytes));
+  ASSERT_EQ(2u, sent.size());
+  ASSERT_EQ((std::vector<ceph_tid_t>{1, 2}), tids(0));
+  ASSERT_EQ((std::vector<ceph_tid_t>{3}), tids(1));
+
+  // and goes out right away with nothing ahead of it
+  ASSERT_FALSE(add(make_op(4, max_bytes), max_bytes));
+  ASSERT_EQ(3u, sent.size());
+  ASSERT_EQ((std::vector<ceph_tid_t>{4}), tids(2));
+  ASSERT_TRUE(batcher.empty());
+}
+
+TEST_F(OpBatcherTest, window)
+{
+  ASSERT_TRUE(add(make_op(1, 10), 10));
+  ASSERT_FALSE(add(make_op(2, 10), 10));
+  batcher.scheduled_flush(sender());
+  ASSERT_EQ(1u, sent.size());
+  ASSERT_EQ((std::vector<ceph_tid_t>{1, 2}), tids(0));
+
+  // a new window for the next batch; a lone op goes out as it is
+  ASSERT_TRUE(add(make_op(3, 10), 10));
+  batcher.scheduled_flush(sender());
+  ASSERT_EQ(2u, sent.size());
+  ASSERT_EQ(CEPH_MSG_OSD_OP, sent[1].first->get_type());
+  ASSERT_EQ((std::vector<ceph_tid_t>{3}), tids(1));
+
+  // a window still running when the batch filled up covers the next one
+  ASSERT_TRUE(add(make_op(4, 10), 10));
+  for (ceph_tid_t tid = 5; tid <= 7; tid++) {
+    ASSERT_FALSE(add(make_op(tid, 10), 10));
+  }
+  ASSERT_FALSE(add(make_op(8, 10), 10));
+  ASSERT_EQ(3u, sent.size());
+  batcher.scheduled_flush(sender());
+  ASSERT_EQ(4u, sent.size());
+  ASSERT_EQ((std::vector<ceph_tid_t>{8}), tids(3));
+
+  // nothing to do if the window ends on an empty batch
+  ASSERT_TRUE(add(make_op(9, 10), 10));
+  batcher.flush(sender());
+  ASSERT_EQ(5u, sent.size());
+  batcher.scheduled_flush(sender());
+  ASSERT_EQ(5u, sent.size());
+}
+
+TEST_F(OpBatcherTest, discard)
+{
+  ASSERT_TRUE(add(make_op(1, 10), 10));
+  ASSERT_FALSE(add(make_op(2, 10), 10));
+  batcher.discard();
+  ASSERT_TRUE(batcher.empty());
+  batcher.scheduled_flush(sender());
+  ASSERT_TRUE(sent.empty());
+}
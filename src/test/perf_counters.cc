@@ -260,6 +260,146 @@ TEST(PerfCounters, read_avg) {
   t1.join();
 }
 
+static std::shared_ptr<PerfCounters> setup_test_perfcounters1_sharded(
+  CephContext *cct, bool sharded)
+{
+  PerfCountersBuilder bld(cct, "test_perfcounter_1",
+	  TEST_PERFCOUNTERS1_ELEMENT_FIRST, TEST_PERFCOUNTERS1_ELEMENT_LAST);
+  bld.set_sharded(sharded);
+  bld.add_u64_counter(TEST_PERFCOUNTERS1_ELEMENT_1, "element1");
+  bld.add_time(TEST_PERFCOUNTERS1_ELEMENT_2, "element2");
+  bld.add_time_avg(TEST_PERFCOUNTERS1_ELEMENT_3, "element3");
+  return std::shared_ptr<PerfCounters>(bld.create_perf_counters());
+}
+
+TEST(PerfCounters, Sharded) {
+  auto pf = setup_test_perfcounters1_sharded(g_ceph_context, true);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 8; t++) {
+    threads.emplace_back([pf] {
+      for (int i = 0; i < 10000; i++) {
+	pf->inc(TEST_PERFCOUNTERS1_ELEMENT_1, 2);
+	pf->tinc(TEST_PERFCOUNTERS1_ELEMENT_3, utime_t(0, 1));
+	if (i % 2) {
+	  pf->dec(TEST_PERFCOUNTERS1_ELEMENT_1);
+	}
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  ASSERT_EQ(8u * 15000, pf->get(TEST_PERFCOUNTERS1_ELEMENT_1));
+  ASSERT_EQ(std::make_pair(8ul * 10000, 8ul * 10000),
+	    pf->get_tavg_ns(TEST_PERFCOUNTERS1_ELEMENT_3));
+
+  pf->set(TEST_PERFCOUNTERS1_ELEMENT_1, 5);
+  pf->tset(TEST_PERFCOUNTERS1_ELEMENT_2, utime_t(1, 0));
+  ASSERT_EQ(5u, pf->get(TEST_PERFCOUNTERS1_ELEMENT_1));
+  ASSERT_EQ(utime_t(1, 0), pf->tget(TEST_PERFCOUNTERS1_ELEMENT_2));
+
+  pf->reset();
+  ASSERT_EQ(0u, pf->get(TEST_PERFCOUNTERS1_ELEMENT_1));
+  ASSERT_EQ(std::make_pair(0ul, 0ul),
+	    pf->get_tavg_ns(TEST_PERFCOUNTERS1_ELEMENT_3));
+}
+
+TEST(PerfCounters, ShardedReadAvg) {
+  PerfCountersBuilder bld(g_ceph_context, "test_percounter_3",
+      TEST_PERFCOUNTERS3_ELEMENT_FIRST, TEST_PERFCOUNTERS3_ELEMENT_LAST);
+  bld.set_sharded();
+  bld.add_time_avg(TEST_PERFCOUNTERS3_ELEMENT_READ, "read_avg");
+  std::shared_ptr<PerfCounters> fake_pf(bld.create_perf_counters());
+
+  std::thread t1(counters_inc_test, fake_pf);
+  std::thread t2(counters_inc_test, fake_pf);
+  std::thread t3(counters_readavg_test, fake_pf);
+  t3.join();
+  t2.join();
+  t1.join();
+}
+
+TEST(PerfCounters, ShardedGauge) {
+  PerfCountersBuilder bld(g_ceph_context, "test_perfcounter_gauge",
+	  TEST_PERFCOUNTERS1_ELEMENT_FIRST, TEST_PERFCOUNTERS1_ELEMENT_LAST);
+  bld.set_sharded();
+  bld.add_u64(TEST_PERFCOUNTERS1_ELEMENT_1, "gauge");
+  bld.add_u64_counter(TEST_PERFCOUNTERS1_ELEMENT_2, "counter");
+  std::shared_ptr<PerfCounters> pf(bld.create_perf_counters());
+
+  // gauges go up and down on different threads; readers must never see
+  // the sum of half-updated shards
+  constexpr int nthreads = 8;
+  std::atomic<int> running = nthreads;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < nthreads; t++) {
+    threads.emplace_back([pf, &running] {
+      for (int i = 0; i < 100000; i++) {
+	pf->inc(TEST_PERFCOUNTERS1_ELEMENT_1);
+	pf->inc(TEST_PERFCOUNTERS1_ELEMENT_2);
+	pf->dec(TEST_PERFCOUNTERS1_ELEMENT_1);
+      }
+      --running;
+    });
+  }
+  uint64_t max_seen = 0;
+  while (running) {
+    max_seen = std::max(max_seen, pf->get(TEST_PERFCOUNTERS1_ELEMENT_1));
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  ASSERT_LE(max_seen, (uint64_t)nthreads);
+  ASSERT_EQ(0u, pf->get(TEST_PERFCOUNTERS1_ELEMENT_1));
+  ASSERT_EQ(nthreads * 100000u, pf->get(TEST_PERFCOUNTERS1_ELEMENT_2));
+}
+
+// hit the counters from many threads at once, returns the time it took
+static ceph::timespan contend(PerfCounters* pf, int nthreads, int nops)
+{
+  auto start = ceph::mono_clock::now();
+  std::vector<std::thread> threads;
+  for (int t = 0; t < nthreads; t++) {
+    threads.emplace_back([pf, nops] {
+      for (int i = 0; i < nops; i++) {
+	pf->inc(TEST_PERFCOUNTERS1_ELEMENT_1);
+	pf->tinc(TEST_PERFCOUNTERS1_ELEMENT_3, utime_t(0, 1));
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  return ceph::mono_clock::now() - start;
+}
+
+TEST(PerfCounters, Contention) {
+  constexpr int nthreads = 8;
+  constexpr int nops = 10000;
+  for (bool sharded : {false, true}) {
+    auto pf = setup_test_perfcounters1_sharded(g_ceph_context, sharded);
+    contend(pf.get(), nthreads, nops);
+    ASSERT_EQ((uint64_t)nthreads * nops, pf->get(TEST_PERFCOUNTERS1_ELEMENT_1));
+    ASSERT_EQ((uint64_t)nthreads * nops,
+	      pf->get_tavg_ns(TEST_PERFCOUNTERS1_ELEMENT_3).second);
+  }
+}
+
+// cost of counters hit by many threads at once, with and without sharding
+TEST(PerfCounters, DISABLED_BenchContention) {
+  constexpr int nthreads = 64;
+  constexpr int nops = 100000;
+  for (bool sharded : {false, true}) {
+    auto pf = setup_test_perfcounters1_sharded(g_ceph_context, sharded);
+    auto elapsed = contend(pf.get(), nthreads, nops);
+    std::cout << (sharded ? "sharded: " : "shared:  ") << nthreads
+	      << " threads, "
+	      << std::chrono::duration_cast<std::chrono::nanoseconds>(
+		   elapsed).count() / (nthreads * nops)
+	      << " ns per inc+tinc" << std::endl;
+  }
+}
+
 static PerfCounters* setup_test_perfcounter4(std::string name, CephContext *cct)
 {
   PerfCountersBuilder bld(cct, name,
@@ -777,6 +777,53 @@ TEST(denc, compat_allows)
   ASSERT_EQ(111, v2.c);
 }
 
+// a v1 foo_t that can also be decoded from a list iterator, which makes
+// it (and pairs of it) decodable without a contiguous buffer
+struct foo_legacy_t {
+  int32_t a = 0;
+  uint64_t b = 123;
+
+  DENC(foo_legacy_t, v, p) {
+    DENC_START(1, 1, p);
+    ::denc(v.a, p);
+    ::denc(v.b, p);
+    DENC_FINISH(p);
+  }
+  void decode(buffer::list::const_iterator& p) {
+    DECODE_START(1, p);
+    using ceph::decode;
+    decode(a, p);
+    decode(b, p);
+    DECODE_FINISH(p);
+  }
+};
+WRITE_CLASS_DENC_BOUNDED(foo_legacy_t)
+
+TEST(denc, decode_newer_bounded)
+{
+  // a v2 encoding is longer than the v1 decoder's bound_encode()
+  foo2_accept1_t v2;
+  v2.a = 5001; v2.b = 6002; v2.c = 7003;
+  bufferlist bl;
+  encode(v2, bl);
+  uint32_t marker = 0xfeedface;
+  encode(marker, bl);
+  encode(marker, bl);
+
+  std::pair<foo_legacy_t, uint32_t> v1;
+  static_assert(denc_traits<decltype(v1)>::bounded &&
+		!denc_traits<decltype(v1)>::need_contiguous);
+  auto p = std::cbegin(bl);
+  decode(v1, p);
+  ASSERT_EQ(v2.a, v1.first.a);
+  ASSERT_EQ(v2.b, v1.first.b);
+  ASSERT_EQ(marker, v1.second);
+  uint32_t m = 0;
+  decode(m, p);
+  ASSERT_EQ(marker, m);
+  ASSERT_TRUE(p.end());
+}
+
 TEST(denc, compat_disallows)
 {
   foo2_only2_t v2;
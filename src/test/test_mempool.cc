@@ -16,7 +16,12 @@
 
 #include <stdio.h>
 
+#include <fstream>
+#include <memory>
+#include <thread>
+
 #include "global/global_init.h"
+#include "common/ceph_time.h"
 #include "common/ceph_argparse.h"
 #include "global/global_context.h"
 #include "gtest/gtest.h"
@@ -404,6 +409,181 @@ TEST(mempool, btree_map_test)
   ASSERT_EQ(0, mempool::osd::allocated_bytes());
 }
 
+TEST(mempool, thread_local_accounting)
+{
+  mempool::set_thread_flush_bytes(1 << 20);
+  size_t before = mempool::unittest_1::allocated_bytes();
+  {
+    mempool::unittest_1::vector<char> v(1000);
+    // not flushed yet
+    ASSERT_EQ(before, mempool::unittest_1::allocated_bytes());
+    mempool::flush_thread_stats();
+    ASSERT_EQ(before + 1000, mempool::unittest_1::allocated_bytes());
+    mempool::unittest_1::vector<char> w(2 << 20);
+    // flushed right away, being over the limit
+    ASSERT_EQ(before + 1000 + (2 << 20),
+	      mempool::unittest_1::allocated_bytes());
+  }
+  mempool::flush_thread_stats();
+  ASSERT_EQ(before, mempool::unittest_1::allocated_bytes());
+
+  // exiting threads flush what they have
+  mempool::unittest_1::pool_allocator<char> a;
+  char *p = nullptr;
+  std::thread t([&] {
+    p = a.allocate(1000);
+  });
+  t.join();
+  ASSERT_EQ(before + 1000, mempool::unittest_1::allocated_bytes());
+  a.deallocate(p, 1000);
+
+  // turning it off hands over what was kept on the next allocation
+  mempool::flush_thread_stats();
+  ASSERT_EQ(before, mempool::unittest_1::allocated_bytes());
+  p = a.allocate(1000);
+  ASSERT_EQ(before, mempool::unittest_1::allocated_bytes());
+  mempool::set_thread_flush_bytes(0);
+  mempool::osd::pool_allocator<char> b;
+  b.deallocate(b.allocate(10), 10);
+  ASSERT_EQ(before + 1000, mempool::unittest_1::allocated_bytes());
+  ASSERT_EQ(0u, mempool::threads_pending.load());
+  a.deallocate(p, 1000);
+  ASSERT_EQ(before, mempool::unittest_1::allocated_bytes());
+}
+
+TEST(mempool, arena)
+{
+  mempool::arena_t arena(24, 8);
+  vector<void*> v;
+  for (size_t i = 0; i < 100000; ++i) {
+    void *p = arena.allocate();
+    ASSERT_EQ(0u, reinterpret_cast<uintptr_t>(p) % 8);
+    memset(p, 0xff, 24);
+    v.push_back(p);
+  }
+  size_t slabs = arena.get_num_slabs();
+  ASSERT_GE(slabs, 100000 * 24 / mempool::arena_t::SLAB_SIZE);
+  for (auto p : v) {
+    mempool::arena_t::deallocate(p);
+  }
+  // one spare slab per shard at most
+  ASSERT_LE(arena.get_num_slabs(), 8u);
+  ASSERT_LT(arena.get_num_slabs(), slabs);
+
+  // slots are reused
+  void *p = arena.allocate();
+  mempool::arena_t::deallocate(p);
+  ASSERT_EQ(p, arena.allocate());
+  mempool::arena_t::deallocate(p);
+}
+
+TEST(mempool, arena_pool)
+{
+  // enabled by main(), before anything was allocated from unittest_2
+  static_assert(mempool::pool_uses_arena(mempool::mempool_unittest_2));
+  ASSERT_TRUE(mempool::get_pool(mempool::mempool_unittest_2).uses_arena());
+  size_t before = mempool::unittest_2::allocated_items();
+  {
+    mempool::unittest_2::list<int> l;
+    mempool::unittest_2::map<int, int> m;
+    for (int i = 0; i < 1000; ++i) {
+      l.push_back(i);
+      m[i] = i;
+    }
+    ASSERT_EQ(before + 2000, mempool::unittest_2::allocated_items());
+    // the slabs behind them are accounted for too
+    ASSERT_GE(mempool::unittest_2::allocated_slab_bytes(),
+	      mempool::arena_t::SLAB_SIZE);
+    ASSERT_EQ(0u, mempool::unittest_1::allocated_slab_bytes());
+    int i = 0;
+    for (auto j : l) {
+      ASSERT_EQ(i++, j);
+    }
+  }
+  ASSERT_EQ(before, mempool::unittest_2::allocated_items());
+}
+
+static size_t get_rss()
+{
+  size_t size = 0, resident = 0;
+  std::ifstream f("/proc/self/statm");
+  f >> size >> resident;
+  return resident * CEPH_PAGE_SIZE;
+}
+
+// allocation throughput with many threads, with and without thread-local
+// accounting.  run with --gtest_also_run_disabled_tests
+TEST(mempool, DISABLED_bench_thread_local_accounting)
+{
+  constexpr int nthreads = 16;
+  constexpr int nops = 200000;
+  for (size_t flush_bytes : {0, 64 << 10}) {
+    mempool::set_thread_flush_bytes(flush_bytes);
+    auto start = ceph::mono_clock::now();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < nthreads; ++t) {
+      threads.emplace_back([] {
+	mempool::unittest_1::pool_allocator<uint64_t> a;
+	for (int i = 0; i < nops; ++i) {
+	  a.deallocate(a.allocate(1), 1);
+	}
+      });
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+    auto elapsed = ceph::mono_clock::now() - start;
+    std::cout << "thread_flush_bytes " << flush_bytes << ": "
+	      << std::chrono::duration_cast<std::chrono::nanoseconds>(
+		   elapsed).count() / (nthreads * nops)
+	      << " ns per allocate+deallocate" << std::endl;
+  }
+  mempool::set_thread_flush_bytes(0);
+}
+
+// allocation throughput and RSS left behind once most of many small
+// objects are trimmed, oldest first, like a cache would, with
+// (unittest_2) and without (unittest_1) arenas.  Every item is allocated
+// next to a short-lived buffer, which scatters malloc'ed items over the
+// heap.
+template<typename List>
+void bench_fragmentation(const char *name)
+{
+  constexpr int nitems = 1000000;
+  size_t rss_before = get_rss();
+  auto start = ceph::mono_clock::now();
+  List items;
+  std::vector<std::unique_ptr<char[]>> scratch;
+  for (int i = 0; i < nitems; ++i) {
+    items.emplace_back();
+    scratch.emplace_back(new char[64 + i % 256]);
+  }
+  auto elapsed = ceph::mono_clock::now() - start;
+  scratch.clear();
+  size_t rss_full = get_rss();
+  for (int i = 0; i < nitems / 16 * 15; ++i) {
+    items.pop_front();
+  }
+  size_t rss_trimmed = get_rss();
+  std::cout << name << ": "
+	    << std::chrono::duration_cast<std::chrono::nanoseconds>(
+		 elapsed).count() / nitems
+	    << " ns per allocation, RSS +"
+	    << ((ssize_t)(rss_full - rss_before) >> 10)
+	    << " KB full, +" << ((ssize_t)(rss_trimmed - rss_before) >> 10)
+	    << " KB after trimming 15/16" << std::endl;
+}
+
+struct bench_item_t {
+  char data[200];
+};
+
+TEST(mempool, DISABLED_bench_arena)
+{
+  bench_fragmentation<mempool::unittest_1::list<bench_item_t>>("malloc");
+  bench_fragmentation<mempool::unittest_2::list<bench_item_t>>("arena");
+}
+
 #if !defined(__arm__) && !defined(__aarch64__)
 TEST(mempool, check_shard_select)
 {
@@ -447,6 +627,7 @@ int main(int argc, char **argv)
 
   // enable debug mode for the tests
   mempool::set_debug_mode(true);
+  mempool::set_arena_enabled(true);
 
   ::testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
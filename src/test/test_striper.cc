@@ -87,3 +87,43 @@ TEST(Striper, GetFileOffset)
           g_ceph_context, &l, object_no, object_off);
   ASSERT_EQ(26549568u, file_offset);
 }
+
+TEST(Striper, AppendExtents)
+{
+  file_layout_t l;
+
+  l.object_size = 4194304;
+  l.stripe_unit = 4194304;
+  l.stripe_count = 1;
+
+  striper::LightweightObjectExtents ex;
+  Striper::file_to_extents(g_ceph_context, &l, 4194304 - 4096, 3 * 4194304,
+                           0, 0, &ex);
+  ASSERT_EQ(4u, ex.size());
+  ASSERT_EQ(0u, ex[0].object_no);
+  ASSERT_EQ(4194304u - 4096, ex[0].offset);
+  ASSERT_EQ(4096u, ex[0].length);
+  ASSERT_EQ(3u, ex[3].object_no);
+  ASSERT_EQ(0u, ex[3].offset);
+  ASSERT_EQ(4194304u - 4096, ex[3].length);
+
+  // contiguous with the last object extent
+  Striper::file_to_extents(g_ceph_context, &l, 4 * 4194304 - 4096, 8192,
+                           0, 3 * 4194304, &ex);
+  ASSERT_EQ(5u, ex.size());
+  ASSERT_EQ(3u, ex[3].object_no);
+  ASSERT_EQ(4194304u, ex[3].length);
+  ASSERT_EQ(2u, ex[3].buffer_extents.size());
+  ASSERT_EQ(4u, ex[4].object_no);
+  ASSERT_EQ(4096u, ex[4].length);
+
+  // behind the last object extent
+  Striper::file_to_extents(g_ceph_context, &l, 0, 4096, 0,
+                           3 * 4194304 + 8192, &ex);
+  ASSERT_EQ(6u, ex.size());
+  ASSERT_EQ(0u, ex[1].object_no);
+  ASSERT_EQ(0u, ex[1].offset);
+  for (size_t i = 1; i < ex.size(); ++i) {
+    ASSERT_LE(ex[i - 1].object_no, ex[i].object_no);
+  }
+}
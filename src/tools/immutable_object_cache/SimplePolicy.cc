@@ -63,12 +63,13 @@ cache_status_t SimplePolicy::alloc_entry(std::string file_name) {
 cache_status_t SimplePolicy::lookup_object(std::string file_name) {
   ldout(cct, 20) << "lookup: " << file_name << dendl;
 
-  std::shared_lock rlocker{m_cache_map_lock};
+  // exclusive: a hit reorders the lru
+  std::unique_lock locker{m_cache_map_lock};
 
   auto entry_it = m_cache_map.find(file_name);
   // simply promote on first lookup
   if (entry_it == m_cache_map.end()) {
-      rlocker.unlock();
+      locker.unlock();
       return alloc_entry(file_name);
   }
 
@@ -169,18 +170,22 @@ void SimplePolicy::get_evict_list(std::list<std::string>* obj_list) {
   ldout(cct, 20) << dendl;
 
   std::unique_lock locker{m_cache_map_lock};
-  // check free ratio, pop entries from LRU
+  // check free ratio, pop entries from LRU until enough space is freed
+  // to get back below the low watermark.  Entries are sized by what they
+  // occupy, so a few large cold objects are as good as many small ones.
   if ((double)m_cache_size > m_max_cache_size * m_watermark) {
-    // TODO(dehao): make this configurable
-    int evict_num = m_cache_map.size() * 0.1;
-    for (int i = 0; i < evict_num; i++) {
+    uint64_t target = m_max_cache_size * m_watermark * EVICT_LOW_WATERMARK;
+    uint64_t cache_size = m_cache_size;
+    while (cache_size > target) {
       Entry* entry = reinterpret_cast<Entry*>(m_promoted_lru.lru_expire());
       if (entry == nullptr) {
-        continue;
+        break;
       }
-      std::string file_name = entry->file_name;
-      obj_list->push_back(file_name);
+      cache_size -= std::min(entry->size, cache_size);
+      obj_list->push_back(entry->file_name);
     }
+    ldout(cct, 10) << "evicting " << obj_list->size() << " entries, "
+                   << m_cache_size - cache_size << " bytes" << dendl;
   }
 }
 
@@ -48,6 +48,9 @@ class SimplePolicy : public Policy {
     uint64_t size;
   };
 
+  // once over the watermark, evict down to this fraction of it
+  static constexpr double EVICT_LOW_WATERMARK = 0.9;
+
   CephContext* cct;
   double m_watermark;
   uint64_t m_max_inflight_ops;
@@ -592,6 +592,7 @@ int main(int argc, const char **argv)
       goto skip_upmap;
     }
     int rounds = 0;
+    int total_changes = 0;
     struct timespec round_start;
     [[maybe_unused]] int r = clock_gettime(CLOCK_MONOTONIC, &round_start);
     assert(r == 0);
@@ -628,6 +629,7 @@ int main(int argc, const char **argv)
       r = clock_gettime(CLOCK_MONOTONIC, &end);
       assert(r == 0);
       cout << "prepared " << total_did << "/" << upmap_max  << " changes" << std::endl;
+      total_changes += total_did;
       float elapsed_time = (end.tv_sec - begin.tv_sec) + 1.0e-9*(end.tv_nsec - begin.tv_nsec);
       if (upmap_active)
         cout << "Time elapsed " << elapsed_time << " secs" << std::endl;
@@ -662,7 +664,8 @@ int main(int argc, const char **argv)
           for (auto& i : pgs_by_osd)
             cout << "osd." << i.first << " pgs " << i.second.size() << std::endl;
           float elapsed_time = (end.tv_sec - round_start.tv_sec) + 1.0e-9*(end.tv_nsec - round_start.tv_nsec);
-          cout << "Total time elapsed " << elapsed_time << " secs, " << rounds << " rounds" << std::endl;
+          cout << "Total time elapsed " << elapsed_time << " secs, " << rounds << " rounds, "
+               << total_changes << " changes" << std::endl;
         }
         break;
       }